@@ -0,0 +1,513 @@
+/*
+xlbench.c - measures how fast the XL library emulates.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -pthread -O2 -o xlbench xlbench.c
+  RUN
+xlbench [-n <instructions>] [-c <cycles>] [-r <repeats>] [-o <csv-file>] [-J <json-file>] [-b <baseline-csv>] [-t <percent>] [-v] <programs...>
+ The programs ending with .xlas are assembled in memory.
+  OPTIONS
+-n  Run every opcode for the instructions, 0 skips the opcodes
+    (200000 by default)
+-c  Run every program for at least the cycles (10000000 by default)
+-r  Keep the best of the runs (3 by default)
+-o  Write the results to the CSV file
+-J  Write the results to the JSON file
+-b  Compare the results with the CSV file written by -o
+-t  Report the results worse than the baseline by more than
+    the percent (10 by default)
+-v  Print the output of the programs to the standard error
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../extended_lemon.h"
+#include "../extended_lemon_extra.h"
+#include "../xlas.h"
+
+#define PRGSIZE 0x8000
+
+/* copies of the opcode in the loop, the jmp back adds one more */
+#define COPIES 64
+
+/* the operands of the opcodes, the zero page and the page 2
+   are filled with 0x02, so every vector points to 0x0202 */
+#define OPIMM 0x01
+#define OPABS 0x0200
+#define OPZPG 0x10
+
+#define NAMESIZE 256
+
+typedef struct Result {
+  char kind[4]; /* op or prg */
+  char name[NAMESIZE];
+  double value;
+  int ismhz; /* emulated MHz, or host ns per instruction */
+} Result;
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/*
+Load method to read one byte at address.
+*/
+static XL_Byte
+load(XL *xl, XL_Word addr);
+
+/*
+Store method to write one byte to address, xlx style.
+*/
+static void
+store(XL *xl, XL_Word addr, XL_Byte data);
+
+/*
+Error method, only the programs get there.
+*/
+static void
+error(XL *xl, XL_Uint ecode);
+
+/*
+Fill the ROM with the loop of the opcode. Return 0 if the opcode
+cannot run in a loop: inv, brk, rti, ret and the jumps that do not
+go to the next instruction.
+*/
+static int
+genloop(int op);
+
+/*
+Run the instructions, return the host seconds they took.
+*/
+static double
+runinsts(XL *xl, long num);
+
+/*
+Read the .xlx file or assemble the .xlas file into the ROM.
+*/
+static void
+loadprg(const char *filename);
+
+/*
+Run the program from reset until it stores to 0x7FFF, again and
+again until the cycles pass. Return the host seconds they took.
+*/
+static double
+runprg(XL *xl, long cycles);
+
+/*
+Add the result and print it.
+*/
+static void
+addresult(const char *kind, const char *name, double value, int ismhz);
+
+/*
+Write the results as CSV, one kind,name,value,unit per line.
+*/
+static void
+writecsv(const char *filename);
+
+/*
+Write the results as JSON.
+*/
+static void
+writejson(const char *filename);
+
+/*
+Print the results worse than the baseline by more than the percent,
+return their number.
+*/
+static int
+compare(const char *filename, double percent);
+
+static XL_Byte mem[0x10000];
+static int stop; /* the program stored to 0x7FFF */
+static int echo; /* -v, print the output of the first run */
+static const char *prgname;
+static Result *restab;
+static int resnum;
+static int rescap;
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  XL xl;
+  const char *csvname = NULL, *jsonname = NULL, *baseline = NULL;
+  char name[NAMESIZE];
+  double percent = 10, t = 0, best = 0;
+  long insts = 200000, cycles = 10000000;
+  int i = 0, op = 0, k = 0, repeats = 3, isverbose = 0, fails = 0;
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    /**/ if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      insts = atol(argv[++i]);
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      cycles = atol(argv[++i]);
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      repeats = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      csvname = argv[++i];
+    else if (strcmp(argv[i], "-J") == 0 && i + 1 < argc)
+      jsonname = argv[++i];
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      baseline = argv[++i];
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      percent = atof(argv[++i]);
+    else if (strcmp(argv[i], "-v") == 0)
+      isverbose = 1;
+    else
+      errf("xlbench: Unknown option %s\n", argv[i]);
+  }
+  if (insts < 0 || cycles <= 0 || repeats <= 0 || percent < 0)
+    errf("xlbench: Invalid number\n");
+  XL_init_opcodes();
+  XL_init(&xl);
+  xl.load = load;
+  xl.store = store;
+  xl.error = error;
+  printf("kind_name______________________________value_unit\n");
+  for (op = 0; op < XL_NUM_COMBOS && insts > 0; ++op) {
+    sprintf(name, "0x%02X %s %s", op, XL_keywords[XL_combos[op].inst]
+           , XL_addrmodes[XL_combos[op].amode]);
+    if (!genloop(op)) {
+      printf("op   %-32s   skipped\n", name);
+      continue;
+    }
+    for (k = 0; k < repeats; ++k) {
+      t = runinsts(&xl, insts);
+      if (k == 0 || t < best)
+        best = t;
+    }
+    addresult("op", name, best * 1e9 / insts, 0);
+  }
+  for (; i < argc; ++i) {
+    loadprg(argv[i]);
+    echo = isverbose;
+    for (k = 0; k < repeats; ++k) {
+      t = runprg(&xl, cycles);
+      if (k == 0 || t < best)
+        best = t;
+    }
+    /* a run of nothing is as fast as it gets */
+    if (best <= 0)
+      best = 1.0 / CLOCKS_PER_SEC;
+    addresult("prg", argv[i], cycles / best / 1e6, 1);
+  }
+  if (csvname != NULL)
+    writecsv(csvname);
+  if (jsonname != NULL)
+    writejson(jsonname);
+  if (baseline != NULL) {
+    fails = compare(baseline, percent);
+    if (fails > 0)
+      errf("xlbench: %i of %i results are worse than %s by more than"
+           " %g%%\n", fails, resnum, baseline, percent);
+  }
+  return 0;
+}
+
+/************************************************************/
+XL_Byte
+load(XL *xl, XL_Word addr)
+{
+  (void)xl;
+  return mem[addr];
+}
+
+/************************************************************/
+void
+store(XL *xl, XL_Word addr, XL_Byte data)
+{
+  (void)xl;
+  if (addr == 0x00FF && echo)
+    fputc(data, stderr);
+  if (addr <= 0x7FFE)
+    mem[addr] = data;
+  else if (addr == 0x7FFF)
+    stop = 1;
+}
+
+/************************************************************/
+void
+error(XL *xl, XL_Uint ecode)
+{
+  assert(ecode == XL_ERR_INVALID);
+  errf("%s: Invalid instruction executed at 0x%04X\n"
+      , prgname, (XL_Word)(xl->p - 1));
+}
+
+/************************************************************/
+int
+genloop(int op)
+{
+  XL_Combo *c = &XL_combos[op];
+  int size = XL_modesizes[c->amode];
+  int at = 0, n = 0, w = 0;
+  switch (c->inst) {
+  case Tinv: case Tbrk: case Trti: case Tret:
+    return 0;
+  case Tjmp: case Tcal:
+    if (c->amode != Mabs && c->amode != Mrel)
+      return 0;
+    break;
+  default:
+    break;
+  }
+  memset(mem, 0, sizeof(mem));
+  memset(mem, 0x02, 0x0300);
+  for (n = 0; n < COPIES; ++n) {
+    at = 0x8000 + n * size;
+    switch (c->amode) {
+    case Mimm:
+      w = OPIMM;
+      break;
+    case Mabs: case Mabx: case Maby: case Mvec:
+      /* jmp and cal go to the next copy */
+      w = c->inst == Tjmp || c->inst == Tcal ? at + size : OPABS;
+      break;
+    case Mrel:
+      /* taken or not, the next copy */
+      w = size;
+      break;
+    default:
+      w = OPZPG;
+      break;
+    }
+    mem[at] = op;
+    if (size > 1)
+      mem[at + 1] = w & 0xFF;
+    if (size > 2)
+      mem[at + 2] = w >> 8;
+  }
+  at = 0x8000 + n * size;
+  mem[at] = XL_opcodes[Tjmp][Mabs];
+  mem[at + 1] = 0x00;
+  mem[at + 2] = 0x80;
+  mem[0xFFFE] = 0x00;
+  mem[0xFFFF] = 0x80;
+  return 1;
+}
+
+/************************************************************/
+double
+runinsts(XL *xl, long num)
+{
+  clock_t t = 0;
+  long n = 0;
+  XL_restart(xl);
+  t = clock();
+  while (n < num)
+    n += XL_cycle(xl);
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+/************************************************************/
+void
+loadprg(const char *filename)
+{
+  XLAS *as = NULL;
+  FILE *file = NULL;
+  size_t len = 0;
+  prgname = filename;
+  memset(mem, 0, sizeof(mem));
+  len = strlen(filename);
+  if (len > 5 && strcmp(filename + len - 5, ".xlas") == 0) {
+    as = XLAS_new(NULL);
+    if (XLAS_assemble(as, filename, NULL, 0) != 0)
+      exit(EXIT_FAILURE);
+    if (XLAS_image(as, mem + 0x8000) < PRGSIZE)
+      errf("%s: Too few bytes in the program\n", filename);
+    XLAS_free(as);
+    return;
+  }
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  if (fread(mem + 0x8000, 1, PRGSIZE, file) < PRGSIZE)
+    errf("%s: Too few bytes in the file\n", filename);
+  fclose(file);
+}
+
+/************************************************************/
+double
+runprg(XL *xl, long cycles)
+{
+  clock_t t = 0;
+  long n = 0;
+  t = clock();
+  /* the RAM stays as the last run left it, the programs set up
+     what they use */
+  while (n < cycles) {
+    stop = 0;
+    XL_restart(xl);
+    while (!stop && n < cycles) {
+      XL_cycle(xl);
+      ++n;
+    }
+    echo = 0;
+  }
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+/************************************************************/
+void
+addresult(const char *kind, const char *name, double value, int ismhz)
+{
+  Result *r = NULL;
+  if (resnum + 1 > rescap) {
+    rescap = rescap ? rescap * 2 : 64;
+    restab = realloc(restab, rescap * sizeof(restab[0]));
+    if (restab == NULL)
+      errf("xlbench: realloc failed\n");
+  }
+  r = &restab[resnum++];
+  if (strlen(name) >= NAMESIZE || strchr(name, ',') != NULL)
+    errf("xlbench: %s: The name is too long or has a comma\n", name);
+  strcpy(r->kind, kind);
+  strcpy(r->name, name);
+  r->value = value;
+  r->ismhz = ismhz;
+  printf("%-4s %-32s %10.3f %s\n", kind, name, value
+        , ismhz ? "MHz" : "ns");
+}
+
+/************************************************************/
+void
+writecsv(const char *filename)
+{
+  FILE *f = NULL;
+  int i = 0;
+  f = fopen(filename, "w");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  fprintf(f, "kind,name,value,unit\n");
+  for (i = 0; i < resnum; ++i)
+    fprintf(f, "%s,%s,%.3f,%s\n", restab[i].kind, restab[i].name
+           , restab[i].value, restab[i].ismhz ? "MHz" : "ns");
+  if (fclose(f) != 0)
+    errf("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+void
+writejson(const char *filename)
+{
+  FILE *f = NULL;
+  const char *s = NULL;
+  int i = 0;
+  f = fopen(filename, "w");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  fprintf(f, "{\"results\": [");
+  for (i = 0; i < resnum; ++i) {
+    fprintf(f, "%s\n  {\"kind\": \"%s\", \"name\": \""
+           , i > 0 ? "," : "", restab[i].kind);
+    for (s = restab[i].name; *s != '\0'; ++s) {
+      /**/ if (*s == '"' || *s == '\\')
+        fprintf(f, "\\%c", *s);
+      else if ((unsigned char)*s < 0x20)
+        fprintf(f, "\\u%04X", (unsigned char)*s);
+      else
+        fputc(*s, f);
+    }
+    fprintf(f, "\", \"value\": %.3f, \"unit\": \"%s\"}"
+           , restab[i].value, restab[i].ismhz ? "MHz" : "ns");
+  }
+  fprintf(f, "\n]}\n");
+  if (fclose(f) != 0)
+    errf("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+int
+compare(const char *filename, double percent)
+{
+  char line[512];
+  char kind[4], name[NAMESIZE], unit[8];
+  FILE *f = NULL;
+  Result *r = NULL;
+  double old = 0, worse = 0;
+  int row = 0, i = 0, fails = 0;
+  f = fopen(filename, "r");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  while (fgets(line, sizeof(line), f) != NULL) {
+    ++row;
+    if (row == 1 && strncmp(line, "kind,", 5) == 0)
+      continue;
+    if (sscanf(line, "%3[^,],%255[^,],%lf,%7s", kind, name, &old, unit)
+        != 4 || old <= 0)
+      errf("%s:%i: Expected kind,name,value,unit\n", filename, row);
+    /* the benchmarks that are new or gone are not compared */
+    for (i = 0; i < resnum; ++i) {
+      r = &restab[i];
+      if (strcmp(r->kind, kind) == 0 && strcmp(r->name, name) == 0)
+        break;
+    }
+    if (i == resnum)
+      continue;
+    worse = (r->ismhz ? old - r->value : r->value - old) / old * 100;
+    if (worse > percent) {
+      printf("xlbench: %s %s is %.1f%% worse, %.3f %s against %.3f\n"
+            , kind, name, worse, r->value, unit, old);
+      ++fails;
+    }
+  }
+  if (ferror(f))
+    errf("%s: Cannot read the file\n", filename);
+  fclose(f);
+  return fails;
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+#define EXTENDED_LEMON_C
+#include "../extended_lemon.h"
+#define XL_EXTRA_C
+#include "../extended_lemon_extra.h"
+#define XLAS_C
+#include "../xlas.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
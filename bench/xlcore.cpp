@@ -0,0 +1,367 @@
+/*
+xlcore.cpp - compares xl::Core of extended_lemon.hpp with the C API.
+See LICENSE information in the end of the file.
+  BUILD
+g++ -std=c++17 -Wall -Wextra -O2 -o xlcore xlcore.cpp
+  RUN
+xlcore [-c <cycles>] [-r <repeats>] <image-files...>
+ The image files are the 32 KiB programs written by xlas.
+  OPTIONS
+-c  Run every program for at least the cycles (10000000 by default)
+-r  Keep the best of the runs (3 by default)
+ Both engines run the memory map of xlx without the input: RAM below
+ 0x7FFF, the output at 0x00FF, the stop at 0x7FFF. The C API calls the
+ load and store pointers and checks the stop every cycle like xlx.
+ The core inlines the bus and runs twice: calling cycle() and checking
+ the stop every cycle like the C API, which is the fair comparison,
+ and calling run(), which checks the stop after every instruction.
+ The programs restart until the cycles run out, the first runs of all
+ must print the same and take the same cycles.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../extended_lemon.hpp"
+
+#define PRGSIZE 0x8000
+
+/* bytes of the output kept to compare */
+#define OUTCAP 256
+
+/*
+The memory of a program and what its first run printed.
+*/
+struct Machine {
+  XL_Byte mem[0x10000];
+  char out[OUTCAP];
+  int outnum;
+  int isrecording; /* the first run, keep the output */
+  int stop; /* the program stored to 0x7FFF */
+};
+
+/*
+Bus of xl::Core with the memory map of xlx.
+*/
+struct CoreBus {
+  Machine *m;
+  XL_Byte load(XL_Word addr) { return m->mem[addr]; }
+  void store(XL_Word addr, XL_Byte data);
+  void error(XL_Uint ecode);
+  void event(XL_Uint) {}
+};
+
+/*
+Print the message to the standard error and exit with failure.
+*/
+void
+errf(const char *fmt, ...);
+
+/*
+Load the image to 0x8000 of the machine and clear the RAM.
+*/
+static void
+loadimage(Machine *m, const char *filename);
+
+/*
+Bus methods of the C API.
+*/
+static XL_Byte
+load(XL *xl, XL_Word addr);
+
+static void
+store(XL *xl, XL_Word addr, XL_Byte data);
+
+static void
+error(XL *xl, XL_Uint ecode);
+
+/*
+Keep the output of the first run.
+*/
+static void
+output(Machine *m, XL_Byte data);
+
+/*
+Run the program for the cycles on the C API, on the core cycle by
+cycle or on the core with run(), return the seconds, put the cycles
+of the first run to first.
+*/
+static double
+runxl(Machine *m, long cycles, long *first);
+
+static double
+runcycle(Machine *m, long cycles, long *first);
+
+static double
+runcore(Machine *m, long cycles, long *first);
+
+/*
+Check that the first run of the core printed the same and took the
+same cycles as the one of the C API.
+*/
+static void
+checkrun(const Machine *m, long first, const char *how);
+
+static Machine xlm, cyclem, corem;
+static long xlfirst;
+static const char *prgname;
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  long cycles = 10000000, cyclefirst = 0, corefirst = 0;
+  double t = 0, xlbest = 0, cyclebest = 0, corebest = 0;
+  int i = 0, k = 0, repeats = 3;
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    /**/ if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      cycles = atol(argv[++i]);
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+      repeats = atoi(argv[++i]);
+    else
+      errf("xlcore: Unknown option %s\n", argv[i]);
+  }
+  if (i == argc || cycles <= 0 || repeats < 1)
+    errf("xlcore: Nothing to run\n");
+  printf("%-24s %10s %10s %8s %10s %8s\n", "program", "C MHz"
+        , "cycle MHz", "gain", "run MHz", "gain");
+  for (; i < argc; ++i) {
+    prgname = argv[i];
+    for (k = 0; k < repeats; ++k) {
+      loadimage(&xlm, prgname);
+      t = runxl(&xlm, cycles, &xlfirst);
+      if (k == 0 || t < xlbest)
+        xlbest = t;
+      loadimage(&cyclem, prgname);
+      t = runcycle(&cyclem, cycles, &cyclefirst);
+      if (k == 0 || t < cyclebest)
+        cyclebest = t;
+      loadimage(&corem, prgname);
+      t = runcore(&corem, cycles, &corefirst);
+      if (k == 0 || t < corebest)
+        corebest = t;
+    }
+    checkrun(&cyclem, cyclefirst, "cycle()");
+    checkrun(&corem, corefirst, "run()");
+    /* a run of nothing is as fast as it gets */
+    if (xlbest <= 0)
+      xlbest = 1.0 / CLOCKS_PER_SEC;
+    if (cyclebest <= 0)
+      cyclebest = 1.0 / CLOCKS_PER_SEC;
+    if (corebest <= 0)
+      corebest = 1.0 / CLOCKS_PER_SEC;
+    printf("%-24s %10.2f %10.2f %7.2fx %10.2f %7.2fx\n", prgname
+          , cycles / xlbest / 1e6, cycles / cyclebest / 1e6
+          , xlbest / cyclebest, cycles / corebest / 1e6
+          , xlbest / corebest);
+  }
+  return 0;
+}
+
+/************************************************************/
+void
+loadimage(Machine *m, const char *filename)
+{
+  FILE *file = NULL;
+  size_t readn = 0;
+  memset(m, 0, sizeof(*m));
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  readn = fread(m->mem + 0x8000, 1, PRGSIZE, file);
+  if (ferror(file))
+    errf("%s: Cannot read the file\n", filename);
+  if (readn < PRGSIZE)
+    errf("%s: Too few bytes in the file\n", filename);
+  fclose(file);
+}
+
+/************************************************************/
+void
+checkrun(const Machine *m, long first, const char *how)
+{
+  if (first != xlfirst)
+    errf("%s: The first run takes %li cycles on C and %li on %s\n"
+        , prgname, xlfirst, first, how);
+  if (m->outnum != xlm.outnum || memcmp(m->out, xlm.out, m->outnum) != 0)
+    errf("%s: The C API and %s print different output\n"
+        , prgname, how);
+}
+
+/************************************************************/
+void
+output(Machine *m, XL_Byte data)
+{
+  if (m->isrecording && m->outnum < OUTCAP)
+    m->out[m->outnum++] = data;
+}
+
+/************************************************************/
+XL_Byte
+load(XL *xl, XL_Word addr)
+{
+  return ((Machine *)xl->userdata)->mem[addr];
+}
+
+/************************************************************/
+void
+store(XL *xl, XL_Word addr, XL_Byte data)
+{
+  Machine *m = (Machine *)xl->userdata;
+  if (addr == 0x00FF)
+    output(m, data);
+  if (addr <= 0x7FFE)
+    m->mem[addr] = data;
+  else if (addr == 0x7FFF)
+    m->stop = 1;
+}
+
+/************************************************************/
+void
+error(XL *xl, XL_Uint ecode)
+{
+  assert(ecode == XL_ERR_INVALID);
+  errf("%s: Invalid instruction executed at 0x%04X\n"
+      , prgname, (XL_Word)(xl->p - 1));
+}
+
+/************************************************************/
+void
+CoreBus::store(XL_Word addr, XL_Byte data)
+{
+  if (addr == 0x00FF)
+    output(m, data);
+  if (addr <= 0x7FFE)
+    m->mem[addr] = data;
+  else if (addr == 0x7FFF)
+    m->stop = 1;
+}
+
+/************************************************************/
+void
+CoreBus::error(XL_Uint ecode)
+{
+  assert(ecode == XL_ERR_INVALID);
+  (void)ecode;
+  errf("%s: Invalid instruction executed\n", prgname);
+}
+
+/************************************************************/
+double
+runxl(Machine *m, long cycles, long *first)
+{
+  XL xl;
+  clock_t t = 0;
+  long n = 0;
+  XL_init(&xl);
+  xl.userdata = m;
+  xl.load = load;
+  xl.store = store;
+  xl.error = error;
+  m->isrecording = 1;
+  t = clock();
+  while (n < cycles) {
+    m->stop = 0;
+    XL_restart(&xl);
+    while (!m->stop && n < cycles) {
+      XL_cycle(&xl);
+      ++n;
+    }
+    if (m->isrecording)
+      *first = n;
+    m->isrecording = 0;
+  }
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+/************************************************************/
+double
+runcycle(Machine *m, long cycles, long *first)
+{
+  CoreBus bus = {m};
+  xl::Core<CoreBus> core(bus);
+  clock_t t = 0;
+  long n = 0;
+  m->isrecording = 1;
+  t = clock();
+  while (n < cycles) {
+    m->stop = 0;
+    core.restart();
+    while (!m->stop && n < cycles) {
+      core.cycle();
+      ++n;
+    }
+    if (m->isrecording)
+      *first = n;
+    m->isrecording = 0;
+  }
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+/************************************************************/
+double
+runcore(Machine *m, long cycles, long *first)
+{
+  CoreBus bus = {m};
+  xl::Core<CoreBus> core(bus);
+  clock_t t = 0;
+  long n = 0;
+  m->isrecording = 1;
+  t = clock();
+  while (n < cycles) {
+    m->stop = 0;
+    core.restart();
+    while (!m->stop && n < cycles)
+      n += core.run(cycles - n, [m] { return m->stop != 0; });
+    if (m->isrecording)
+      *first = n;
+    m->isrecording = 0;
+  }
+  return (double)(clock() - t) / CLOCKS_PER_SEC;
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+#define EXTENDED_LEMON_C
+#include "../extended_lemon.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
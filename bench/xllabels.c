@@ -0,0 +1,89 @@
+/*
+xllabels.c - writes an XLAS source with many labels.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -o xllabels xllabels.c
+  RUN
+xllabels [-n <labels>] <output-file>
+ Every label is referenced by a let, so the time xlas takes to
+ assemble the source is the time of its symbol lookups.
+  OPTIONS
+-n  Write the labels (100000 by default)
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  FILE *out = NULL;
+  long labels = 100000, i = 0;
+  int k = 0;
+  for (k = 1; k < argc && argv[k][0] == '-'; ++k) {
+    /**/ if (strcmp(argv[k], "-n") == 0 && k + 1 < argc)
+      labels = atol(argv[++k]);
+    else
+      errf("xllabels: Unknown option %s\n", argv[k]);
+  }
+  if (k >= argc)
+    errf("xllabels: Missing output file name\n");
+  out = fopen(argv[k], "w");
+  if (out == NULL)
+    errf("%s: %s\n", argv[k], strerror(errno));
+  fprintf(out, "; %li labels, each referenced by a let\n", labels);
+  fprintf(out, "let exit 0x7FFF\n  reset:\nsta exit\n");
+  for (i = 0; i < labels; ++i)
+    fprintf(out, "  label%li:\nlet name%li label%li\n", i, i, i);
+  fprintf(out, "  void:\nrb 0xFFFE - $\n  reset_address:\ndw reset\n");
+  if (fclose(out) != 0)
+    errf("%s: Cannot write the file\n", argv[k]);
+  return 0;
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -139,6 +139,18 @@ enum {
   XL_NUM_ERRS /* The number of error values */
 };
 
+/*
+XL event type.
+*/
+enum {
+  XL_EVENT_RESET, /* The RESET interrupt is processed */
+  XL_EVENT_INT, /* A REACT or BREAK interrupt is processed */
+  XL_EVENT_CALL, /* A subroutine is called */
+  XL_EVENT_RET, /* Returned from a subroutine */
+  XL_EVENT_RTI, /* Returned from an interrupt */
+  XL_NUM_EVENTS /* The number of event values */
+};
+
 /*
 XL status flags mask.
 */
@@ -198,6 +210,13 @@ Store method to write one byte to address.
 */
 typedef void(*XL_Store_Func)(XL *xl, XL_Word addr, XL_Byte data);
 
+/*
+Event method to observe the control flow.
+Called after the program counter has changed.
+\param event one of XL_EVENT_.
+*/
+typedef void(*XL_Event_Func)(XL *xl, XL_Uint event);
+
 /*
 XL state.
 */
@@ -206,6 +225,7 @@ struct XL {
   XL_Error_Func error; /* Error method */
   XL_Load_Func load; /* Load method */
   XL_Store_Func store; /* Store method */
+  XL_Event_Func event; /* Event method */
   XL_Word icycles; /* Current instruction cycles */
   XL_Word addr; /* Address from the address mode */
   XL_Word p; /* The program counter */
@@ -234,6 +254,7 @@ XL_int_break       | Request a BREAK interrupt
 XL_int_react       | Request a REACT interrupt
 XL_int_reset       | Request a RESET interrupt
 XL_no_error        | Dummy error callback
+XL_no_event        | Dummy event callback
 XL_no_load         | Dummy load callback
 XL_no_store        | Dummy store callback
 XL_restart         | Start/restart CPU
@@ -295,6 +316,12 @@ Deafult XL error method that just ignores all errors.
 XL_DECL void XL_CALL
 XL_no_error(XL *xl, XL_Uint ecode);
 
+/*
+Deafult XL event method that ignores all events.
+*/
+XL_DECL void XL_CALL
+XL_no_event(XL *xl, XL_Uint event);
+
 /*
 Deafult XL load method that always loads 0.
 */
@@ -467,6 +494,7 @@ XL_init(XL *xl)
   xl->error = XL_no_error;
   xl->load = XL_no_load;
   xl->store = XL_no_store;
+  xl->event = XL_no_event;
   xl->icycles = 0;
   xl->addr = 0;
   xl->p = 0;
@@ -539,6 +567,7 @@ XL_cycle(XL *xl)
     xl->s = 0;
     xl->x = 0;
     xl->y = 0;
+    xl->event(xl, XL_EVENT_RESET);
     return 0;
   }
   if (xl->is_break) {
@@ -559,6 +588,7 @@ XL_cycle(XL *xl)
     XLI_set_flag(xl, XL_FLAG_D, 1);
     XLI_set_flag(xl, XL_FLAG_B, xl->next_b_flag);
     xl->next_b_flag = 0;
+    xl->event(xl, XL_EVENT_INT);
     return 0;
   }
   op = XLI_get_opcode(xl->load(xl, xl->p));
@@ -576,6 +606,14 @@ XL_no_error(XL *xl, XL_Uint ecode)
   (void) ecode;
 }
 
+/************************************************************/
+void
+XL_no_event(XL *xl, XL_Uint event)
+{
+  (void) xl;
+  (void) event;
+}
+
 /************************************************************/
 XL_Byte
 XL_no_load(XL *xl, XL_Word addr)
@@ -938,6 +976,7 @@ XLI_IDEF(rti)
   xl->f = XLI_pull(xl);
   xl->p = XLI_pull_word(xl);
   xl->icycles += 3;
+  xl->event(xl, XL_EVENT_RTI);
 }
 
 /************************************************************/
@@ -945,6 +984,7 @@ XLI_IDEF(ret)
 {
   xl->p = XLI_pull_word(xl);
   xl->icycles += 2;
+  xl->event(xl, XL_EVENT_RET);
 }
 
 /************************************************************/
@@ -1146,6 +1186,7 @@ XLI_IDEF(cal)
   XLI_push_word(xl, xl->p);
   xl->p = xl->addr;
   xl->icycles += 2;
+  xl->event(xl, XL_EVENT_CALL);
 }
 
 /************************************************************/
@@ -0,0 +1,730 @@
+/*
+extended_lemon.hpp - Extended Lemon Microprocessor for C++17.
+See LICENSE information in the end of the file.
+
+--------------------------------------------------------------
+                        HOW TO INCLUDE
+--------------------------------------------------------------
+
+This file is a header only C++17 library on top of
+extended_lemon.h and extended_lemon_extra.h:
+```cpp
+#include <extended_lemon.hpp>
+```
+It needs no source code of the C libraries.
+
+--------------------------------------------------------------
+                        HOW TO USE
+--------------------------------------------------------------
+
+`xl::Core<Bus>` runs the instructions of extended_lemon.h, but
+calls the methods of the bus directly instead of the load and
+store pointers of the XL state, so the compiler can inline the
+memory map into every instruction. The bus is any class with
+these methods:
+```cpp
+struct MyBus {
+  XL_Byte load(XL_Word addr);
+  void store(XL_Word addr, XL_Byte data);
+  void error(XL_Uint ecode); // one of XL_ERR_
+  void event(XL_Uint event); // one of XL_EVENT_
+};
+```
+The registers are public members named like the fields of
+the XL state. `cycle` is `XL_cycle`, and `run(n)` calls `cycle` n times.
+
+```cpp
+  MyBus bus;
+  xl::Core<MyBus> core(bus);
+  core.restart();
+  for (;;) {
+    core.run(XL_FREQ);
+    // wait for the next second...
+  }
+```
+`run(n, stop)` returns early, after the instruction for which
+`stop()` is true, with the number of cycles it has run.
+
+`xl::ops` is `XL_opinfo` of extended_lemon_extra.h as constexpr:
+the keyword, the addressing mode, the size, the cycles and the
+flags, registers and memory read and written of the 256 instruction
+bytes.
+
+`xl::keyhash` is `XL_keyhash` computed by the compiler from
+`XL_KEYWORDS_XM`, and `xl::find_keyword` is `XL_find_keyword` on it.
+The build fails if it is not `XL_KEYHASH_INIT`, run xlas -K then.
+
+Check the core against the C library with xlgold, built as C++.
+*/
+
+/************************************************************/
+/* HEADER CODE                                              */
+/************************************************************/
+
+#ifndef EXTENDED_LEMON_HPP
+#define EXTENDED_LEMON_HPP
+
+/************************************************************/
+/* INCLUDES                                                 */
+/************************************************************/
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+
+namespace xl {
+
+/************************************************************/
+/* METADATA                                                 */
+/************************************************************/
+
+/*
+Metadata of every instruction byte, the same as XL_opinfo.
+*/
+inline constexpr XL_Opinfo ops[XL_NUM_COMBOS] = {
+#define X(inst, amode) XL_OPINFO(inst, amode),
+XL_COMBOS_XM
+#undef X
+};
+
+static_assert(ops[0x31].inst == Tlda && ops[0x31].amode == Mabs
+             && ops[0x31].size == 3 && ops[0x31].cycles == 4
+             && ops[0x31].regswritten == XL_REG_A
+             && ops[0x31].mem == XL_MEM_LOAD
+             , "xl::ops does not match XL_combos");
+static_assert(ops[0x11].flagsread == XL_FLAG_C
+             && ops[0x11].regsread == XL_REG_P && ops[0x11].taken == 0
+             , "xl::ops does not match XL_combos");
+
+/*
+Keywords of XLAS, the same as XL_keywords.
+*/
+inline constexpr const char *keywords[Tcount] = {
+#define X(name) #name,
+XL_KEYWORDS_XM
+#undef X
+};
+
+/*
+Length of the string.
+*/
+constexpr int
+length(const char *str)
+{
+  int len = 0;
+  while (str[len] != '\0')
+    ++len;
+  return len;
+}
+
+/*
+XL_hashkey of the string.
+*/
+constexpr unsigned int
+hashkey(const char *str, int len)
+{
+  unsigned long h = XL_KEYHASH_SEED;
+  for (; len > 0; ++str, --len)
+    h = ((h ^ (unsigned char)*str) * 16777619UL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  h = (h * 0x45D9F3BUL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  return h & (XL_KEYHASH_SIZE - 1);
+}
+
+/*
+Perfect hash table of the keywords like XL_keyhash, all zeros if
+two keywords collide or one is longer than XL_KEYWORD_MAXLEN.
+*/
+constexpr std::array<unsigned char, XL_KEYHASH_SIZE>
+makekeyhash()
+{
+  std::array<unsigned char, XL_KEYHASH_SIZE> table = {};
+  std::array<unsigned char, XL_KEYHASH_SIZE> none = {};
+  for (int i = 0; i < Tcount; ++i) {
+    int len = length(keywords[i]);
+    unsigned int h = hashkey(keywords[i], len);
+    if (len > XL_KEYWORD_MAXLEN || table[h] != 0)
+      return none;
+    table[h] = (unsigned char)(i + 1);
+  }
+  return table;
+}
+
+inline constexpr std::array<unsigned char, XL_KEYHASH_SIZE> keyhash =
+  makekeyhash();
+
+/*
+Index of the keyword in the string or -1, like XL_find_keyword.
+*/
+constexpr int
+find_keyword(const char *str, int len)
+{
+  int t = len > XL_KEYWORD_MAXLEN ? -1 : keyhash[hashkey(str, len)] - 1;
+  if (t < 0 || len != length(keywords[t]))
+    return -1;
+  for (int i = 0; i < len; ++i)
+    if (keywords[t][i] != str[i])
+      return -1;
+  return t;
+}
+
+/*
+True if the tables have the same bytes.
+*/
+constexpr bool
+samekeyhash(const std::array<unsigned char, XL_KEYHASH_SIZE> &a
+           , const std::array<unsigned char, XL_KEYHASH_SIZE> &b)
+{
+  for (std::size_t i = 0; i < a.size(); ++i)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+static_assert(keyhash[hashkey("nop", 3)] == Tnop + 1
+             , "The keywords collide or are longer than XL_KEYWORD_MAXLEN");
+static_assert(samekeyhash(keyhash
+                         , std::array<unsigned char, XL_KEYHASH_SIZE>
+                           XL_KEYHASH_INIT)
+             , "XL_KEYHASH_INIT is stale, run xlas -K");
+static_assert(find_keyword("lda", 3) == Tlda && find_keyword("ld", 2) == -1
+             , "xl::find_keyword does not match XL_find_keyword");
+
+/************************************************************/
+/* CORE                                                     */
+/************************************************************/
+
+template<class Bus>
+class Core {
+public:
+  explicit Core(Bus &bus) : bus(bus) {}
+
+  /*
+  Run exactly one CPU cycle like XL_cycle. Return true if this
+  cycle has started a new instruction.
+  */
+  bool
+  cycle()
+  {
+    if (icycles != 0) {
+      icycles -= 1;
+      return false;
+    }
+    return start();
+  }
+
+  /*
+  Run the cycles, return them.
+  */
+  unsigned long
+  run(unsigned long cycles)
+  {
+    return run(cycles, [] { return false; });
+  }
+
+  /*
+  Run the cycles, stop after the instruction for which stop()
+  is true. Return the cycles run.
+  */
+  template<class Stop>
+  unsigned long
+  run(unsigned long cycles, Stop stop)
+  {
+    unsigned long n = 0;
+    while (n < cycles) {
+      n += 1;
+      if (cycle() && stop())
+        break;
+    }
+    return n;
+  }
+
+  /*
+  Start/restart the CPU like XL_restart.
+  */
+  void restart() { is_reset = true; }
+
+  /*
+  Request the interrupts like XL_int_break, XL_int_react and
+  XL_int_reset.
+  */
+  void int_break() { is_break = true; }
+  void int_react() { is_react = true; }
+  void int_reset() { is_reset = true; }
+
+  XL_Word icycles = 0; /* Current instruction cycles */
+  XL_Word addr = 0; /* Address from the address mode */
+  XL_Word p = 0; /* The program counter */
+  XL_Byte a = 0; /* The accumulator */
+  XL_Byte f = 0; /* The status flags */
+  XL_Byte s = 0; /* The stack index */
+  XL_Byte x = 0; /* The X register */
+  XL_Byte y = 0; /* The Y register */
+  bool next_b_flag = false; /* The B flag on the next interrupt */
+  bool is_invalid = false; /* invalid insructions executed */
+  bool is_break = false; /* Break interrupt */
+  bool is_react = false; /* React interrupt */
+  bool is_reset = false; /* Reset interrupt */
+
+private:
+  using Handler = void (Core::*)();
+
+  /*
+  The cycle without waiting: reset, interrupt or instruction.
+  */
+  bool
+  start()
+  {
+    XL_Word int_addr = 0;
+    bool go_int = false;
+    if (is_reset) {
+      icycles = 1;
+      is_reset = false;
+      is_break = false;
+      is_react = false;
+      next_b_flag = false;
+      p = load_word(0xFFFE);
+      a = f = s = x = y = 0;
+      bus.event(XL_EVENT_RESET);
+      return false;
+    }
+    if (is_break) {
+      is_break = false;
+      int_addr = 0xFFFA;
+      go_int = !get_flag(XL_FLAG_D);
+    }
+    if (is_react) {
+      is_react = false;
+      int_addr = 0xFFFC;
+      go_int = true;
+    }
+    if (go_int) {
+      icycles = 4;
+      push_word(p);
+      push(f);
+      p = load_word(int_addr);
+      set_flag(XL_FLAG_D, 1);
+      set_flag(XL_FLAG_B, next_b_flag);
+      next_b_flag = false;
+      bus.event(XL_EVENT_INT);
+      return false;
+    }
+    XL_Byte op = bus.load(p);
+    p += 1;
+    (this->*handlers[op])();
+    return true;
+  }
+
+  /*
+  The addressing mode and the instruction of the byte.
+  */
+  template<int Byte>
+  void
+  exec()
+  {
+    mode<ops[Byte].amode>();
+    inst<ops[Byte].inst>();
+  }
+
+  template<std::size_t... Bytes>
+  static constexpr std::array<Handler, XL_NUM_COMBOS>
+  table(std::index_sequence<Bytes...>)
+  {
+    return {{&Core::exec<Bytes>...}};
+  }
+
+  static constexpr std::array<Handler, XL_NUM_COMBOS> handlers =
+    table(std::make_index_sequence<XL_NUM_COMBOS>());
+
+  void
+  set_flag(XL_Byte fmask, bool value)
+  {
+    if (value)
+      f |= fmask;
+    else
+      f &= ~fmask;
+  }
+
+  bool get_flag(XL_Byte fmask) const { return (f & fmask) != 0; }
+
+  void
+  set_zn(XL_Byte t)
+  {
+    set_flag(XL_FLAG_Z, t == 0);
+    set_flag(XL_FLAG_N, (t & 0x80) != 0);
+  }
+
+  XL_Word
+  load_word(XL_Word at)
+  {
+    XL_Byte lsb = bus.load(at);
+    XL_Byte msb = bus.load(at + 1);
+    return (msb << 8) | lsb;
+  }
+
+  XL_Word
+  load_word_zpg(XL_Word at)
+  {
+    XL_Byte lsb = bus.load(at & 0xFF);
+    XL_Byte msb = bus.load((at + 1) & 0xFF);
+    return (msb << 8) | lsb;
+  }
+
+  XL_Byte
+  pull()
+  {
+    s -= 1;
+    return bus.load(0x0100 | s);
+  }
+
+  XL_Word
+  pull_word()
+  {
+    XL_Byte lsb = pull();
+    XL_Byte msb = pull();
+    return (msb << 8) | lsb;
+  }
+
+  void
+  push(XL_Byte data)
+  {
+    bus.store(0x0100 | s, data);
+    s += 1;
+  }
+
+  void
+  push_word(XL_Word data)
+  {
+    push(data >> 8);
+    push(data & 0xFF);
+  }
+
+  XL_Byte
+  alu_add(XL_Byte l, XL_Byte r, bool c)
+  {
+    XL_Word tt = l + r + c;
+    XL_Byte t = tt;
+    XL_Byte v = ~(l ^ r) & (l ^ t) & 0x80;
+    set_flag(XL_FLAG_V, v != 0);
+    set_flag(XL_FLAG_C, (tt & 0xFF00) != 0);
+    set_zn(t);
+    return t;
+  }
+
+  XL_Byte
+  alu_sub(XL_Byte l, XL_Byte notr, bool c)
+  {
+    XL_Byte r = ~notr;
+    XL_Word tt = l + r + c;
+    XL_Byte t = tt;
+    XL_Byte v = (t ^ l) & (t ^ r) & 0x80;
+    set_flag(XL_FLAG_V, v != 0);
+    set_flag(XL_FLAG_C, (tt & 0xFF00) != 0);
+    set_zn(t);
+    return t;
+  }
+
+  XL_Byte
+  alu_shr(XL_Byte l, bool c)
+  {
+    XL_Byte t = (l >> 1) | (c ? 0x80 : 0);
+    set_flag(XL_FLAG_C, (l & 1) != 0);
+    set_zn(t);
+    return t;
+  }
+
+  XL_Byte
+  alu_shl(XL_Byte l, bool c)
+  {
+    XL_Byte t = (l << 1) | c;
+    set_flag(XL_FLAG_C, (l & 0x80) != 0);
+    set_zn(t);
+    return t;
+  }
+
+  XL_Byte
+  alu_zn(XL_Byte t)
+  {
+    set_zn(t);
+    return t;
+  }
+
+  template<int Mode>
+  void
+  mode()
+  {
+    XL_Word vec = 0;
+    if constexpr (Mode == Mimm) {
+      addr = p;
+      p += 1;
+    }
+    else if constexpr (Mode == Mabs || Mode == Mabx || Mode == Maby) {
+      addr = load_word(p);
+      if constexpr (Mode == Mabx)
+        addr += x;
+      if constexpr (Mode == Maby)
+        addr += y;
+      p += 2;
+      icycles += 2;
+    }
+    else if constexpr (Mode == Mrel) {
+      XL_Word offset = bus.load(p);
+      p += 1;
+      if (offset > 127)
+        offset |= 0xFF00;
+      addr = p + offset - 2;
+      icycles += 1;
+    }
+    else if constexpr (Mode == Mzpg) {
+      addr = bus.load(p);
+      p += 1;
+      icycles += 1;
+    }
+    else if constexpr (Mode == Mzpx || Mode == Mzpy) {
+      addr = (bus.load(p) + (Mode == Mzpx ? x : y)) & 0xFF;
+      p += 1;
+      icycles += 1;
+    }
+    else if constexpr (Mode == Mvec) {
+      vec = load_word(p);
+      p += 2;
+      addr = load_word(vec);
+      icycles += 4;
+    }
+    else if constexpr (Mode == Mzvx) {
+      vec = bus.load(p);
+      p += 1;
+      addr = load_word_zpg(vec) + x;
+      icycles += 3;
+    }
+    else if constexpr (Mode == Mzyv) {
+      vec = (bus.load(p) + y) & 0xFF;
+      p += 1;
+      addr = load_word_zpg(vec);
+      icycles += 3;
+    }
+    (void)vec;
+  }
+
+  /*
+  The flag and its value of the conditional jumps, 0 for the others.
+  */
+  static constexpr int
+  jumpflag(int in)
+  {
+    switch (in) {
+    case Tjfb: case Tjtb: return XL_FLAG_B;
+    case Tjfc: case Tjtc: return XL_FLAG_C;
+    case Tjfd: case Tjtd: return XL_FLAG_D;
+    case Tjfn: case Tjtn: return XL_FLAG_N;
+    case Tjfr: case Tjtr: return XL_FLAG_R;
+    case Tjfu: case Tjtu: return XL_FLAG_U;
+    case Tjfv: case Tjtv: return XL_FLAG_V;
+    case Tjfz: case Tjtz: return XL_FLAG_Z;
+    default: return 0;
+    }
+  }
+
+  template<int In>
+  void
+  inst()
+  {
+    XL_Byte data = 0;
+    if constexpr (jumpflag(In) != 0) {
+      if (get_flag(jumpflag(In)) == (In >= Tjtb))
+        p = addr;
+    }
+    else if constexpr (In == Tinv) {
+      if (!is_invalid) {
+        is_invalid = true;
+        bus.error(XL_ERR_INVALID);
+      }
+    }
+    else if constexpr (In == Tbrk) {
+      is_break = true;
+      next_b_flag = true;
+    }
+    else if constexpr (In == Trti) {
+      f = pull();
+      p = pull_word();
+      icycles += 3;
+      bus.event(XL_EVENT_RTI);
+    }
+    else if constexpr (In == Tret) {
+      p = pull_word();
+      icycles += 2;
+      bus.event(XL_EVENT_RET);
+    }
+    else if constexpr (In == Tfor) {
+      f |= bus.load(addr);
+      icycles += 1;
+    }
+    else if constexpr (In == Tfnd) {
+      f &= bus.load(addr);
+      icycles += 1;
+    }
+    else if constexpr (In == Tclc) {
+      set_flag(XL_FLAG_C, 0);
+    }
+    else if constexpr (In == Tapp) { a = alu_zn(a + 1); }
+    else if constexpr (In == Tamm) { a = alu_zn(a - 1); }
+    else if constexpr (In == Tspp) { s = alu_zn(s + 1); }
+    else if constexpr (In == Tsmm) { s = alu_zn(s - 1); }
+    else if constexpr (In == Txpp) { x = alu_zn(x + 1); }
+    else if constexpr (In == Txmm) { x = alu_zn(x - 1); }
+    else if constexpr (In == Typp) { y = alu_zn(y + 1); }
+    else if constexpr (In == Tymm) { y = alu_zn(y - 1); }
+    else if constexpr (In == Tinc || In == Tdec) {
+      data = bus.load(addr);
+      data = alu_zn(In == Tinc ? data + 1 : data - 1);
+      bus.store(addr, data);
+      icycles += 2;
+    }
+    else if constexpr (In == Tjmp) {
+      p = addr;
+    }
+    else if constexpr (In == Tcal) {
+      push_word(p);
+      p = addr;
+      icycles += 2;
+      bus.event(XL_EVENT_CALL);
+    }
+    else if constexpr (In == Tlda) {
+      a = alu_zn(bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tldx) {
+      x = alu_zn(bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tldy) {
+      y = alu_zn(bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tsta || In == Tstx || In == Tsty) {
+      bus.store(addr, In == Tsta ? a : In == Tstx ? x : y);
+      icycles += 1;
+    }
+    else if constexpr (In == Tpla) {
+      a = alu_zn(pull());
+      icycles += 1;
+    }
+    else if constexpr (In == Tplf) {
+      f = pull();
+      icycles += 1;
+    }
+    else if constexpr (In == Tplx) {
+      x = alu_zn(pull());
+      icycles += 1;
+    }
+    else if constexpr (In == Tply) {
+      y = alu_zn(pull());
+      icycles += 1;
+    }
+    else if constexpr (In == Tpha || In == Tphf || In == Tphx
+                      || In == Tphy) {
+      push(In == Tpha ? a : In == Tphf ? f : In == Tphx ? x : y);
+      icycles += 1;
+    }
+    else if constexpr (In == Ttaf) { f = a; }
+    else if constexpr (In == Ttas) { s = a; }
+    else if constexpr (In == Ttax) { x = a; }
+    else if constexpr (In == Ttay) { y = a; }
+    else if constexpr (In == Ttfa) { a = f; }
+    else if constexpr (In == Ttsa) { a = s; }
+    else if constexpr (In == Ttxa) { a = x; }
+    else if constexpr (In == Ttya) { a = y; }
+    else if constexpr (In == Tcmp || In == Tcpx || In == Tcpy) {
+      data = bus.load(addr);
+      alu_sub(In == Tcmp ? a : In == Tcpx ? x : y, data, 0);
+      icycles += 1;
+    }
+    else if constexpr (In == Tsbc || In == Tsub) {
+      bool c = In == Tsbc && get_flag(XL_FLAG_C);
+      data = bus.load(addr);
+      a = alu_sub(a, data, c);
+      icycles += 1;
+    }
+    else if constexpr (In == Tadc || In == Tadd) {
+      bool c = In == Tadc && get_flag(XL_FLAG_C);
+      data = bus.load(addr);
+      a = alu_add(a, data, c);
+      icycles += 1;
+    }
+    else if constexpr (In == Tbor) {
+      a = alu_zn(a | bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Txor) {
+      a = alu_zn(a ^ bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tand) {
+      a = alu_zn(a & bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tbit) {
+      alu_zn(a & bus.load(addr));
+      icycles += 1;
+    }
+    else if constexpr (In == Tnot) {
+      data = bus.load(addr);
+      bus.store(addr, alu_zn(~data));
+      icycles += 2;
+    }
+    else if constexpr (In == Tnta) {
+      a = alu_zn(~a);
+    }
+    else if constexpr (In == Tshl || In == Tshr) {
+      bool c = get_flag(XL_FLAG_C);
+      data = bus.load(addr);
+      bus.store(addr, In == Tshl ? alu_shl(data, c) : alu_shr(data, c));
+      icycles += 2;
+    }
+    else if constexpr (In == Tsla) {
+      a = alu_shl(a, get_flag(XL_FLAG_C));
+    }
+    else if constexpr (In == Tsra) {
+      a = alu_shr(a, get_flag(XL_FLAG_C));
+    }
+    else if constexpr (In == Tzra) { a = 0; }
+    else if constexpr (In == Tzrx) { x = 0; }
+    else if constexpr (In == Tzry) { y = 0; }
+    (void)data;
+  }
+
+  Bus &bus;
+};
+
+} /* namespace xl */
+
+#endif /* EXTENDED_LEMON_HPP */
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
@@ -10,6 +10,12 @@ See LICENSE information in the end of the file.
 #ifndef XL_EXTRA_H
 #define XL_EXTRA_H
 
+/************************************************************/
+/* INCLUDES                                                 */
+/************************************************************/
+
+#include "extended_lemon.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -23,6 +29,101 @@ The number of instruction combinations.
 */
 #define XL_NUM_COMBOS 256
 
+/*
+Value of XL_opcodes for invalid combinations.
+*/
+#define XL_NO_OPCODE -1
+
+/*
+Size of one execution trace record in bytes.
+*/
+#define XL_TRACE_SIZE 16
+
+/*
+First bytes of an execution trace file.
+*/
+#define XL_TRACE_MAGIC "XLTR0001"
+
+/*
+First bytes of a heatmap file. The magic is followed by
+XL_HEAT_COUNT arrays of 65536 counters, one counter for every
+address. Counters are 32-bit unsigned integers in little endian.
+*/
+#define XL_HEAT_MAGIC "XLHM0001"
+
+/*
+First bytes of a relocatable object file. The magic is followed by
+three 16-bit counts: code bytes, symbols and relocations. Then go
+the code assembled at $8000, the symbols and the relocations.
+A symbol is a 16-bit offset in the code, a XL_SYM_ byte, a length
+byte and the name. A relocation is a 16-bit offset in the code,
+a XL_RELOC_ byte, a zero byte and a 16-bit symbol index or
+XL_RELOC_SELF. All numbers are little endian.
+*/
+#define XL_OBJECT_MAGIC "XLOB0001"
+
+/*
+First bytes of a golden trace file of xlgold. The magic is followed
+by the 32-bit number of cases. A case is the opcode at P, the 32-bit
+seed of the other bytes, the registers P (16-bit), A, F, S, X and Y,
+a 16-bit number of steps and the steps. A step is the number of
+XL_cycle calls up to the one that returned 1, the icycles left,
+the registers after it, a 16-bit number of accesses and the accesses:
+a XL_GOLD_ byte, a 16-bit address and a data byte. All numbers are
+little endian.
+*/
+#define XL_GOLD_MAGIC "XLGT0001"
+
+/*
+Longest text of XL_format, including the terminating zero.
+*/
+#define XL_FORMAT_MAX 32
+
+/*
+Symbol index of relocations against the object itself.
+*/
+#define XL_RELOC_SELF 0xFFFF
+
+/*
+Size of XL_keyhash, a power of two.
+*/
+#define XL_KEYHASH_SIZE 256
+
+/*
+Seed of XL_hashkey, chosen so that no two keywords collide
+in XL_keyhash. Pick another one if xlas -K fails.
+*/
+#define XL_KEYHASH_SEED 51316899UL
+
+/*
+Length of the longest keyword, XL_init_keywords fails if a keyword
+is longer.
+*/
+#define XL_KEYWORD_MAXLEN 7
+
+/*
+Initializer of XL_keyhash written by xlas -K. Run it again after
+changing XL_KEYWORDS_XM or XL_KEYHASH_SEED and paste the output.
+*/
+#define XL_KEYHASH_INIT { \
+    4,  0,  0,  0,  0, 71, 61,  0,  0,  0,  0, 66, 73, 25,  0,  0, \
+    0,  0,  0,  0,  0,  0,  2,  0, 55, 33,  0,  0, 77, 52,  0,  0, \
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 39, 32, 50,  0,  0,  0, \
+    0,  0,  0, 92, 83, 59, 58, 65,  3,  0,  0,  0, 89,  0,  0,  0, \
+   91,  0, 60, 87, 70,  0, 45,  0,  0,  0,  0,  0, 88,  0,  0,  0, \
+    0, 19,  0,  0,  0,  9, 90,  0,  0,  0,  0,  0, 16,  0,  0,  0, \
+    0, 72,  0, 27, 48,  0,  0, 40,  0,  0,  0,  0, 13, 17,  0,  0, \
+   18,  0, 51,  0,  0,  0,  0,  0,  0,  0, 15,  0, 43,  0, 86,  0, \
+    0,  0,  0,  0, 53,  0, 42,  0, 20,  0,  0,  0, 26,  0,  5, 79, \
+   85,  0,  0, 69,  0,  0,  0,  0, 24,  0,  0,  0,  0, 22,  0, 44, \
+    0, 57,  0, 67, 10,  0, 78,  0,  0,  0,  0, 14, 64, 36, 23, 35, \
+   82, 76,  1,  0,  0, 54,  0,  0,  0, 21, 68, 28,  0,  0,  0, 37, \
+    0, 34,  0,  0, 31,  0,  0,  0,  0,  0,  0,  0, 75,  0, 41,  0, \
+    0,  6,  0,  0,  0,  0,  0, 81,  0, 62,  0, 29,  0,  0,  0, 63, \
+   49, 47, 12,  0,  0, 38, 46, 80,  0,  0,  7,  0, 74,  0,  8,  0, \
+    0,  0, 30,  0,  0,  0,  0, 84,  0,  0, 56,  0, 11,  0,  0,  0 \
+}
+
 /*
 XLAS keywords X-macro.
 */
@@ -106,30 +207,130 @@ XLAS keywords X-macro.
   X(zrx) \
   X(zry) \
   X(let) \
+  X(var) \
   X(rb) \
   X(db) \
   X(dw) \
   X(include) \
   X(incbin) \
+  X(macro) \
+  X(inline) \
+  X(endm) \
+  X(rept) \
+  X(endr) \
   X(x) \
   X(y)
 
 /*
-XL addressing modes X-macro.
+XL addressing modes X-macro, the name, the instruction size, the
+extra cycles, the registers read (XL_REG_ mask) and the memory
+read (XL_MEM_ mask) to find the address.
 */
 #define XL_ADDRMODES_XM \
-  X(nam) \
-  X(imm) \
-  X(abs) \
-  X(abx) \
-  X(aby) \
-  X(rel) \
-  X(zpg) \
-  X(zpx) \
-  X(zpy) \
-  X(vec) \
-  X(zvx) \
-  X(zyv)
+  X(nam, 1, 0, 0, 0) \
+  X(imm, 2, 0, 0, 0) \
+  X(abs, 3, 2, 0, 0) \
+  X(abx, 3, 2, XL_REG_X, 0) \
+  X(aby, 3, 2, XL_REG_Y, 0) \
+  X(rel, 2, 1, XL_REG_P, 0) \
+  X(zpg, 2, 1, 0, 0) \
+  X(zpx, 2, 1, XL_REG_X, 0) \
+  X(zpy, 2, 1, XL_REG_Y, 0) \
+  X(vec, 3, 4, 0, XL_MEM_POINTER) \
+  X(zvx, 2, 3, XL_REG_X, XL_MEM_POINTER) \
+  X(zyv, 2, 3, XL_REG_Y, XL_MEM_POINTER)
+
+/*
+XL instruction effects X-macro, the keyword, the extra cycles, the
+flags read and written (XL_FLAG_ masks), the registers read and
+written (XL_REG_ masks) and the memory accessed (XL_MEM_ mask) by
+the instruction after its addressing mode. A written flag or
+register may keep its value, like Z of lda when the byte is not 0.
+*/
+#define XL_EFFECTS_XM \
+  X(inv, 0, 0, 0, 0, 0, 0) \
+  X(nop, 0, 0, 0, 0, 0, 0) \
+  X(brk, 0, 0, 0, 0, 0, 0) \
+  X(rti, 3, 0, XL_FLAGS_ALL, XL_REG_S, XL_REG_P | XL_REG_S \
+    , XL_MEM_PULL) \
+  X(ret, 2, 0, 0, XL_REG_S, XL_REG_P | XL_REG_S, XL_MEM_PULL) \
+  X(for, 1, XL_FLAGS_ALL, XL_FLAGS_ALL, 0, 0, XL_MEM_LOAD) \
+  X(fnd, 1, XL_FLAGS_ALL, XL_FLAGS_ALL, 0, 0, XL_MEM_LOAD) \
+  X(clc, 0, 0, XL_FLAG_C, 0, 0, 0) \
+  X(app, 0, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, 0) \
+  X(amm, 0, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, 0) \
+  X(spp, 0, 0, XL_FLAGS_ZN, XL_REG_S, XL_REG_S, 0) \
+  X(smm, 0, 0, XL_FLAGS_ZN, XL_REG_S, XL_REG_S, 0) \
+  X(xpp, 0, 0, XL_FLAGS_ZN, XL_REG_X, XL_REG_X, 0) \
+  X(xmm, 0, 0, XL_FLAGS_ZN, XL_REG_X, XL_REG_X, 0) \
+  X(ypp, 0, 0, XL_FLAGS_ZN, XL_REG_Y, XL_REG_Y, 0) \
+  X(ymm, 0, 0, XL_FLAGS_ZN, XL_REG_Y, XL_REG_Y, 0) \
+  X(inc, 2, 0, XL_FLAGS_ZN, 0, 0, XL_MEM_LOAD | XL_MEM_STORE) \
+  X(dec, 2, 0, XL_FLAGS_ZN, 0, 0, XL_MEM_LOAD | XL_MEM_STORE) \
+  X(jfb, 0, XL_FLAG_B, 0, 0, XL_REG_P, 0) \
+  X(jfc, 0, XL_FLAG_C, 0, 0, XL_REG_P, 0) \
+  X(jfd, 0, XL_FLAG_D, 0, 0, XL_REG_P, 0) \
+  X(jfn, 0, XL_FLAG_N, 0, 0, XL_REG_P, 0) \
+  X(jfr, 0, XL_FLAG_R, 0, 0, XL_REG_P, 0) \
+  X(jfu, 0, XL_FLAG_U, 0, 0, XL_REG_P, 0) \
+  X(jfv, 0, XL_FLAG_V, 0, 0, XL_REG_P, 0) \
+  X(jfz, 0, XL_FLAG_Z, 0, 0, XL_REG_P, 0) \
+  X(jtb, 0, XL_FLAG_B, 0, 0, XL_REG_P, 0) \
+  X(jtc, 0, XL_FLAG_C, 0, 0, XL_REG_P, 0) \
+  X(jtd, 0, XL_FLAG_D, 0, 0, XL_REG_P, 0) \
+  X(jtn, 0, XL_FLAG_N, 0, 0, XL_REG_P, 0) \
+  X(jtr, 0, XL_FLAG_R, 0, 0, XL_REG_P, 0) \
+  X(jtu, 0, XL_FLAG_U, 0, 0, XL_REG_P, 0) \
+  X(jtv, 0, XL_FLAG_V, 0, 0, XL_REG_P, 0) \
+  X(jtz, 0, XL_FLAG_Z, 0, 0, XL_REG_P, 0) \
+  X(jmp, 0, 0, 0, 0, XL_REG_P, 0) \
+  X(cal, 2, 0, 0, XL_REG_P | XL_REG_S, XL_REG_P | XL_REG_S \
+    , XL_MEM_PUSH) \
+  X(lda, 1, 0, XL_FLAGS_ZN, 0, XL_REG_A, XL_MEM_LOAD) \
+  X(ldx, 1, 0, XL_FLAGS_ZN, 0, XL_REG_X, XL_MEM_LOAD) \
+  X(ldy, 1, 0, XL_FLAGS_ZN, 0, XL_REG_Y, XL_MEM_LOAD) \
+  X(sta, 1, 0, 0, XL_REG_A, 0, XL_MEM_STORE) \
+  X(stx, 1, 0, 0, XL_REG_X, 0, XL_MEM_STORE) \
+  X(sty, 1, 0, 0, XL_REG_Y, 0, XL_MEM_STORE) \
+  X(pla, 1, 0, XL_FLAGS_ZN, XL_REG_S, XL_REG_A | XL_REG_S \
+    , XL_MEM_PULL) \
+  X(plf, 1, 0, XL_FLAGS_ALL, XL_REG_S, XL_REG_S, XL_MEM_PULL) \
+  X(plx, 1, 0, XL_FLAGS_ZN, XL_REG_S, XL_REG_X | XL_REG_S \
+    , XL_MEM_PULL) \
+  X(ply, 1, 0, XL_FLAGS_ZN, XL_REG_S, XL_REG_Y | XL_REG_S \
+    , XL_MEM_PULL) \
+  X(pha, 1, 0, 0, XL_REG_A | XL_REG_S, XL_REG_S, XL_MEM_PUSH) \
+  X(phf, 1, XL_FLAGS_ALL, 0, XL_REG_S, XL_REG_S, XL_MEM_PUSH) \
+  X(phx, 1, 0, 0, XL_REG_X | XL_REG_S, XL_REG_S, XL_MEM_PUSH) \
+  X(phy, 1, 0, 0, XL_REG_Y | XL_REG_S, XL_REG_S, XL_MEM_PUSH) \
+  X(taf, 0, 0, XL_FLAGS_ALL, XL_REG_A, 0, 0) \
+  X(tas, 0, 0, 0, XL_REG_A, XL_REG_S, 0) \
+  X(tax, 0, 0, 0, XL_REG_A, XL_REG_X, 0) \
+  X(tay, 0, 0, 0, XL_REG_A, XL_REG_Y, 0) \
+  X(tfa, 0, XL_FLAGS_ALL, 0, 0, XL_REG_A, 0) \
+  X(tsa, 0, 0, 0, XL_REG_S, XL_REG_A, 0) \
+  X(txa, 0, 0, 0, XL_REG_X, XL_REG_A, 0) \
+  X(tya, 0, 0, 0, XL_REG_Y, XL_REG_A, 0) \
+  X(cmp, 1, 0, XL_FLAGS_VCZN, XL_REG_A, 0, XL_MEM_LOAD) \
+  X(cpx, 1, 0, XL_FLAGS_VCZN, XL_REG_X, 0, XL_MEM_LOAD) \
+  X(cpy, 1, 0, XL_FLAGS_VCZN, XL_REG_Y, 0, XL_MEM_LOAD) \
+  X(sbc, 1, XL_FLAG_C, XL_FLAGS_VCZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(sub, 1, 0, XL_FLAGS_VCZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(adc, 1, XL_FLAG_C, XL_FLAGS_VCZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(add, 1, 0, XL_FLAGS_VCZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(bor, 1, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(xor, 1, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(and, 1, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, XL_MEM_LOAD) \
+  X(bit, 1, 0, XL_FLAGS_ZN, XL_REG_A, 0, XL_MEM_LOAD) \
+  X(not, 2, 0, XL_FLAGS_ZN, 0, 0, XL_MEM_LOAD | XL_MEM_STORE) \
+  X(nta, 0, 0, XL_FLAGS_ZN, XL_REG_A, XL_REG_A, 0) \
+  X(shl, 2, XL_FLAG_C, XL_FLAGS_CZN, 0, 0, XL_MEM_LOAD | XL_MEM_STORE) \
+  X(shr, 2, XL_FLAG_C, XL_FLAGS_CZN, 0, 0, XL_MEM_LOAD | XL_MEM_STORE) \
+  X(sla, 0, XL_FLAG_C, XL_FLAGS_CZN, XL_REG_A, XL_REG_A, 0) \
+  X(sra, 0, XL_FLAG_C, XL_FLAGS_CZN, XL_REG_A, XL_REG_A, 0) \
+  X(zra, 0, 0, 0, 0, XL_REG_A, 0) \
+  X(zrx, 0, 0, 0, 0, XL_REG_X, 0) \
+  X(zry, 0, 0, 0, 0, XL_REG_Y, 0)
 
 /*
 XL interrupts X-macro.
@@ -140,6 +341,76 @@ XL interrupts X-macro.
   X(react) \
   X(reset)
 
+/*
+XL instructions X-macro, the keyword and the addressing mode of
+every instruction byte from 0x00 to 0xFF.
+*/
+#define XL_COMBOS_XM \
+  X(inv, nam) X(brk, nam) X(rti, nam) X(ret, nam) \
+  X(for, imm) X(fnd, imm) X(clc, nam) X(nop, nam) \
+  X(app, nam) X(amm, nam) X(spp, nam) X(smm, nam) \
+  X(xpp, nam) X(xmm, nam) X(ypp, nam) X(ymm, nam) \
+  X(jfb, rel) X(jfc, rel) X(jfd, rel) X(jfn, rel) \
+  X(jfr, rel) X(jfu, rel) X(jfv, rel) X(jfz, rel) \
+  X(jtb, rel) X(jtc, rel) X(jtd, rel) X(jtn, rel) \
+  X(jtr, rel) X(jtu, rel) X(jtv, rel) X(jtz, rel) \
+  X(pha, nam) X(phf, nam) X(phx, nam) X(phy, nam) \
+  X(pla, nam) X(plf, nam) X(plx, nam) X(ply, nam) \
+  X(taf, nam) X(tas, nam) X(tax, nam) X(tay, nam) \
+  X(tfa, nam) X(tsa, nam) X(txa, nam) X(tya, nam) \
+  X(lda, imm) X(lda, abs) X(lda, zpg) X(lda, vec) \
+  X(lda, abx) X(lda, aby) X(lda, zpx) X(lda, zpy) \
+  X(zra, nam) X(sta, abs) X(sta, zpg) X(sta, vec) \
+  X(sta, abx) X(sta, aby) X(sta, zpx) X(sta, zpy) \
+  X(zrx, nam) X(ldx, imm) X(ldx, abs) X(ldx, aby) \
+  X(ldx, zpg) X(ldx, zpy) X(ldx, vec) X(ldx, zyv) \
+  X(zry, nam) X(ldy, imm) X(ldy, abs) X(ldy, abx) \
+  X(ldy, zpg) X(ldy, zpx) X(ldy, vec) X(ldy, zvx) \
+  X(cmp, imm) X(cmp, abs) X(cmp, zpg) X(cmp, vec) \
+  X(cmp, abx) X(cmp, aby) X(cmp, zpx) X(cmp, zpy) \
+  X(jmp, rel) X(jmp, abs) X(jmp, zpg) X(jmp, vec) \
+  X(jmp, abx) X(jmp, aby) X(jmp, zpx) X(jmp, zpy) \
+  X(stx, abs) X(stx, aby) X(stx, zpg) X(stx, zpy) \
+  X(stx, vec) X(stx, zyv) X(lda, zvx) X(lda, zyv) \
+  X(sty, abs) X(sty, abx) X(sty, zpg) X(sty, zpx) \
+  X(sty, vec) X(sty, zvx) X(sta, zvx) X(sta, zyv) \
+  X(nta, nam) X(cal, abs) X(cal, zpg) X(cal, vec) \
+  X(cal, abx) X(cal, aby) X(cal, zpx) X(cal, zpy) \
+  X(cal, zvx) X(cal, zyv) X(jmp, zvx) X(jmp, zyv) \
+  X(cmp, zvx) X(cmp, zyv) X(sla, nam) X(sra, nam) \
+  X(inc, abs) X(inc, abx) X(inc, aby) X(inc, zpg) \
+  X(inc, zpx) X(inc, zpy) X(inc, vec) X(inc, zvx) \
+  X(inc, zyv) X(cpx, imm) X(cpx, abs) X(cpx, aby) \
+  X(cpx, zpg) X(cpx, zpy) X(cpx, vec) X(cpx, zyv) \
+  X(dec, abs) X(dec, abx) X(dec, aby) X(dec, zpg) \
+  X(dec, zpx) X(dec, zpy) X(dec, vec) X(dec, zvx) \
+  X(dec, zyv) X(cpy, imm) X(cpy, abs) X(cpy, abx) \
+  X(cpy, zpg) X(cpy, zpx) X(cpy, vec) X(cpy, zvx) \
+  X(bit, imm) X(bit, abs) X(bit, zpg) X(bit, vec) \
+  X(bit, abx) X(bit, aby) X(bit, zpx) X(bit, zpy) \
+  X(and, imm) X(and, abs) X(and, zpg) X(and, vec) \
+  X(and, abx) X(and, aby) X(and, zpx) X(and, zpy) \
+  X(bor, imm) X(bor, abs) X(bor, zpg) X(bor, vec) \
+  X(bor, abx) X(bor, aby) X(bor, zpx) X(bor, zpy) \
+  X(xor, imm) X(xor, abs) X(xor, zpg) X(xor, vec) \
+  X(xor, abx) X(xor, aby) X(xor, zpx) X(xor, zpy) \
+  X(adc, imm) X(adc, abs) X(adc, zpg) X(adc, vec) \
+  X(adc, abx) X(adc, aby) X(adc, zpx) X(adc, zpy) \
+  X(sbc, imm) X(sbc, abs) X(sbc, zpg) X(sbc, vec) \
+  X(sbc, abx) X(sbc, aby) X(sbc, zpx) X(sbc, zpy) \
+  X(add, imm) X(add, abs) X(add, zpg) X(add, vec) \
+  X(add, abx) X(add, aby) X(add, zpx) X(add, zpy) \
+  X(sub, imm) X(sub, abs) X(sub, zpg) X(sub, vec) \
+  X(sub, abx) X(sub, aby) X(sub, zpx) X(sub, zpy) \
+  X(bit, zvx) X(bit, zyv) X(and, zvx) X(and, zyv) \
+  X(bor, zvx) X(bor, zyv) X(xor, zvx) X(xor, zyv) \
+  X(adc, zvx) X(adc, zyv) X(sbc, zvx) X(sbc, zyv) \
+  X(add, zvx) X(add, zyv) X(sub, zvx) X(sub, zyv) \
+  X(not, zpg) X(not, zpx) X(not, abs) X(not, abx) \
+  X(shl, zpg) X(shl, zpx) X(shl, abs) X(shl, abx) \
+  X(shr, zpg) X(shr, zpx) X(shr, abs) X(shr, abx) \
+  X(inv, nam) X(inv, nam) X(inv, nam) X(inv, nam)
+
 /************************************************************/
 /* TYPES                                                    */
 /************************************************************/
@@ -158,7 +429,7 @@ XL_KEYWORDS_XM
 Addressing mode type.
 */
 enum {
-#define X(name) M##name,
+#define X(name, size, cycles, regs, mem) M##name,
 XL_ADDRMODES_XM
 #undef X
   Mcount
@@ -174,6 +445,141 @@ XL_INTERRUPTS_XM
   Icount
 };
 
+/*
+Register mask of the instruction effects. P is read when its value
+is used, not to fetch, and written when a jump may change it.
+*/
+enum {
+  XL_REG_P = (1 << 0),
+  XL_REG_A = (1 << 1),
+  XL_REG_S = (1 << 2),
+  XL_REG_X = (1 << 3),
+  XL_REG_Y = (1 << 4)
+};
+
+/*
+Memory mask of the instruction effects.
+*/
+enum {
+  XL_MEM_LOAD = (1 << 0), /* Loads the byte at the address */
+  XL_MEM_STORE = (1 << 1), /* Stores the byte at the address */
+  XL_MEM_PULL = (1 << 2), /* Loads from the stack */
+  XL_MEM_PUSH = (1 << 3), /* Stores to the stack */
+  XL_MEM_POINTER = (1 << 4) /* Loads the pointer to the address */
+};
+
+/*
+Flag masks of the instruction effects.
+*/
+enum {
+  XL_FLAGS_ZN = XL_FLAG_Z | XL_FLAG_N,
+  XL_FLAGS_CZN = XL_FLAG_C | XL_FLAG_Z | XL_FLAG_N,
+  XL_FLAGS_VCZN = XL_FLAG_V | XL_FLAG_C | XL_FLAG_Z | XL_FLAG_N,
+  XL_FLAGS_ALL = 0xFF
+};
+
+/*
+The columns of XL_ADDRMODES_XM and XL_EFFECTS_XM as constants,
+for XL_OPINFO.
+*/
+enum {
+#define X(name, size, cycles, regs, mem) \
+  XL_MSIZE_##name = size, XL_MCYCLES_##name = cycles, \
+  XL_MREGS_##name = regs, XL_MMEM_##name = mem,
+XL_ADDRMODES_XM
+#undef X
+#define X(name, cycles, flagsread, flagswritten, regsread, regswritten \
+         , mem) \
+  XL_ICYCLES_##name = cycles, XL_IFREAD_##name = flagsread, \
+  XL_IFWRITTEN_##name = flagswritten, XL_IRREAD_##name = regsread, \
+  XL_IRWRITTEN_##name = regswritten, XL_IMEM_##name = mem,
+XL_EFFECTS_XM
+#undef X
+  XL_EFFECTS_END
+};
+
+/*
+Execution trace record kind.
+*/
+enum {
+  XL_TRACE_INST, /* An instruction was executed */
+  XL_TRACE_INPUT, /* A byte was read from the input port */
+  XL_TRACE_OUTPUT /* A byte was written to the output port */
+};
+
+/*
+Execution trace register mask, set for changed registers.
+*/
+enum {
+  XL_TRACE_F = (1 << 0),
+  XL_TRACE_A = (1 << 1),
+  XL_TRACE_S = (1 << 2),
+  XL_TRACE_X = (1 << 3),
+  XL_TRACE_Y = (1 << 4)
+};
+
+/*
+One record of an execution trace. Made of bytes only, so it
+has no padding and can be written to a file as is. Words are
+stored in little endian.
+For XL_TRACE_INPUT and XL_TRACE_OUTPUT only `kind` and `data`
+are meaningful.
+*/
+typedef struct XL_Trace {
+  unsigned char kind; /* One of XL_TRACE_ */
+  unsigned char mask; /* Changed registers, XL_TRACE_ mask */
+  unsigned char p[2]; /* Address of the instruction */
+  unsigned char inst[3]; /* Instruction and operand bytes */
+  unsigned char addr[2]; /* Address from the address mode */
+  unsigned char f; /* Registers after the instruction */
+  unsigned char a;
+  unsigned char s;
+  unsigned char x;
+  unsigned char y;
+  unsigned char cycles; /* Cycles of the instruction */
+  unsigned char data; /* Input or output byte */
+} XL_Trace;
+
+/*
+Heatmap counter arrays in the order they are stored.
+*/
+enum {
+  XL_HEAT_EXEC, /* Instructions executed at the address */
+  XL_HEAT_CYCLES, /* Cycles of those instructions */
+  XL_HEAT_LOADS, /* Bus loads from the address, including fetches */
+  XL_HEAT_STORES, /* Bus stores to the address */
+  XL_HEAT_COUNT
+};
+
+/*
+Golden trace access kinds.
+*/
+enum {
+  XL_GOLD_LOAD, /* The data was loaded from the address */
+  XL_GOLD_STORE, /* The data was stored to the address */
+  XL_GOLD_EVENT, /* The address is the XL_EVENT_ */
+  XL_GOLD_ERROR /* The address is the XL_ERR_ */
+};
+
+/*
+Symbol kinds of object files.
+*/
+enum {
+  XL_SYM_EXPORT, /* Label defined in the object */
+  XL_SYM_IMPORT /* Name used but not defined in the object */
+};
+
+/*
+Relocation kinds of object files.
+*/
+enum {
+  XL_RELOC_ABS16, /* Add the address of the symbol or the object
+                     minus $8000 to the word */
+  XL_RELOC_ABS8, /* Store the zero page address of the symbol */
+  XL_RELOC_REL8 /* Store the offset of the symbol from the byte
+                   before, the instruction byte */
+};
+
 /*
 Combination of an instruction keyword and an addressing mode.
 */
@@ -182,6 +588,48 @@ typedef struct XL_Combo {
   unsigned char amode;
 } XL_Combo;
 
+/*
+Metadata of an instruction byte, the keyword and the addressing mode
+together. Registers and memory in the masks include those of the
+addressing mode.
+*/
+typedef struct XL_Opinfo {
+  unsigned char inst; /* Keyword */
+  unsigned char amode; /* Addressing mode */
+  unsigned char size; /* Instruction and operand bytes */
+  unsigned char cycles; /* Cycles, like XL_opcycles */
+  unsigned char taken; /* Cycles a taken jump adds, XL has none */
+  unsigned char flagsread; /* XL_FLAG_ mask */
+  unsigned char flagswritten; /* XL_FLAG_ mask */
+  unsigned char regsread; /* XL_REG_ mask */
+  unsigned char regswritten; /* XL_REG_ mask */
+  unsigned char mem; /* XL_MEM_ mask */
+} XL_Opinfo;
+
+/*
+Initializer of the XL_Opinfo of the keyword and the addressing mode,
+a constant expression in C and C++.
+*/
+#define XL_OPINFO(inst, amode) \
+  {T##inst, M##amode, XL_MSIZE_##amode \
+  , 1 + XL_MCYCLES_##amode + XL_ICYCLES_##inst, 0 \
+  , XL_IFREAD_##inst, XL_IFWRITTEN_##inst \
+  , XL_MREGS_##amode | XL_IRREAD_##inst, XL_IRWRITTEN_##inst \
+  , XL_MMEM_##amode | XL_IMEM_##inst}
+
+/*
+Decoded instruction.
+*/
+typedef struct XL_Insn {
+  XL_Word addr; /* Address of the instruction byte */
+  XL_Byte bytes[3]; /* Instruction and operand bytes */
+  unsigned char size; /* Number of the bytes */
+  unsigned char inst; /* Keyword */
+  unsigned char amode; /* Addressing mode */
+  int operand; /* Immediate, address or signed relative offset */
+  XL_Word target; /* Address the relative offset points to */
+} XL_Insn;
+
 /************************************************************/
 /* VARIABLES                                                */
 /************************************************************/
@@ -217,6 +665,101 @@ Instruction sizes mapped to addressing modes.
 */
 extern int XL_modesizes[];
 
+/*
+Extra cycles of addressing modes.
+*/
+extern int XL_modecycles[];
+
+/*
+Metadata of every instruction byte.
+*/
+extern const XL_Opinfo XL_opinfo[];
+
+/*
+Reverse of XL_combos, the instruction byte of a keyword and
+an addressing mode or XL_NO_OPCODE. Call XL_init_opcodes first.
+*/
+extern int XL_opcodes[Tcount][Mcount];
+
+/*
+Legal addressing modes of keywords, bit (1 << mode) is set
+for every mode that has an opcode. Call XL_init_opcodes first.
+*/
+extern unsigned int XL_instmodes[Tcount];
+
+/*
+Perfect hash table of keywords, the keyword plus one at its
+XL_hashkey or zero.
+*/
+extern const unsigned char XL_keyhash[XL_KEYHASH_SIZE];
+
+/************************************************************/
+/* FUNCTIONS                                                */
+/************************************************************/
+
+/*
+Fill XL_opcodes and XL_instmodes from XL_combos.
+*/
+void
+XL_init_opcodes(void);
+
+/*
+Cycles of the instruction byte: one for the fetch, plus
+the addressing mode, plus the instruction itself.
+*/
+int
+XL_opcycles(int opcode);
+
+/*
+Decode the instruction at buf, which is at addr, return its size.
+Only the bytes of the instruction are read.
+*/
+int
+XL_decode(const XL_Byte *buf, XL_Word addr, XL_Insn *out);
+
+/*
+Decode the instructions of buf one after another while they fit
+in len bytes, return the number of instructions. out must have
+room for len instructions.
+*/
+long
+XL_decode_all(const XL_Byte *buf, long len, XL_Word addr, XL_Insn *out);
+
+/*
+Write the instruction as xlas source into buf of XL_FORMAT_MAX
+bytes, the relative jumps with the target, return the length.
+*/
+int
+XL_format(const XL_Insn *in, char *buf);
+
+/*
+Fill the table of XL_KEYHASH_SIZE bytes like XL_keyhash from
+XL_keywords, return -1 if two keywords collide or one is longer
+than XL_KEYWORD_MAXLEN.
+*/
+int
+XL_make_keyhash(unsigned char *table);
+
+/*
+Check XL_keyhash against XL_keywords, return -1 if it is not the
+table of XL_make_keyhash.
+*/
+int
+XL_init_keywords(void);
+
+/*
+Hash the identifier into the index of XL_keyhash.
+*/
+unsigned int
+XL_hashkey(const char *str, int len);
+
+/*
+Get the keyword of the identifier with one hash and one compare,
+-1 if the identifier is not a keyword.
+*/
+int
+XL_find_keyword(const char *str, int len);
+
 #ifdef __cplusplus
 };
 #endif
@@ -231,72 +774,18 @@ extern int XL_modesizes[];
 #ifndef XL_EXTRA_IMPLEMENTED
 #define XL_EXTRA_IMPLEMENTED
 
+/************************************************************/
+/* INCLUDES                                                 */
+/************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
 /************************************************************/
 XL_Combo XL_combos[XL_NUM_COMBOS] = {
-  {Tinv, Mnam}, {Tbrk, Mnam}, {Trti, Mnam}, {Tret, Mnam},
-  {Tfor, Mimm}, {Tfnd, Mimm}, {Tclc, Mnam}, {Tnop, Mnam},
-  {Tapp, Mnam}, {Tamm, Mnam}, {Tspp, Mnam}, {Tsmm, Mnam},
-  {Txpp, Mnam}, {Txmm, Mnam}, {Typp, Mnam}, {Tymm, Mnam},
-  {Tjfb, Mrel}, {Tjfc, Mrel}, {Tjfd, Mrel}, {Tjfn, Mrel},
-  {Tjfr, Mrel}, {Tjfu, Mrel}, {Tjfv, Mrel}, {Tjfz, Mrel},
-  {Tjtb, Mrel}, {Tjtc, Mrel}, {Tjtd, Mrel}, {Tjtn, Mrel},
-  {Tjtr, Mrel}, {Tjtu, Mrel}, {Tjtv, Mrel}, {Tjtz, Mrel},
-  {Tpha, Mnam}, {Tphf, Mnam}, {Tphx, Mnam}, {Tphy, Mnam},
-  {Tpla, Mnam}, {Tplf, Mnam}, {Tplx, Mnam}, {Tply, Mnam},
-  {Ttaf, Mnam}, {Ttas, Mnam}, {Ttax, Mnam}, {Ttay, Mnam},
-  {Ttfa, Mnam}, {Ttsa, Mnam}, {Ttxa, Mnam}, {Ttya, Mnam},
-  {Tlda, Mimm}, {Tlda, Mabs}, {Tlda, Mzpg}, {Tlda, Mvec},
-  {Tlda, Mabx}, {Tlda, Maby}, {Tlda, Mzpx}, {Tlda, Mzpy},
-  {Tzra, Mnam}, {Tsta, Mabs}, {Tsta, Mzpg}, {Tsta, Mvec},
-  {Tsta, Mabx}, {Tsta, Maby}, {Tsta, Mzpx}, {Tsta, Mzpy},
-  {Tzrx, Mnam}, {Tldx, Mimm}, {Tldx, Mabs}, {Tldx, Maby},
-  {Tldx, Mzpg}, {Tldx, Mzpy}, {Tldx, Mvec}, {Tldx, Mzyv},
-  {Tzry, Mnam}, {Tldy, Mimm}, {Tldy, Mabs}, {Tldy, Mabx},
-  {Tldy, Mzpg}, {Tldy, Mzpx}, {Tldy, Mvec}, {Tldy, Mzvx},
-  {Tcmp, Mimm}, {Tcmp, Mabs}, {Tcmp, Mzpg}, {Tcmp, Mvec},
-  {Tcmp, Mabx}, {Tcmp, Maby}, {Tcmp, Mzpx}, {Tcmp, Mzpy},
-  {Tjmp, Mrel}, {Tjmp, Mabs}, {Tjmp, Mzpg}, {Tjmp, Mvec},
-  {Tjmp, Mabx}, {Tjmp, Maby}, {Tjmp, Mzpx}, {Tjmp, Mzpy},
-  {Tstx, Mabs}, {Tstx, Maby}, {Tstx, Mzpg}, {Tstx, Mzpy},
-  {Tstx, Mvec}, {Tstx, Mzyv}, {Tlda, Mzvx}, {Tlda, Mzyv},
-  {Tsty, Mabs}, {Tsty, Mabx}, {Tsty, Mzpg}, {Tsty, Mzpx},
-  {Tsty, Mvec}, {Tsty, Mzvx}, {Tsta, Mzvx}, {Tsta, Mzyv},
-  {Tnta, Mnam}, {Tcal, Mabs}, {Tcal, Mzpg}, {Tcal, Mvec},
-  {Tcal, Mabx}, {Tcal, Maby}, {Tcal, Mzpx}, {Tcal, Mzpy},
-  {Tcal, Mzvx}, {Tcal, Mzyv}, {Tjmp, Mzvx}, {Tjmp, Mzyv},
-  {Tcmp, Mzvx}, {Tcmp, Mzyv}, {Tsla, Mnam}, {Tsra, Mnam},
-  {Tinc, Mabs}, {Tinc, Mabx}, {Tinc, Maby}, {Tinc, Mzpg},
-  {Tinc, Mzpx}, {Tinc, Mzpy}, {Tinc, Mvec}, {Tinc, Mzvx},
-  {Tinc, Mzyv}, {Tcpx, Mimm}, {Tcpx, Mabs}, {Tcpx, Maby},
-  {Tcpx, Mzpg}, {Tcpx, Mzpy}, {Tcpx, Mvec}, {Tcpx, Mzyv},
-  {Tdec, Mabs}, {Tdec, Mabx}, {Tdec, Maby}, {Tdec, Mzpg},
-  {Tdec, Mzpx}, {Tdec, Mzpy}, {Tdec, Mvec}, {Tdec, Mzvx},
-  {Tdec, Mzyv}, {Tcpy, Mimm}, {Tcpy, Mabs}, {Tcpy, Mabx},
-  {Tcpy, Mzpg}, {Tcpy, Mzpx}, {Tcpy, Mvec}, {Tcpy, Mzvx},
-  {Tbit, Mimm}, {Tbit, Mabs}, {Tbit, Mzpg}, {Tbit, Mvec},
-  {Tbit, Mabx}, {Tbit, Maby}, {Tbit, Mzpx}, {Tbit, Mzpy},
-  {Tand, Mimm}, {Tand, Mabs}, {Tand, Mzpg}, {Tand, Mvec},
-  {Tand, Mabx}, {Tand, Maby}, {Tand, Mzpx}, {Tand, Mzpy},
-  {Tbor, Mimm}, {Tbor, Mabs}, {Tbor, Mzpg}, {Tbor, Mvec},
-  {Tbor, Mabx}, {Tbor, Maby}, {Tbor, Mzpx}, {Tbor, Mzpy},
-  {Txor, Mimm}, {Txor, Mabs}, {Txor, Mzpg}, {Txor, Mvec},
-  {Txor, Mabx}, {Txor, Maby}, {Txor, Mzpx}, {Txor, Mzpy},
-  {Tadc, Mimm}, {Tadc, Mabs}, {Tadc, Mzpg}, {Tadc, Mvec},
-  {Tadc, Mabx}, {Tadc, Maby}, {Tadc, Mzpx}, {Tadc, Mzpy},
-  {Tsbc, Mimm}, {Tsbc, Mabs}, {Tsbc, Mzpg}, {Tsbc, Mvec},
-  {Tsbc, Mabx}, {Tsbc, Maby}, {Tsbc, Mzpx}, {Tsbc, Mzpy},
-  {Tadd, Mimm}, {Tadd, Mabs}, {Tadd, Mzpg}, {Tadd, Mvec},
-  {Tadd, Mabx}, {Tadd, Maby}, {Tadd, Mzpx}, {Tadd, Mzpy},
-  {Tsub, Mimm}, {Tsub, Mabs}, {Tsub, Mzpg}, {Tsub, Mvec},
-  {Tsub, Mabx}, {Tsub, Maby}, {Tsub, Mzpx}, {Tsub, Mzpy},
-  {Tbit, Mzvx}, {Tbit, Mzyv}, {Tand, Mzvx}, {Tand, Mzyv},
-  {Tbor, Mzvx}, {Tbor, Mzyv}, {Txor, Mzvx}, {Txor, Mzyv},
-  {Tadc, Mzvx}, {Tadc, Mzyv}, {Tsbc, Mzvx}, {Tsbc, Mzyv},
-  {Tadd, Mzvx}, {Tadd, Mzyv}, {Tsub, Mzvx}, {Tsub, Mzyv},
-  {Tnot, Mzpg}, {Tnot, Mzpx}, {Tnot, Mabs}, {Tnot, Mabx},
-  {Tshl, Mzpg}, {Tshl, Mzpx}, {Tshl, Mabs}, {Tshl, Mabx},
-  {Tshr, Mzpg}, {Tshr, Mzpx}, {Tshr, Mabs}, {Tshr, Mabx},
-  {Tinv, Mnam}, {Tinv, Mnam}, {Tinv, Mnam}, {Tinv, Mnam}
+#define X(inst, amode) {T##inst, M##amode},
+XL_COMBOS_XM
+#undef X
 };
 
 /************************************************************/
@@ -309,7 +798,7 @@ XL_KEYWORDS_XM
 
 /************************************************************/
 const char *XL_addrmodes[Mcount + 1] = {
-#define X(name) #name,
+#define X(name, size, cycles, regs, mem) #name,
 XL_ADDRMODES_XM
 #undef X
   "unreachable"
@@ -331,9 +820,172 @@ const char *XL_msignatures[Mcount] = {
 
 /************************************************************/
 int XL_modesizes[Mcount] = {
-  1, 2, 3, 3, 3, 2, 2, 2, 2, 3, 2, 2
+#define X(name, size, cycles, regs, mem) size,
+XL_ADDRMODES_XM
+#undef X
+};
+
+/************************************************************/
+int XL_modecycles[Mcount] = {
+#define X(name, size, cycles, regs, mem) cycles,
+XL_ADDRMODES_XM
+#undef X
+};
+
+/************************************************************/
+const XL_Opinfo XL_opinfo[XL_NUM_COMBOS] = {
+#define X(inst, amode) XL_OPINFO(inst, amode),
+XL_COMBOS_XM
+#undef X
 };
 
+/************************************************************/
+int XL_opcodes[Tcount][Mcount];
+
+/************************************************************/
+unsigned int XL_instmodes[Tcount];
+
+/************************************************************/
+const unsigned char XL_keyhash[XL_KEYHASH_SIZE] = XL_KEYHASH_INIT;
+
+/************************************************************/
+void
+XL_init_opcodes(void)
+{
+  XL_Combo *p = NULL;
+  int i = 0, m = 0;
+  for (i = 0; i < Tcount; ++i) {
+    XL_instmodes[i] = 0;
+    for (m = 0; m < Mcount; ++m)
+      XL_opcodes[i][m] = XL_NO_OPCODE;
+  }
+  /* backwards, so the first of the duplicates wins */
+  for (i = XL_NUM_COMBOS - 1; i >= 0; --i) {
+    p = &XL_combos[i];
+    XL_opcodes[p->inst][p->amode] = i;
+    XL_instmodes[p->inst] |= 1u << p->amode;
+  }
+}
+
+/************************************************************/
+int
+XL_opcycles(int opcode)
+{
+  return XL_opinfo[opcode & 0xFF].cycles;
+}
+
+/************************************************************/
+int
+XL_decode(const XL_Byte *buf, XL_Word addr, XL_Insn *out)
+{
+  XL_Combo *p = &XL_combos[buf[0]];
+  int i = 0;
+  out->addr = addr;
+  out->inst = p->inst;
+  out->amode = p->amode;
+  out->size = XL_modesizes[p->amode];
+  for (i = 0; i < out->size; ++i)
+    out->bytes[i] = buf[i];
+  out->operand = 0;
+  if (out->size == 2)
+    out->operand = buf[1];
+  if (out->size == 3)
+    out->operand = buf[1] | (buf[2] << 8);
+  if (p->amode == Mrel)
+    out->operand = (buf[1] ^ 0x80) - 0x80;
+  out->target = (XL_Word)(addr + out->operand);
+  return out->size;
+}
+
+/************************************************************/
+long
+XL_decode_all(const XL_Byte *buf, long len, XL_Word addr, XL_Insn *out)
+{
+  long at = 0, n = 0;
+  while (at < len && at + XL_modesizes[XL_combos[buf[at]].amode] <= len) {
+    at += XL_decode(buf + at, (XL_Word)(addr + at), &out[n]);
+    ++n;
+  }
+  return n;
+}
+
+/************************************************************/
+int
+XL_format(const XL_Insn *in, char *buf)
+{
+  int n = 0;
+  n = sprintf(buf, "%s%s", XL_keywords[in->inst]
+             , XL_msignatures[in->amode]);
+  /**/ if (in->amode == Mimm)
+    n += sprintf(buf + n, "%i", in->operand);
+  else if (in->amode == Mrel)
+    n += sprintf(buf + n, "%i -> 0x%04X", in->operand, in->target);
+  else if (in->size == 2)
+    n += sprintf(buf + n, "0x%02X", in->operand);
+  else if (in->size == 3)
+    n += sprintf(buf + n, "0x%04X", in->operand);
+  return n;
+}
+
+/************************************************************/
+int
+XL_make_keyhash(unsigned char *table)
+{
+  unsigned int h = 0;
+  int i = 0, len = 0;
+  for (i = 0; i < XL_KEYHASH_SIZE; ++i)
+    table[i] = 0;
+  for (i = 0; i < Tcount; ++i) {
+    len = (int)strlen(XL_keywords[i]);
+    if (len > XL_KEYWORD_MAXLEN)
+      return -1;
+    h = XL_hashkey(XL_keywords[i], len);
+    if (table[h] != 0)
+      return -1;
+    table[h] = i + 1;
+  }
+  return 0;
+}
+
+/************************************************************/
+int
+XL_init_keywords(void)
+{
+  unsigned char table[XL_KEYHASH_SIZE];
+  if (XL_make_keyhash(table) != 0
+     || memcmp(table, XL_keyhash, sizeof(table)) != 0)
+    return -1;
+  return 0;
+}
+
+/************************************************************/
+unsigned int
+XL_hashkey(const char *str, int len)
+{
+  unsigned long h = XL_KEYHASH_SEED;
+  for (; len > 0; ++str, --len)
+    h = ((h ^ (unsigned char)*str) * 16777619UL) & 0xFFFFFFFFUL;
+  /* mix the high bits down, the last characters differ little */
+  h ^= h >> 16;
+  h = (h * 0x45D9F3BUL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  return h & (XL_KEYHASH_SIZE - 1);
+}
+
+/************************************************************/
+int
+XL_find_keyword(const char *str, int len)
+{
+  int t = 0;
+  if (len > XL_KEYWORD_MAXLEN)
+    return -1;
+  t = XL_keyhash[XL_hashkey(str, len)] - 1;
+  if (t < 0 || strncmp(XL_keywords[t], str, len) != 0
+     || XL_keywords[t][len] != '\0')
+    return -1;
+  return t;
+}
+
 #endif /* XL_EXTRA_IMPLEMENTED */
 #endif /* !XL_EXTRA_C */
 
@@ -0,0 +1,4233 @@
+/*
+xlas.h - The XL assembler.
+See LICENSE information in the end of the file.
+
+--------------------------------------------------------------
+                        HOW TO INCLUDE
+--------------------------------------------------------------
+
+This file is a single header C library!
+Do this to include the header code:
+```c
+#include "xlas.h"
+```
+And this to include the source code:
+```c
+#define XLAS_C
+#include "xlas.h"
+```
+The source code uses POSIX threads and mmap: define
+_POSIX_C_SOURCE as 200809L before the first include, build with
+-pthread and include the source code of extended_lemon_extra.h
+once in the program.
+
+--------------------------------------------------------------
+                        HOW TO USE
+--------------------------------------------------------------
+
+An assembler assembles one program. The source is given in
+memory or read from the file, the includes are always read from
+their files. The errors are printed to the standard error and
+the functions return -1.
+
+```c
+  unsigned char rom[XLAS_IMAGE_SIZE];
+  const XLAS_Symbol *syms = NULL;
+  int symnum = 0;
+  XLAS *as = XLAS_new(NULL);
+  if (XLAS_assemble(as, "test.xlas", src, strlen(src)) != 0)
+    exit(EXIT_FAILURE);
+  XLAS_image(as, rom);
+  syms = XLAS_symbols(as, &symnum);
+  // run the rom, the names of syms are valid until XLAS_free
+  XLAS_free(as);
+```
+*/
+
+/************************************************************/
+/* HEADER CODE                                              */
+/************************************************************/
+
+#ifndef XLAS_H
+#define XLAS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/************************************************************/
+/* INCLUDES                                                 */
+/************************************************************/
+
+#include <stddef.h>
+#include <stdio.h>
+
+/************************************************************/
+/* DEFINES                                                  */
+/************************************************************/
+
+/*
+Size of the image, the ROM half of the XL address space
+from $8000.
+*/
+#define XLAS_IMAGE_SIZE 0x8000
+
+/************************************************************/
+/* TYPES                                                    */
+/************************************************************/
+
+/*
+The assembler.
+*/
+typedef struct XLAS XLAS;
+
+typedef struct XLAS_Options {
+  const char *listname; /* write the listing to the file */
+  const char *cachedir; /* reuse the assembled includes of the dir */
+  int optimize; /* apply the peephole rewrites and report them */
+  int objmode; /* assemble a relocatable object for xlld */
+  int expandrep; /* report the code added by the expansions */
+  FILE *optout; /* the report of optimize, stderr if NULL */
+  FILE *expandout; /* the report of expandrep, stdout if NULL */
+  FILE *cacheout; /* the report of cachedir, stdout if NULL */
+} XLAS_Options;
+
+typedef struct XLAS_Symbol {
+  const char *name;
+  int val;
+  int islabel; /* 0 for a let */
+} XLAS_Symbol;
+
+/************************************************************/
+/* FUNCTIONS                                                */
+/************************************************************/
+
+/*
+Create the assembler, opts is NULL for the defaults. The cache
+is off with optimize, objmode or listname.
+*/
+XLAS *
+XLAS_new(const XLAS_Options *opts);
+
+/*
+Assemble the source in the passes, 0 on success. The source is
+read from the file if src is NULL, otherwise it is len bytes of
+src and the filename names it in the errors.
+*/
+int
+XLAS_assemble(XLAS *as, const char *filename, const char *src
+             , size_t len);
+
+/*
+Copy the assembled code into the XLAS_IMAGE_SIZE bytes of rom,
+the rest is zeroed. Return the number of assembled bytes.
+*/
+int
+XLAS_image(XLAS *as, unsigned char *rom);
+
+/*
+Get the symbols in the order of definition and their number.
+*/
+const XLAS_Symbol *
+XLAS_symbols(XLAS *as, int *num);
+
+/*
+Write the image (the object with objmode) to the file and the map
+file if mname is not NULL, 0 on success.
+*/
+int
+XLAS_write(XLAS *as, const char *oname, const char *mname);
+
+/*
+Free the assembler, NULL is fine.
+*/
+void
+XLAS_free(XLAS *as);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* XLAS_H */
+
+/************************************************************/
+/* SOURCE CODE                                              */
+/************************************************************/
+
+#ifdef XLAS_C
+#ifndef XLAS_IMPLEMENTED
+#define XLAS_IMPLEMENTED
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+
+#define XLASI_NEW(type) \
+  memset(XLASI_domalloc(sizeof(type)), 0, sizeof(type))
+
+#define XLASI_NUMOF(arr) \
+  (sizeof(arr)/sizeof((arr)[0]))
+
+#define XLASI_TOKCAP 512
+#define XLASI_FILLMIN 64
+#define XLASI_FILLCHUNK 4096
+#define XLASI_ARENACAP 0x10000
+#define XLASI_PASSCAP 64
+#define XLASI_EXPANDCAP 64
+#define XLASI_SRCHASH 256
+
+enum {
+  XLASI_Teof     = -17,
+  XLASI_Tnewline = -16,
+  XLASI_Tconst   = -15,
+  XLASI_Tstrlit  = -14,
+  XLASI_Tsharp   = -13,
+  XLASI_Tdiv     = -12,
+  XLASI_Tmult    = -11,
+  XLASI_Tmore    = -10,
+  XLASI_Tless    = -9,
+  XLASI_Tqand    = -8,
+  XLASI_Tqor     = -7,
+  XLASI_Tqnor    = -6,
+  XLASI_Tqxor    = -5,
+  XLASI_Tminus   = -4,
+  XLASI_Tplus    = -3,
+  XLASI_Tcomma   = -2,
+  XLASI_Tcolon   = -1
+};
+
+/* relaxation states of instruction sites */
+enum {
+  XLASI_Snone  = 0, /* not decided yet */
+  XLASI_Sshort = 1, /* zero page operand or relative jump */
+  XLASI_Slong  = 2  /* absolute operand or jump, never shrinks back */
+};
+
+/* peephole rewrites of instruction sites */
+enum {
+  XLASI_Okeep,     /* as written */
+  XLASI_Oload,     /* sta X, lda X -> sta X */
+  XLASI_Otransfer, /* tax, txa -> tax and the like */
+  XLASI_Onext,     /* jmp L, L: -> L: */
+  XLASI_Otail,     /* cal f, ret -> jmp f */
+  XLASI_Oret,      /* the ret of the tail call */
+  XLASI_Othread,   /* jmp L, L: jmp M -> jmp M */
+  XLASI_Ocount
+};
+
+/* kinds of peephole IR entries */
+enum {
+  XLASI_Iinst,  /* instruction */
+  XLASI_Ilabel, /* label definition, starts a block */
+  XLASI_Ibar    /* any other line, ends a block */
+};
+
+/* character classes */
+enum {
+  XLASI_Cspace = 1, /* white space except the newline */
+  XLASI_Cident = 2, /* identifier or integer constant */
+  XLASI_Cdigit = 4, /* starts an integer constant */
+  XLASI_Cop    = 8  /* one-character token */
+};
+
+/* kinds of expansions */
+enum {
+  XLASI_Kmacro,  /* macro name params ... endm, expanded at name args */
+  XLASI_Kinline, /* inline name ... ret endm, expanded at cal name */
+  XLASI_Krept    /* rept count ... endr, expanded in place */
+};
+
+typedef struct XLASI_Tok {
+  const char *filename;
+  int type;
+  int row;
+  int col;
+  int iconst;
+  int strlit;
+} XLASI_Tok;
+
+typedef struct XLASI_Mtok {
+  XLASI_Tok tok;
+  const char *line; /* the source line for the listing, or NULL */
+} XLASI_Mtok;
+
+typedef struct XLASI_Lexer {
+  struct XLASI_Lexer *prev;
+  const char *filename;
+  const char *buf; /* the whole file, terminated with '\0' */
+  const unsigned char *end;
+  const unsigned char *p; /* the next character */
+  const unsigned char *line; /* the start of the current line */
+  const int *splices; /* offsets of removed backslash-newlines */
+  int splicenum;
+  int splicei;
+  int row;
+  int ttype;
+  int trow;
+  int tcol;
+  int tconst;
+  int tstrlit;
+  XLASI_Mtok *toks; /* the tokens of an expansion instead of the file */
+  int toknum;
+  int toki;
+  int macro; /* mactab index + 1 of the expansion, or 0 */
+  int start; /* the output size when the expansion started */
+} XLASI_Lexer;
+
+/* the file read once for all the passes of the assembly */
+typedef struct XLASI_Source {
+  const char *filename;
+  char *buf; /* terminated with '\0' */
+  const unsigned char *end;
+  int *splices; /* offsets of removed backslash-newlines */
+  int splicenum;
+  /* the files read are shared by all assemblers */
+  struct XLASI_Source *next; /* in the bucket of XLASI_srchash */
+  long size; /* of the file when it was read */
+  long mtime;
+  int refs; /* the assemblers using it */
+  int shared; /* in XLASI_srchash */
+} XLASI_Source;
+
+typedef struct XLASI_Macro {
+  XLASI_Tok tok; /* where it is defined */
+  int name; /* 0 for rept */
+  int kind;
+  XLASI_Mtok *toks; /* the body with its newlines */
+  int toknum;
+  int bodynum; /* the tokens to expand, without the ret of inline */
+  int *params;
+  int paramnum;
+  int *locals; /* labels of the body, renamed in every copy */
+  int localnum;
+  int pass; /* the last pass that defined it */
+  int uses; /* copies in this pass */
+  int bytes; /* code of the copies in this pass */
+} XLASI_Macro;
+
+/* kinds of runs */
+enum {
+  XLASI_Rbytes, /* emitted bytes */
+  XLASI_Rfill,  /* one byte repeated */
+  XLASI_Rfile   /* a mapped incbin */
+};
+
+typedef struct XLASI_Run {
+  int kind;
+  int offset; /* in the section */
+  int size;
+  int cap; /* of the data of Rbytes */
+  int fill; /* the byte of Rfill */
+  char *data; /* the bytes of Rbytes and Rfile */
+} XLASI_Run;
+
+typedef struct XLASI_Sect {
+  XLASI_Run *runs;
+  int runnum;
+  int runcap;
+  int size;
+  int maxsize;
+} XLASI_Sect;
+
+typedef struct XLASI_Var {
+  int name;
+  int val;
+  int islabel;
+  int isrel; /* moves with the object */
+} XLASI_Var;
+
+typedef struct XLASI_Arena {
+  struct XLASI_Arena *prev;
+  char *buf;
+  size_t size;
+  size_t cap;
+} XLASI_Arena;
+
+typedef struct XLASI_Site {
+  unsigned char state; /* relaxation state */
+  unsigned char opt; /* peephole rewrite */
+  int target; /* the new jump target of Othread */
+  int saved; /* cycles saved by Othread */
+} XLASI_Site;
+
+typedef struct XLASI_Ir {
+  int kind;
+  int site;
+  int inst;
+  int mtype; /* as written, abs before the zero page is chosen */
+  int opcode;
+  int name; /* the label or the operand name, 0 for expressions */
+  int val; /* the operand value, -1 if it is not known yet */
+} XLASI_Ir;
+
+typedef struct XLASI_Reloc {
+  int offset;
+  int kind; /* XL_RELOC_ */
+  int name; /* the imported name, -1 for the object itself */
+} XLASI_Reloc;
+
+typedef struct XLASI_Decl {
+  XLASI_Tok tok;
+  int name;
+  int size;
+  int addr; /* -1 until the end of the first pass */
+  int order;
+  int pass; /* the last pass that declared it */
+  double weight; /* references weighted by the loop depth */
+} XLASI_Decl;
+
+typedef struct XLASI_Ref {
+  int name;
+  int addr; /* where the reference is in the first pass */
+  int ismem; /* the name is a memory operand */
+} XLASI_Ref;
+
+typedef struct XLASI_Loop {
+  int lo; /* the label */
+  int hi; /* the backward jump */
+} XLASI_Loop;
+
+typedef struct XLASI_Pred {
+  int name;
+  int val; /* predicted from the previous pass */
+} XLASI_Pred;
+
+typedef struct XLASI_Entry {
+  unsigned long key[2]; /* of the file, the origin and the symbols */
+  const char *filename;
+  XLASI_Lexer *lex; /* the lexer of the include being assembled */
+  const char *why; /* why it cannot be cached, or NULL */
+  int offset; /* the output in the section */
+  int size;
+  char *bytes; /* the output read from the cache */
+  int site; /* the first relaxation site */
+  int sitenum;
+  unsigned char *before; /* the site states before the include */
+  unsigned char *after;
+  XLASI_Var *vars; /* the vars before, then the vars it defines */
+  int varnum;
+  XLASI_Pred *preds; /* the forward names it uses */
+  int prednum;
+  XLASI_Ref *refs; /* what the var allocation needs to know */
+  int refnum;
+  XLASI_Loop *loops;
+  int loopnum;
+  int *taken;
+  int takennum;
+} XLASI_Entry;
+
+typedef struct XLASI_Listing {
+  const char *filename;
+  const char *text; /* the source line */
+  int row;
+  int addr;
+  int size;
+  int cycles; /* the base cycles of the instructions, or -1 */
+} XLASI_Listing;
+
+typedef struct XLASI_Backpatch {
+  XLASI_Tok tok;
+  int isrel;
+  int size;
+  int offset;
+  int label;
+} XLASI_Backpatch;
+
+/* everything one assembly owns, so that they can run in threads */
+struct XLAS {
+  jmp_buf fail; /* where XLASI_asmerr goes */
+  int id; /* names the temporary cache files */
+  int assembled; /* XLAS_assemble succeeded */
+  FILE *out; /* the output file while it is open */
+  char *pathbuf; /* of XLASI_cachepath */
+  XLASI_Source *mainsrc; /* the source given in memory */
+  XLASI_Source **srctab; /* the files used, from XLASI_srchash */
+  int srcnum;
+  int srccap;
+  XLAS_Symbol *symtab; /* of XLAS_symbols */
+
+  const char **strtab;
+  unsigned long *strhashes;
+  int *varidx; /* vartab index + 1 of the string, or 0 */
+  int *predval; /* the value in the previous pass, or -1 */
+  int *declidx; /* decltab index + 1 of the string, or 0 */
+  int *macidx; /* mactab index + 1 of the string, or 0 */
+  int *srcidx; /* srctab index + 1 of the file name, or 0 */
+  int strnum;
+  int strcap;
+
+  int *htab; /* strtab index + 1, or 0 for an empty slot */
+  int hcap;
+
+  XLASI_Arena *arena;
+
+  XLASI_Var *vartab;
+  int varnum;
+  int varcap;
+
+  XLASI_Backpatch *bptab;
+  int bpnum;
+  int bpcap;
+
+  XLASI_Site *sitetab;
+  int sitenum;
+  int sitecap;
+  int guessed; /* a forward name had no value to predict */
+  int predicted; /* a forward name was predicted */
+
+  XLASI_Ir *irtab;
+  int irnum;
+  int ircap;
+  int optimize; /* -O */
+  int optnum[XLASI_Ocount];
+  int optbytes;
+  int optcycles;
+  FILE *optout;
+
+  int tokcount;
+  int passnum;
+
+  XLASI_Decl *decltab;
+  int declnum;
+  int declcap;
+  int exprpending; /* the expression uses a var not placed yet */
+
+  XLASI_Ref *reftab;
+  int refnum;
+  int refcap;
+
+  XLASI_Loop *looptab;
+  int loopnum;
+  int loopcap;
+
+  /* RAM bytes that the program addresses by itself */
+  unsigned char taken[0x8000 / 8];
+
+  XLASI_Macro *mactab;
+  int macnum;
+  int maccap;
+  int expandnum; /* numbers the local labels of the copies */
+  int expanddepth;
+  int expandrep; /* -e */
+  FILE *expandout;
+
+  XLASI_Listing *lstab;
+  int lsnum;
+  int lscap;
+  const char *listname; /* -l */
+  int linecycles; /* the base cycles of the current line */
+
+  const char *cachedir; /* -C */
+  FILE *cacheout;
+  XLASI_Entry *frametab; /* the includes being recorded */
+  int framenum;
+  XLASI_Entry *donetab; /* the includes recorded in this pass */
+  int donenum;
+  XLASI_Entry hit; /* the entry being spliced, freed after an error */
+  int cachehits;
+
+  XLASI_Reloc *rltab;
+  int rlnum;
+  int rlcap;
+  int objmode; /* -c */
+  int termrel; /* the last term moves with the object */
+  int exprrel; /* the last expression moves with the object */
+
+  XLASI_Lexer *L;
+  XLASI_Tok curtok;
+  XLASI_Sect *outbuf;
+};
+
+/*
+Print error and stop the assembly of the thread.
+*/
+static void
+XLASI_asmerr(const char *fmt, ...);
+
+/*
+Create the thread key and fill the tables once per program.
+*/
+static void
+XLASI_initonce(void);
+
+/*
+Assemble the file in the passes, resolve the backpatches
+and write what the options ask for.
+*/
+static void
+XLASI_assemblefile(XLAS *A, const char *filename);
+
+/*
+Write the image or the object to the file.
+*/
+static void
+XLASI_writeout(XLAS *A, const char *filename);
+
+/*
+Read the next proto-token.
+*/
+static int
+XLASI_readprototok(XLAS *A);
+
+/*
+Read the next token.
+*/
+static int
+XLASI_readtok(XLAS *A);
+
+/*
+Convert the string to the string index.
+*/
+static int
+XLASI_getsi(XLAS *A, const char *str);
+
+/*
+Convert the string slice to the string index, the index of
+a keyword is its type. The slice is copied only if it is new.
+*/
+static int
+XLASI_getsn(XLAS *A, const char *str, size_t len);
+
+/*
+Convert the string index to the string.
+*/
+static const char *
+XLASI_getstr(XLAS *A, int si);
+
+/*
+Hash the string (FNV-1a).
+*/
+static unsigned long
+XLASI_strhash(const char *str, size_t len);
+
+/*
+Double the capacity of the string hash table.
+*/
+static void
+XLASI_rehash(XLAS *A);
+
+/*
+Copy the string into the arena, the copy never moves.
+*/
+static const char *
+XLASI_arenadup(XLAS *A, const char *str, size_t len);
+
+/*
+Garantee to malloc
+*/
+static void *
+XLASI_domalloc(size_t size);
+
+/*
+Garantee to realloc
+*/
+static void *
+XLASI_dorealloc(void *oldptr, size_t newsize);
+
+/*
+Parse integer.
+*/
+static int
+XLASI_strint(const char *s, int len, int *err_out);
+
+/*
+Fill the character class table.
+*/
+static void
+XLASI_initclasses(void);
+
+/*
+Get digit value.
+*/
+static int
+XLASI_digitv(int ch);
+
+/*
+Read the whole file into memory and join the backslash-newlines.
+*/
+static void
+XLASI_readsrc(XLASI_Source *src);
+
+/*
+Join the backslash-newlines of the size bytes in place.
+*/
+static void
+XLASI_joinsrc(XLASI_Source *src, size_t size);
+
+/*
+Get the source of the file. The assembly keeps the source it got
+first, the other assemblers share it while the file keeps its size
+and modification time.
+*/
+static XLASI_Source *
+XLASI_findsrc(XLAS *A, const char *filename);
+
+/*
+Put the source read by the assembly into XLASI_srchash instead of
+the stale one with its name. Call with XLASI_srclock held.
+*/
+static void
+XLASI_sharesrc(XLASI_Source *src, unsigned long hash);
+
+/*
+Release the source used by an assembler, free it when nobody uses
+it and it is not shared.
+*/
+static void
+XLASI_dropsrc(XLASI_Source *src);
+
+/*
+Free the shared sources nobody uses, at exit.
+*/
+static void
+XLASI_freesrcs(void);
+
+static void
+XLASI_freesrc(XLASI_Source *src);
+
+/*
+Create new lexer.
+*/
+static XLASI_Lexer *
+XLASI_newlex(XLAS *A, const char *filename, XLASI_Lexer *prev);
+
+/*
+Create new lexer of the source.
+*/
+static XLASI_Lexer *
+XLASI_srclex(const XLASI_Source *src, const char *filename
+            , XLASI_Lexer *prev);
+
+/*
+Write bytes into the section.
+*/
+static void
+XLASI_emit(XLASI_Sect *sect, const char *buf, int len);
+
+/*
+Write one byte several times into the section.
+*/
+static void
+XLASI_emitbyte(XLASI_Sect *sect, unsigned char data, int times);
+
+/*
+Write one word into the section (little endian).
+*/
+static void
+XLASI_emitle16(XLASI_Sect *sect, unsigned int word);
+
+static void
+XLASI_emit8method(XLASI_Sect *sect, int data);
+
+static void
+XLASI_emit16method(XLASI_Sect *sect, int data);
+
+/*
+Put the mapped file into the section without copying it.
+*/
+static void
+XLASI_emitmapped(XLASI_Sect *sect, char *data, int size);
+
+/*
+Overwrite an emitted byte of the section.
+*/
+static void
+XLASI_patchbyte(XLASI_Sect *sect, int offset, unsigned char data);
+
+/*
+Read the byte at the offset of the section.
+*/
+static int
+XLASI_sectbyte(const XLASI_Sect *sect, int offset);
+
+/*
+Find the run that holds the offset.
+*/
+static XLASI_Run *
+XLASI_findrun(const XLASI_Sect *sect, int offset);
+
+/*
+Get the last run if it holds bytes, with the room for len more,
+or start a new one.
+*/
+static XLASI_Run *
+XLASI_bytesrun(XLASI_Sect *sect, int len);
+
+/*
+Start a new run at the end of the section.
+*/
+static XLASI_Run *
+XLASI_newrun(XLASI_Sect *sect, int kind);
+
+/*
+Empty the section and unmap its files.
+*/
+static void
+XLASI_clearsect(XLASI_Sect *sect);
+
+/*
+Write the section to the file with writev, 0 on success.
+*/
+static int
+XLASI_writesect(const XLASI_Sect *sect, FILE *out);
+
+/*
+Free the lexer, the source stays.
+*/
+static void
+XLASI_freelex(XLASI_Lexer *lex);
+
+/*
+Assemble the whole input once,
+return non-zero if another pass is required.
+*/
+static int
+XLASI_assemble(XLAS *A, const char *filename);
+
+/*
+Allocate the relaxation state of the next instruction.
+*/
+static int
+XLASI_newsite(XLAS *A);
+
+/*
+Make the site long for good or short for now,
+return non-zero if the site is long.
+*/
+static int
+XLASI_settle(XLAS *A, int site, int islong);
+
+/*
+Append the entry to the peephole IR.
+*/
+static void
+XLASI_pushir(XLAS *A, int kind, int site, int inst, int mtype, int opcode
+            , int name, int val);
+
+/*
+Choose the peephole rewrites from the IR of the first pass,
+return non-zero if there are any.
+*/
+static int
+XLASI_peephole(XLAS *A);
+
+/*
+Check if the flags Z and N are overwritten after the IR entry
+before anything reads them.
+*/
+static int
+XLASI_isdeadzn(XLAS *A, int at);
+
+/*
+Check if the instruction sets A and the flags Z and N from it.
+*/
+static int
+XLASI_issetazn(int inst);
+
+/*
+Check if a store and a load at the address may differ.
+*/
+static int
+XLASI_isvolatile(int addr);
+
+/*
+Get the IR entry of the jump target if the entry is a jump
+to a label, -1 otherwise.
+*/
+static int
+XLASI_jumptarget(XLAS *A, int at, const int *labelat);
+
+/*
+Print what the peephole rewrites saved.
+*/
+static void
+XLASI_reportopt(XLAS *A);
+
+/*
+Get the conditional jump with the opposite condition.
+*/
+static int
+XLASI_invbranch(int inst);
+
+/*
+Interpret the next line.
+*/
+static int
+XLASI_readline(XLAS *A);
+
+static void
+XLASI_readinst(XLAS *A, int inst);
+
+static void
+XLASI_dolet(XLAS *A);
+
+static void
+XLASI_dovar(XLAS *A);
+
+/*
+Find the var declaration of the name, -1 if there is none.
+*/
+static int
+XLASI_finddecl(XLAS *A, int name);
+
+/*
+Record the reference to the name for the var allocation.
+*/
+static void
+XLASI_addref(XLAS *A, int name, int addr, int ismem);
+
+/*
+Record the RAM byte that the program addresses by itself.
+*/
+static void
+XLASI_marktaken(XLAS *A, int addr);
+
+/*
+Record the backward jump for the var allocation.
+*/
+static void
+XLASI_addloop(XLAS *A, int lo, int hi);
+
+/*
+Find the first free RAM run of the size in [lo, hi), -1 if none.
+*/
+static int
+XLASI_findfree(XLAS *A, int lo, int hi, int size);
+
+/*
+Order the vars by the weight per byte, the hottest first.
+*/
+static int
+XLASI_cmpdecl(const void *a, const void *b);
+
+/*
+Order the integers ascending.
+*/
+static int
+XLASI_cmpint(const void *a, const void *b);
+
+/*
+Place the vars, the hottest per byte in the zero page.
+*/
+static void
+XLASI_allocvars(XLAS *A);
+
+static void
+XLASI_dorb(XLAS *A);
+
+static void
+XLASI_doinclude(XLAS *A);
+
+static void
+XLASI_doincbin(XLAS *A);
+
+/*
+Define the macro or the inline procedure.
+*/
+static void
+XLASI_domacro(XLAS *A, int kind);
+
+/*
+Repeat the lines up to endr.
+*/
+static void
+XLASI_dorept(XLAS *A);
+
+/*
+Record the lines up to the end keyword as the body of the macro.
+*/
+static void
+XLASI_recordbody(XLAS *A, int mi, int endtype);
+
+/*
+Read the arguments of the macro and expand it.
+*/
+static void
+XLASI_callmacro(XLAS *A, int mi);
+
+/*
+Replay the body of the macro several times with the arguments
+in place of the parameters and new names for the local labels.
+*/
+static void
+XLASI_expand(XLAS *A, int mi, const XLASI_Mtok *args, const int *argstart
+            , int copies);
+
+/*
+Find the macro or the inline procedure of the name, -1 if none.
+*/
+static int
+XLASI_findmacro(XLAS *A, int name);
+
+/*
+Copy the current source line for the listing.
+*/
+static const char *
+XLASI_linetext(XLAS *A);
+
+/*
+Print the code that the expansions add.
+*/
+static void
+XLASI_reportexpand(XLAS *A);
+
+static int
+XLASI_evalexpr(XLAS *A);
+
+static int
+XLASI_evalterm(XLAS *A);
+
+static int
+XLASI_findvar(XLAS *A, int name);
+
+static int
+XLASI_setvar(XLAS *A, int name, int val, int islabel, int isrel);
+
+static void
+XLASI_defvals(XLAS *A, int iswords);
+
+static void
+XLASI_planpatch(XLAS *A, int offset, int label, int isrel, int size
+               , XLASI_Tok tok);
+
+/*
+Record the relocation of the object.
+*/
+static void
+XLASI_addreloc(XLAS *A, int offset, int kind, int name);
+
+/*
+Stop if the value moves with the object.
+*/
+static void
+XLASI_checkabs(XLAS *A, int isrel, XLASI_Tok tok);
+
+/*
+Write the object with the symbols and the relocations.
+*/
+static void
+XLASI_writeobj(XLAS *A, FILE *out, const char *filename);
+
+/*
+Write the symbols to the map file.
+*/
+static void
+XLASI_writemap(XLAS *A, const char *filename);
+
+/*
+Start the listing entry of the line at the token.
+*/
+static int
+XLASI_addlisting(XLAS *A, XLASI_Tok tok);
+
+/*
+Write the addresses, the bytes and the cycles of every line.
+*/
+static void
+XLASI_writelisting(XLAS *A, const char *filename);
+
+/*
+Make room for one more element in the array of num elements,
+the capacity doubles at every power of two from 8.
+*/
+static void *
+XLASI_growarr(void *arr, int num, size_t size);
+
+/*
+Mark the include being assembled as not cacheable.
+*/
+static void
+XLASI_taint(XLAS *A, const char *why);
+
+/*
+Record the forward name and its prediction for the cache entry.
+*/
+static void
+XLASI_notepred(XLAS *A, int name);
+
+/*
+Mix the bytes into the cache key.
+*/
+static void
+XLASI_hashbytes(unsigned long *key, const void *buf, size_t len);
+
+static void
+XLASI_hashint(unsigned long *key, int val);
+
+/*
+Hash the file, the origin and the visible symbols,
+-1 if the file cannot be read.
+*/
+static int
+XLASI_cachekey(XLAS *A, const char *filename, unsigned long *key);
+
+/*
+Get the cache file name of the key.
+*/
+static const char *
+XLASI_cachepath(XLAS *A, const unsigned long *key);
+
+/*
+Read the cache entry of the key, -1 if there is none.
+*/
+static int
+XLASI_loadentry(XLAS *A, XLASI_Entry *ent);
+
+/*
+Put the cached include into the section if it was assembled
+in the same state, return non-zero if it was.
+*/
+static int
+XLASI_splicecache(XLAS *A, XLASI_Entry *ent, XLASI_Tok tok);
+
+/*
+Start recording the include that the cache does not have.
+*/
+static void
+XLASI_beginframe(XLAS *A, const char *filename, const unsigned long *key);
+
+/*
+Finish recording the include at the end of its file.
+*/
+static void
+XLASI_endframe(XLAS *A);
+
+static void
+XLASI_freeentry(XLASI_Entry *ent);
+
+/*
+Store the includes of the final pass and report the hits of the
+file to cacheout.
+*/
+static void
+XLASI_writecache(XLAS *A, const char *filename);
+
+static unsigned char XLASI_cclass[256];
+static int XLASI_ctype[256]; /* token type of a Cop character */
+
+static pthread_once_t XLASI_asmonce = PTHREAD_ONCE_INIT;
+static pthread_key_t XLASI_asmkey; /* the XLAS of XLASI_asmerr */
+static int XLASI_asmnum;
+static pthread_mutex_t XLASI_asmlock = PTHREAD_MUTEX_INITIALIZER;
+static XLASI_Source *XLASI_srchash[XLASI_SRCHASH]; /* by the name */
+static pthread_mutex_t XLASI_srclock = PTHREAD_MUTEX_INITIALIZER;
+
+/************************************************************/
+XLAS *
+XLAS_new(const XLAS_Options *opts)
+{
+  static const XLAS_Options none;
+  XLAS *A = NULL;
+  int i = 0;
+  pthread_once(&XLASI_asmonce, XLASI_initonce);
+  if (opts == NULL)
+    opts = &none;
+  A = XLASI_NEW(XLAS);
+  pthread_mutex_lock(&XLASI_asmlock);
+  A->id = XLASI_asmnum++;
+  pthread_mutex_unlock(&XLASI_asmlock);
+  A->optimize = opts->optimize;
+  A->objmode = opts->objmode;
+  A->listname = opts->listname;
+  A->expandrep = opts->expandrep;
+  A->optout = opts->optout != NULL ? opts->optout : stderr;
+  A->expandout = opts->expandout != NULL ? opts->expandout : stdout;
+  A->cacheout = opts->cacheout != NULL ? opts->cacheout : stdout;
+  /* the cache entries do not record the IR, relocations and listing */
+  if (!A->optimize && !A->objmode && A->listname == NULL)
+    A->cachedir = opts->cachedir;
+  A->outbuf = XLASI_NEW(XLASI_Sect);
+  A->outbuf->maxsize = XLAS_IMAGE_SIZE;
+  A->strcap = Tcount * 2;
+  A->strtab = XLASI_domalloc(A->strcap * sizeof(A->strtab[0]));
+  A->strhashes = XLASI_domalloc(A->strcap * sizeof(A->strhashes[0]));
+  A->varidx = XLASI_domalloc(A->strcap * sizeof(A->varidx[0]));
+  A->predval = XLASI_domalloc(A->strcap * sizeof(A->predval[0]));
+  A->declidx = XLASI_domalloc(A->strcap * sizeof(A->declidx[0]));
+  A->macidx = XLASI_domalloc(A->strcap * sizeof(A->macidx[0]));
+  A->srcidx = XLASI_domalloc(A->strcap * sizeof(A->srcidx[0]));
+  for (A->hcap = 16; A->hcap < A->strcap * 2; A->hcap *= 2)
+    /* nothing */;
+  A->htab = memset(XLASI_domalloc(A->hcap * sizeof(A->htab[0])), 0
+                  , A->hcap * sizeof(A->htab[0]));
+  /* the keywords are the first strings, found by XL_find_keyword */
+  for (i = 0; i < Tcount; ++i) {
+    A->strtab[i] = XL_keywords[i];
+    A->strhashes[i] = 0;
+    A->varidx[i] = 0;
+    A->predval[i] = -1;
+    A->declidx[i] = 0;
+    A->macidx[i] = 0;
+    A->srcidx[i] = 0;
+  }
+  A->strnum = Tcount;
+  A->varcap = 8;
+  A->vartab = XLASI_domalloc(A->varcap * sizeof(A->vartab[0]));
+  A->bpcap = 8;
+  A->bptab = XLASI_domalloc(A->bpcap * sizeof(A->bptab[0]));
+  return A;
+}
+
+/************************************************************/
+int
+XLAS_assemble(XLAS *A, const char *filename, const char *src, size_t len)
+{
+  assert(A != NULL && filename != NULL && !A->assembled);
+  if (setjmp(A->fail) != 0) {
+    pthread_setspecific(XLASI_asmkey, NULL);
+    return -1;
+  }
+  pthread_setspecific(XLASI_asmkey, A);
+  if (src != NULL) {
+    A->mainsrc = XLASI_NEW(XLASI_Source);
+    A->mainsrc->filename = filename;
+    A->mainsrc->buf = memcpy(XLASI_domalloc(len + 1), src, len);
+    XLASI_joinsrc(A->mainsrc, len);
+  }
+  XLASI_assemblefile(A, filename);
+  A->assembled = 1;
+  pthread_setspecific(XLASI_asmkey, NULL);
+  return 0;
+}
+
+/************************************************************/
+int
+XLAS_image(XLAS *A, unsigned char *rom)
+{
+  const XLASI_Run *run = NULL;
+  int i = 0;
+  assert(A != NULL && A->assembled && rom != NULL);
+  memset(rom, 0, XLAS_IMAGE_SIZE);
+  for (i = 0; i < A->outbuf->runnum; ++i) {
+    run = &A->outbuf->runs[i];
+    if (run->kind == XLASI_Rfill)
+      memset(rom + run->offset, run->fill, run->size);
+    else
+      memcpy(rom + run->offset, run->data, run->size);
+  }
+  return A->outbuf->size;
+}
+
+/************************************************************/
+const XLAS_Symbol *
+XLAS_symbols(XLAS *A, int *num)
+{
+  XLAS_Symbol *sym = NULL;
+  int i = 0;
+  assert(A != NULL && A->assembled && num != NULL);
+  /* skip $ and $$ */
+  if (A->symtab == NULL) {
+    A->symtab = XLASI_domalloc(A->varnum * sizeof(A->symtab[0]));
+    for (i = 2; i < A->varnum; ++i) {
+      sym = &A->symtab[i - 2];
+      sym->name = XLASI_getstr(A, A->vartab[i].name);
+      sym->val = A->vartab[i].val & 0xFFFF;
+      sym->islabel = A->vartab[i].islabel;
+    }
+  }
+  *num = A->varnum - 2;
+  return A->symtab;
+}
+
+/************************************************************/
+int
+XLAS_write(XLAS *A, const char *oname, const char *mname)
+{
+  assert(A != NULL && A->assembled && oname != NULL);
+  if (setjmp(A->fail) != 0) {
+    pthread_setspecific(XLASI_asmkey, NULL);
+    /* do not leave the half written output */
+    if (A->out != NULL) {
+      fclose(A->out);
+      A->out = NULL;
+      remove(oname);
+    }
+    return -1;
+  }
+  pthread_setspecific(XLASI_asmkey, A);
+  XLASI_writeout(A, oname);
+  if (mname != NULL)
+    XLASI_writemap(A, mname);
+  pthread_setspecific(XLASI_asmkey, NULL);
+  return 0;
+}
+
+/************************************************************/
+void
+XLAS_free(XLAS *A)
+{
+  XLASI_Arena *a = NULL;
+  XLASI_Lexer *lex = NULL;
+  int i = 0;
+  if (A == NULL)
+    return;
+  /* a failed assembly leaves its lexers */
+  while (A->L != NULL) {
+    lex = A->L->prev;
+    XLASI_freelex(A->L);
+    A->L = lex;
+  }
+  while (A->arena != NULL) {
+    a = A->arena->prev;
+    free(A->arena);
+    A->arena = a;
+  }
+  for (i = 0; i < A->macnum; ++i) {
+    free(A->mactab[i].toks);
+    free(A->mactab[i].params);
+    free(A->mactab[i].locals);
+  }
+  for (i = 0; i < A->framenum; ++i)
+    XLASI_freeentry(&A->frametab[i]);
+  for (i = 0; i < A->donenum; ++i)
+    XLASI_freeentry(&A->donetab[i]);
+  XLASI_freeentry(&A->hit);
+  if (A->mainsrc != NULL) {
+    free(A->mainsrc->buf);
+    free(A->mainsrc->splices);
+    free(A->mainsrc);
+  }
+  for (i = 0; i < A->srcnum; ++i)
+    XLASI_dropsrc(A->srctab[i]);
+  free(A->srctab);
+  XLASI_clearsect(A->outbuf);
+  free(A->outbuf->runs);
+  free(A->outbuf);
+  free(A->strtab);
+  free(A->strhashes);
+  free(A->varidx);
+  free(A->predval);
+  free(A->declidx);
+  free(A->macidx);
+  free(A->srcidx);
+  free(A->htab);
+  free(A->vartab);
+  free(A->bptab);
+  free(A->sitetab);
+  free(A->irtab);
+  free(A->decltab);
+  free(A->reftab);
+  free(A->looptab);
+  free(A->mactab);
+  free(A->lstab);
+  free(A->frametab);
+  free(A->donetab);
+  free(A->rltab);
+  free(A->symtab);
+  free(A->pathbuf);
+  free(A);
+}
+
+/************************************************************/
+void
+XLASI_initonce(void)
+{
+  if (pthread_key_create(&XLASI_asmkey, NULL) != 0) {
+    fprintf(stderr, "xlas: Cannot create the thread key\n");
+    exit(EXIT_FAILURE);
+  }
+  if (XL_init_keywords() != 0) {
+    fprintf(stderr, "xlas: XL_keyhash is stale, run xlas -K\n");
+    exit(EXIT_FAILURE);
+  }
+  XLASI_initclasses();
+  XL_init_opcodes();
+  atexit(XLASI_freesrcs);
+}
+
+/************************************************************/
+void
+XLASI_assemblefile(XLAS *A, const char *filename)
+{
+  XLASI_Backpatch *bp = NULL;
+  int i = 0, addr = 0, rel = 0, dlr = 0, pass = 0, again = 0;
+  int vi = 0;
+  for (pass = 1; ; ++pass) {
+    again = XLASI_assemble(A, filename);
+    if (pass == 1 && A->optimize)
+      again |= XLASI_peephole(A);
+    if (!again)
+      break;
+    if (pass == XLASI_PASSCAP)
+      XLASI_asmerr("xlas: The code size does not settle in %i passes\n"
+                  , pass);
+  }
+  for (i = 0; i < A->bpnum; ++i) {
+    bp = &A->bptab[i];
+    vi = XLASI_findvar(A, bp->label);
+    if (vi < 0) {
+      /* imported, xlld fills it in */
+      XLASI_addreloc(A, bp->offset, bp->isrel ? XL_RELOC_REL8
+                    : (bp->size == 1) ? XL_RELOC_ABS8 : XL_RELOC_ABS16
+                    , bp->label);
+      continue;
+    }
+    addr = A->vartab[vi].val;
+    if (A->vartab[vi].isrel && !bp->isrel) {
+      if (bp->size == 1)
+        XLASI_checkabs(A, 1, bp->tok);
+      XLASI_addreloc(A, bp->offset, XL_RELOC_ABS16, -1);
+    }
+    if (bp->isrel) {
+      dlr = 0x8000 + bp->offset - 1;
+      rel = addr - dlr;
+      if (rel > 127 || rel < -128)
+        XLASI_asmerr("%s:%i:%i: The label is too far\n"
+                    , bp->tok.filename, bp->tok.row, bp->tok.col);
+      XLASI_patchbyte(A->outbuf, bp->offset, rel);
+    }
+    else if (bp->size == 1) {
+      if (addr > 255)
+        XLASI_asmerr("%s:%i:%i: The value does not fit in the zero page\n"
+                    , bp->tok.filename, bp->tok.row, bp->tok.col);
+      XLASI_patchbyte(A->outbuf, bp->offset, addr);
+    }
+    else {
+      XLASI_patchbyte(A->outbuf, bp->offset, addr & 0xFF);
+      XLASI_patchbyte(A->outbuf, bp->offset + 1, (addr >> 8) & 0xFF);
+    }
+  }
+  if (A->cachedir != NULL)
+    XLASI_writecache(A, filename);
+  if (A->listname != NULL)
+    XLASI_writelisting(A, A->listname);
+  if (A->optimize)
+    XLASI_reportopt(A);
+  if (A->expandrep)
+    XLASI_reportexpand(A);
+}
+
+
+/************************************************************/
+void
+XLASI_writeout(XLAS *A, const char *filename)
+{
+  A->out = fopen(filename, "wb");
+  if (A->out == NULL)
+    XLASI_asmerr("%s: %s\n", filename, strerror(errno));
+  if (A->objmode)
+    XLASI_writeobj(A, A->out, filename);
+  else if (XLASI_writesect(A->outbuf, A->out) != 0)
+    XLASI_asmerr("%s: Cannot write the file\n", filename);
+  fclose(A->out);
+  A->out = NULL;
+}
+
+/************************************************************/
+int
+XLASI_assemble(XLAS *A, const char *filename)
+{
+  XLASI_Backpatch *bp = NULL;
+  XLASI_Var *var = NULL;
+  int i = 0, again = 0;
+  memset(A->varidx, 0, A->strnum * sizeof(A->varidx[0]));
+  A->varnum = 0;
+  A->bpnum = 0;
+  A->sitenum = 0;
+  A->guessed = 0;
+  A->predicted = 0;
+  A->rlnum = 0;
+  A->lsnum = 0;
+  A->expandnum = 0;
+  A->expanddepth = 0;
+  for (i = 0; i < A->macnum; ++i)
+    A->mactab[i].uses = A->mactab[i].bytes = 0;
+  for (i = 0; i < A->donenum; ++i)
+    XLASI_freeentry(&A->donetab[i]);
+  A->donenum = 0;
+  A->cachehits = 0;
+  A->passnum++;
+  A->irnum = 0;
+  A->optbytes = A->optcycles = 0;
+  memset(A->optnum, 0, sizeof(A->optnum));
+  XLASI_clearsect(A->outbuf);
+  XLASI_setvar(A, XLASI_getsi(A, "$"), 0, 0, 1);
+  XLASI_setvar(A, XLASI_getsi(A, "$$"), 0x8000, 0, 1);
+  if (A->mainsrc != NULL)
+    A->L = XLASI_srclex(A->mainsrc, filename, NULL);
+  else
+    A->L = XLASI_newlex(A, filename, NULL);
+  XLASI_readtok(A);
+  while (XLASI_readline(A) == 0)
+    /* nothing */;
+  XLASI_freelex(A->L);
+  A->L = NULL;
+  if (A->passnum == 1)
+    XLASI_allocvars(A);
+  for (i = 0; i < A->bpnum; ++i) {
+    bp = &A->bptab[i];
+    if (XLASI_findvar(A, bp->label) < 0 && XLASI_finddecl(A, bp->label) < 0
+       && !A->objmode)
+      XLASI_asmerr("%s:%i:%i: The label is never defined\n"
+                  , bp->tok.filename, bp->tok.row, bp->tok.col);
+  }
+  /* the pass is final if every prediction came true */
+  again = A->guessed;
+  for (i = 0; i < A->varnum; ++i) {
+    var = &A->vartab[i];
+    if (A->predicted && A->predval[var->name] != var->val)
+      again = 1;
+    A->predval[var->name] = var->val;
+  }
+  return again;
+}
+
+/************************************************************/
+int
+XLASI_newsite(XLAS *A)
+{
+  XLASI_Entry *fr = NULL;
+  if (A->sitenum + 1 > A->sitecap) {
+    A->sitecap = A->sitecap ? A->sitecap * 2 : 256;
+    A->sitetab = XLASI_dorealloc(A->sitetab
+                                , A->sitecap * sizeof(A->sitetab[0]));
+    memset(A->sitetab + A->sitenum, 0
+          , (A->sitecap - A->sitenum) * sizeof(A->sitetab[0]));
+  }
+  if (A->framenum > 0) {
+    /* the state left by the previous pass */
+    fr = &A->frametab[A->framenum - 1];
+    fr->before = XLASI_growarr(fr->before, fr->sitenum, 1);
+    fr->before[fr->sitenum++] = A->sitetab[A->sitenum].state;
+  }
+  return A->sitenum++;
+}
+
+/************************************************************/
+int
+XLASI_settle(XLAS *A, int site, int islong)
+{
+  if (A->sitetab[site].state != XLASI_Slong)
+    A->sitetab[site].state = islong ? XLASI_Slong : XLASI_Sshort;
+  return A->sitetab[site].state == XLASI_Slong;
+}
+
+/************************************************************/
+int
+XLASI_invbranch(int inst)
+{
+  char name[4];
+  int i = 0;
+  /* jtz <-> jfz and so on */
+  strcpy(name, XL_keywords[inst]);
+  name[1] = (name[1] == 't') ? 'f' : 't';
+  for (i = 0; i < Tcount; ++i)
+    if (strcmp(XL_keywords[i], name) == 0)
+      return i;
+  return inst;
+}
+
+/************************************************************/
+void
+XLASI_pushir(XLAS *A, int kind, int site, int inst, int mtype, int opcode
+            , int name, int val)
+{
+  XLASI_Ir *ir = NULL;
+  if (!A->optimize)
+    return;
+  if (A->irnum + 1 > A->ircap) {
+    A->ircap = A->ircap ? A->ircap * 2 : 256;
+    A->irtab = XLASI_dorealloc(A->irtab, A->ircap * sizeof(A->irtab[0]));
+  }
+  ir = &A->irtab[A->irnum++];
+  ir->kind = kind;
+  ir->site = site;
+  ir->inst = inst;
+  ir->mtype = mtype;
+  ir->opcode = opcode;
+  ir->name = name;
+  ir->val = val;
+}
+
+/************************************************************/
+int
+XLASI_peephole(XLAS *A)
+{
+  XLASI_Ir *ir = NULL, *p = NULL;
+  XLASI_Site *st = NULL;
+  int *labelat = NULL;
+  int i = 0, k = 0, prev = -1, prev2 = -1, val = 0, cur = 0, hops = 0;
+  int any = 0;
+  labelat = XLASI_domalloc(A->strnum * sizeof(labelat[0]));
+  for (i = 0; i < A->strnum; ++i)
+    labelat[i] = -1;
+  for (i = 0; i < A->irnum; ++i)
+    if (A->irtab[i].kind == XLASI_Ilabel)
+      labelat[A->irtab[i].name] = i;
+  for (i = 0; i < A->irnum; ++i) {
+    ir = &A->irtab[i];
+    if (ir->kind != XLASI_Iinst) {
+      prev = prev2 = -1;
+      continue;
+    }
+    st = &A->sitetab[ir->site];
+    p = (prev >= 0) ? &A->irtab[prev] : NULL;
+    val = (ir->val < 0 && ir->name != 0) ? A->predval[ir->name] : ir->val;
+    /**/ if (p != NULL && ((p->inst == Ttax && ir->inst == Ttxa)
+                        || (p->inst == Ttxa && ir->inst == Ttax)
+                        || (p->inst == Ttay && ir->inst == Ttya)
+                        || (p->inst == Ttya && ir->inst == Ttay))) {
+      st->opt = XLASI_Otransfer;
+    }
+    else if (p != NULL && p->inst == Tsta && ir->inst == Tlda
+            && p->mtype == Mabs && ir->mtype == Mabs
+            && p->name == ir->name && (ir->name != 0 || p->val == ir->val)
+            && ir->name != XLASI_getsi(A, "$") && !XLASI_isvolatile(val)
+            && (XLASI_isdeadzn(A, i)
+               || (prev2 >= 0 && XLASI_issetazn(A->irtab[prev2].inst)))) {
+      st->opt = XLASI_Oload;
+    }
+    else if (ir->inst == Tcal && i + 1 < A->irnum
+            && A->irtab[i + 1].kind == XLASI_Iinst
+            && A->irtab[i + 1].inst == Tret) {
+      st->opt = XLASI_Otail;
+      A->sitetab[A->irtab[i + 1].site].opt = XLASI_Oret;
+      ++i;
+    }
+    else if (XLASI_jumptarget(A, i, labelat) >= 0) {
+      for (k = i + 1; k < A->irnum && A->irtab[k].kind == XLASI_Ilabel; ++k)
+        if (A->irtab[k].name == ir->name)
+          break;
+      if (k < A->irnum && A->irtab[k].kind == XLASI_Ilabel) {
+        st->opt = XLASI_Onext;
+      }
+      else {
+        /* follow the chain of jumps, but not forever */
+        cur = i;
+        st->saved = 0;
+        for (hops = 0; hops < 16; ++hops) {
+          k = XLASI_jumptarget(A, cur, labelat);
+          while (k < A->irnum && A->irtab[k].kind == XLASI_Ilabel)
+            ++k;
+          if (k >= A->irnum || A->irtab[k].inst != Tjmp || k == cur
+             || XLASI_jumptarget(A, k, labelat) < 0)
+            break;
+          st->saved += XL_opcycles(A->irtab[k].opcode);
+          cur = k;
+        }
+        if (cur != i) {
+          st->opt = XLASI_Othread;
+          st->target = A->irtab[cur].name;
+        }
+      }
+    }
+    any |= st->opt != XLASI_Okeep;
+    if (st->opt != XLASI_Okeep && st->opt != XLASI_Otail)
+      continue;
+    prev2 = prev;
+    prev = i;
+    /* control goes elsewhere, the block ends */
+    if ((Tjfb <= ir->inst && ir->inst <= Tcal) || ir->inst == Tret
+       || ir->inst == Trti || ir->inst == Tbrk || ir->inst == Tinv)
+      prev = prev2 = -1;
+  }
+  free(labelat);
+  return any;
+}
+
+/************************************************************/
+int
+XLASI_isdeadzn(XLAS *A, int at)
+{
+  int i = 0, t = 0;
+  for (i = at + 1; i < A->irnum && A->irtab[i].kind == XLASI_Iinst; ++i) {
+    t = A->irtab[i].inst;
+    if (t == Tphf || t == Ttfa || t == Tfor || t == Tfnd)
+      return 0;
+    if ((Tapp <= t && t <= Tdec) || (Tlda <= t && t <= Tldy)
+       || (Tpla <= t && t <= Tply) || t == Ttaf
+       || (Tcmp <= t && t <= Tsra))
+      return 1;
+    if ((Tjfb <= t && t <= Tcal) || t == Tret || t == Trti
+       || t == Tbrk || t == Tinv)
+      return 0;
+  }
+  return 0;
+}
+
+/************************************************************/
+int
+XLASI_issetazn(int inst)
+{
+  return inst == Tlda || inst == Tpla || inst == Tnta
+      || inst == Tapp || inst == Tamm
+      || (Tsbc <= inst && inst <= Tand)
+      || (Tsla <= inst && inst <= Tsra);
+}
+
+/************************************************************/
+int
+XLASI_isvolatile(int addr)
+{
+  /* the xlx I/O port and stop address, the ROM */
+  return addr < 0 || addr == 0xFF || addr >= 0x7FFF;
+}
+
+/************************************************************/
+int
+XLASI_jumptarget(XLAS *A, int at, const int *labelat)
+{
+  XLASI_Ir *ir = &A->irtab[at];
+  if (ir->kind != XLASI_Iinst || ir->name == 0 || labelat[ir->name] < 0)
+    return -1;
+  if (ir->inst == Tjmp && (ir->mtype == Mrel || ir->mtype == Mabs))
+    return labelat[ir->name];
+  if (Tjfb <= ir->inst && ir->inst <= Tjtz)
+    return labelat[ir->name];
+  return -1;
+}
+
+/************************************************************/
+void
+XLASI_reportopt(XLAS *A)
+{
+  static const char *names[XLASI_Ocount] = {
+    "", "store-load", "transfer", "jump-next", "tail-call", "",
+    "threading"
+  };
+  int i = 0;
+  fprintf(A->optout, "xlas: -O:");
+  for (i = XLASI_Oload; i < XLASI_Ocount; ++i)
+    if (i != XLASI_Oret)
+      fprintf(A->optout, " %s %i%s", names[i], A->optnum[i]
+             , (i + 1 < XLASI_Ocount) ? "," : "\n");
+  fprintf(A->optout, "xlas: -O: %i bytes and %i cycles saved\n"
+         , A->optbytes, A->optcycles);
+}
+
+/************************************************************/
+void
+XLASI_addreloc(XLAS *A, int offset, int kind, int name)
+{
+  XLASI_Reloc *rl = NULL;
+  if (!A->objmode)
+    return;
+  if (A->rlnum + 1 > A->rlcap) {
+    A->rlcap = A->rlcap ? A->rlcap * 2 : 64;
+    A->rltab = XLASI_dorealloc(A->rltab, A->rlcap * sizeof(A->rltab[0]));
+  }
+  rl = &A->rltab[A->rlnum++];
+  rl->offset = offset;
+  rl->kind = kind;
+  rl->name = name;
+}
+
+/************************************************************/
+void
+XLASI_checkabs(XLAS *A, int isrel, XLASI_Tok tok)
+{
+  if (A->objmode && isrel)
+    XLASI_asmerr("%s:%i:%i: The value moves with the object\n"
+                , tok.filename, tok.row, tok.col);
+}
+
+/************************************************************/
+void
+XLASI_writeobj(XLAS *A, FILE *out, const char *filename)
+{
+  unsigned char head[14];
+  unsigned char rec[6];
+  int *symidx = NULL, *syms = NULL;
+  XLASI_Reloc *rl = NULL;
+  const char *name = NULL;
+  int i = 0, symnum = 0, len = 0, vi = 0, idx = 0;
+  symidx = XLASI_domalloc(A->strnum * sizeof(symidx[0]));
+  syms = XLASI_domalloc((A->varnum + A->rlnum) * sizeof(syms[0]));
+  for (i = 0; i < A->strnum; ++i)
+    symidx[i] = -1;
+  /* exported labels first, then imported names */
+  for (i = 2; i < A->varnum + A->rlnum; ++i) {
+    if (i < A->varnum && !A->vartab[i].islabel)
+      continue;
+    idx = (i < A->varnum) ? A->vartab[i].name : A->rltab[i - A->varnum].name;
+    if (idx < 0 || symidx[idx] >= 0)
+      continue;
+    syms[symnum] = idx;
+    symidx[idx] = symnum++;
+  }
+  memcpy(head, XL_OBJECT_MAGIC, 8);
+  head[8] = A->outbuf->size & 0xFF;
+  head[9] = A->outbuf->size >> 8;
+  head[10] = symnum & 0xFF;
+  head[11] = symnum >> 8;
+  head[12] = A->rlnum & 0xFF;
+  head[13] = A->rlnum >> 8;
+  fwrite(head, 1, sizeof(head), out);
+  /* XLAS_write closes the file after an error */
+  if (XLASI_writesect(A->outbuf, out) != 0) {
+    free(syms);
+    free(symidx);
+    XLASI_asmerr("%s: Cannot write the file\n", filename);
+  }
+  for (i = 0; i < symnum; ++i) {
+    name = XLASI_getstr(A, syms[i]);
+    len = strlen(name);
+    if (len > 255) {
+      free(syms);
+      free(symidx);
+      XLASI_asmerr("%s: The name is too long for the object: %s\n"
+                  , filename, name);
+    }
+    vi = XLASI_findvar(A, syms[i]);
+    idx = (vi >= 0) ? A->vartab[vi].val - 0x8000 : 0;
+    rec[0] = idx & 0xFF;
+    rec[1] = (idx >> 8) & 0xFF;
+    rec[2] = (vi >= 0) ? XL_SYM_EXPORT : XL_SYM_IMPORT;
+    rec[3] = len;
+    fwrite(rec, 1, 4, out);
+    fwrite(name, 1, len, out);
+  }
+  for (i = 0; i < A->rlnum; ++i) {
+    rl = &A->rltab[i];
+    idx = (rl->name < 0) ? XL_RELOC_SELF : symidx[rl->name];
+    rec[0] = rl->offset & 0xFF;
+    rec[1] = (rl->offset >> 8) & 0xFF;
+    rec[2] = rl->kind;
+    rec[3] = 0;
+    rec[4] = idx & 0xFF;
+    rec[5] = (idx >> 8) & 0xFF;
+    fwrite(rec, 1, 6, out);
+  }
+  free(syms);
+  free(symidx);
+  if (ferror(out))
+    XLASI_asmerr("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+void
+XLASI_writemap(XLAS *A, const char *filename)
+{
+  FILE *map = NULL;
+  XLASI_Var *var = NULL;
+  int i = 0, err = 0;
+  map = fopen(filename, "w");
+  if (map == NULL)
+    XLASI_asmerr("%s: %s\n", filename, strerror(errno));
+  /* skip $ and $$ */
+  for (i = 2; i < A->varnum; ++i) {
+    var = &A->vartab[i];
+    fprintf(map, "0x%04X %c %s\n", var->val & 0xFFFF
+           , var->islabel ? 'L' : 'V', XLASI_getstr(A, var->name));
+  }
+  err = ferror(map);
+  if (fclose(map) != 0 || err)
+    XLASI_asmerr("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+int
+XLASI_addlisting(XLAS *A, XLASI_Tok tok)
+{
+  XLASI_Lexer *L = A->L;
+  XLASI_Listing *ls = NULL;
+  const char *end = NULL;
+  if (A->lsnum + 1 > A->lscap) {
+    A->lscap = A->lscap ? A->lscap * 2 : 256;
+    A->lstab = XLASI_dorealloc(A->lstab, A->lscap * sizeof(A->lstab[0]));
+  }
+  ls = &A->lstab[A->lsnum];
+  end = (L->line == NULL) ? NULL
+      : memchr(L->line, '\n', L->end - L->line);
+  if (end == NULL)
+    end = (const char *)L->end;
+  ls->filename = tok.filename;
+  ls->text = (L->line == NULL) ? ""
+           : XLASI_arenadup(A, (const char *)L->line
+                           , end - (const char *)L->line);
+  ls->row = tok.row;
+  ls->addr = 0x8000 + A->outbuf->size;
+  ls->size = 0;
+  ls->cycles = -1;
+  return A->lsnum++;
+}
+
+/************************************************************/
+void
+XLASI_writelisting(XLAS *A, const char *filename)
+{
+  FILE *lst = NULL;
+  XLASI_Listing *ls = NULL;
+  const char *prev = NULL;
+  int i = 0, k = 0, err = 0;
+  lst = fopen(filename, "w");
+  if (lst == NULL)
+    XLASI_asmerr("%s: %s\n", filename, strerror(errno));
+  for (i = 0; i < A->lsnum; ++i) {
+    ls = &A->lstab[i];
+    if (ls->filename != prev)
+      fprintf(lst, "; %s\n", ls->filename);
+    prev = ls->filename;
+    fprintf(lst, "%04X ", ls->addr & 0xFFFF);
+    for (k = 0; k < 5; ++k) {
+      if (k < ls->size)
+        fprintf(lst, " %02X"
+               , XLASI_sectbyte(A->outbuf, ls->addr - 0x8000 + k));
+      else
+        fprintf(lst, "   ");
+    }
+    fprintf(lst, "%s", (ls->size > 5) ? ".." : "  ");
+    if (ls->cycles >= 0)
+      fprintf(lst, " %3i ", ls->cycles);
+    else
+      fprintf(lst, "     ");
+    fprintf(lst, "%5i  %s\n", ls->row, ls->text);
+  }
+  err = ferror(lst);
+  if (fclose(lst) != 0 || err)
+    XLASI_asmerr("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+void *
+XLASI_growarr(void *arr, int num, size_t size)
+{
+  if (num == 0)
+    return XLASI_dorealloc(arr, 8 * size);
+  if (num >= 8 && (num & (num - 1)) == 0)
+    return XLASI_dorealloc(arr, 2 * num * size);
+  return arr;
+}
+
+/************************************************************/
+void
+XLASI_taint(XLAS *A, const char *why)
+{
+  if (A->framenum > 0 && A->frametab[A->framenum - 1].why == NULL)
+    A->frametab[A->framenum - 1].why = why;
+}
+
+/************************************************************/
+void
+XLASI_notepred(XLAS *A, int name)
+{
+  XLASI_Entry *fr = NULL;
+  if (A->framenum == 0)
+    return;
+  fr = &A->frametab[A->framenum - 1];
+  fr->preds = XLASI_growarr(fr->preds, fr->prednum, sizeof(fr->preds[0]));
+  fr->preds[fr->prednum].name = name;
+  fr->preds[fr->prednum++].val = A->predval[name];
+}
+
+/************************************************************/
+void
+XLASI_hashbytes(unsigned long *key, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+  size_t i = 0;
+  /* FNV-1a and sdbm side by side */
+  for (i = 0; i < len; ++i) {
+    key[0] = ((key[0] ^ p[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    key[1] = (p[i] + (key[1] << 6) + (key[1] << 16) - key[1])
+           & 0xFFFFFFFFUL;
+  }
+}
+
+/************************************************************/
+void
+XLASI_hashint(unsigned long *key, int val)
+{
+  unsigned char buf[4];
+  buf[0] = val & 0xFF;
+  buf[1] = (val >> 8) & 0xFF;
+  buf[2] = (val >> 16) & 0xFF;
+  buf[3] = (val >> 24) & 0xFF;
+  XLASI_hashbytes(key, buf, 4);
+}
+
+/************************************************************/
+int
+XLASI_cachekey(XLAS *A, const char *filename, unsigned long *key)
+{
+  char buf[4096];
+  FILE *file = NULL;
+  const char *name = NULL;
+  size_t readn = 0;
+  int i = 0;
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+  key[0] = 2166136261UL;
+  key[1] = 0;
+  XLASI_hashbytes(key, "xlcache 1", 9);
+  while ((readn = fread(buf, 1, sizeof(buf), file)) != 0)
+    XLASI_hashbytes(key, buf, readn);
+  if (ferror(file)) {
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+  XLASI_hashint(key, 0x8000 + A->outbuf->size);
+  /* skip $, it is the origin */
+  for (i = 1; i < A->varnum; ++i) {
+    name = XLASI_getstr(A, A->vartab[i].name);
+    XLASI_hashbytes(key, name, strlen(name) + 1);
+    XLASI_hashint(key, A->vartab[i].val);
+    XLASI_hashint(key, A->vartab[i].islabel);
+    XLASI_hashint(key, A->vartab[i].isrel);
+  }
+  return 0;
+}
+
+/************************************************************/
+const char *
+XLASI_cachepath(XLAS *A, const unsigned long *key)
+{
+  A->pathbuf = XLASI_dorealloc(A->pathbuf, strlen(A->cachedir) + 32);
+  sprintf(A->pathbuf, "%s/%08lx%08lx.xlc", A->cachedir, key[0], key[1]);
+  return A->pathbuf;
+}
+
+/************************************************************/
+int
+XLASI_loadentry(XLAS *A, XLASI_Entry *ent)
+{
+  char name[1024];
+  FILE *file = NULL;
+  unsigned long k0 = 0, k1 = 0;
+  unsigned int byte = 0;
+  int i = 0, a = 0, b = 0, c = 0, d = 0;
+  file = fopen(XLASI_cachepath(A, ent->key), "r");
+  if (file == NULL)
+    return -1;
+  if (fscanf(file, "xlcache 1 key %8lx%8lx", &k0, &k1) != 2
+     || k0 != ent->key[0] || k1 != ent->key[1])
+    goto bad;
+  if (fscanf(file, " size %d", &ent->size) != 1
+     || ent->size < 0 || ent->size > A->outbuf->maxsize)
+    goto bad;
+  ent->bytes = XLASI_domalloc(ent->size + 1);
+  for (i = 0; i < ent->size; ) {
+    /* *count byte is a fill, the rest is in hex */
+    if (fscanf(file, " *%d %2x", &a, &byte) == 2) {
+      if (a < 0 || a > ent->size - i)
+        goto bad;
+      memset(ent->bytes + i, byte, a);
+      i += a;
+      continue;
+    }
+    if (fscanf(file, "%2x", &byte) != 1)
+      goto bad;
+    ent->bytes[i++] = byte;
+  }
+  if (fscanf(file, " sites %d", &ent->sitenum) != 1 || ent->sitenum < 0)
+    goto bad;
+  ent->before = XLASI_domalloc(ent->sitenum + 1);
+  ent->after = XLASI_domalloc(ent->sitenum + 1);
+  for (i = 0; i < ent->sitenum; ++i) {
+    if (fscanf(file, "%d %d", &a, &b) != 2)
+      goto bad;
+    ent->before[i] = a;
+    ent->after[i] = b;
+  }
+  if (fscanf(file, " vars %d", &ent->varnum) != 1 || ent->varnum < 0)
+    goto bad;
+  ent->vars = XLASI_domalloc((ent->varnum + 1) * sizeof(ent->vars[0]));
+  for (i = 0; i < ent->varnum; ++i) {
+    if (fscanf(file, "%1023s %d %d %d", name, &a, &b, &c) != 4)
+      goto bad;
+    ent->vars[i].name = XLASI_getsi(A, name);
+    ent->vars[i].val = a;
+    ent->vars[i].islabel = b;
+    ent->vars[i].isrel = c;
+  }
+  if (fscanf(file, " preds %d", &ent->prednum) != 1 || ent->prednum < 0)
+    goto bad;
+  ent->preds = XLASI_domalloc((ent->prednum + 1) * sizeof(ent->preds[0]));
+  for (i = 0; i < ent->prednum; ++i) {
+    if (fscanf(file, "%1023s %d", name, &a) != 2)
+      goto bad;
+    ent->preds[i].name = XLASI_getsi(A, name);
+    ent->preds[i].val = a;
+  }
+  if (fscanf(file, " refs %d", &ent->refnum) != 1 || ent->refnum < 0)
+    goto bad;
+  ent->refs = XLASI_domalloc((ent->refnum + 1) * sizeof(ent->refs[0]));
+  for (i = 0; i < ent->refnum; ++i) {
+    if (fscanf(file, "%1023s %d %d", name, &a, &b) != 3)
+      goto bad;
+    ent->refs[i].name = XLASI_getsi(A, name);
+    ent->refs[i].addr = a;
+    ent->refs[i].ismem = b;
+  }
+  if (fscanf(file, " loops %d", &ent->loopnum) != 1 || ent->loopnum < 0)
+    goto bad;
+  ent->loops = XLASI_domalloc((ent->loopnum + 1) * sizeof(ent->loops[0]));
+  for (i = 0; i < ent->loopnum; ++i) {
+    if (fscanf(file, "%d %d", &c, &d) != 2)
+      goto bad;
+    ent->loops[i].lo = c;
+    ent->loops[i].hi = d;
+  }
+  if (fscanf(file, " taken %d", &ent->takennum) != 1
+     || ent->takennum < 0)
+    goto bad;
+  ent->taken = XLASI_domalloc((ent->takennum + 1) * sizeof(ent->taken[0]));
+  for (i = 0; i < ent->takennum; ++i) {
+    if (fscanf(file, "%d", &a) != 1 || a < 0 || a >= 0x8000)
+      goto bad;
+    ent->taken[i] = a;
+  }
+  fclose(file);
+  return 0;
+bad:
+  /* a broken entry is just a miss */
+  fclose(file);
+  XLASI_freeentry(ent);
+  return -1;
+}
+
+/************************************************************/
+int
+XLASI_splicecache(XLAS *A, XLASI_Entry *ent, XLASI_Tok tok)
+{
+  XLASI_Var *var = NULL;
+  int i = 0, n = 0, state = 0, site = 0;
+  /* the same predictions and relaxation states give the same code */
+  for (i = 0; i < ent->prednum; ++i)
+    if (A->predval[ent->preds[i].name] != ent->preds[i].val)
+      return 0;
+  for (i = 0; i < ent->sitenum; ++i) {
+    state = A->sitenum + i < A->sitecap
+          ? A->sitetab[A->sitenum + i].state : 0;
+    if (state != ent->before[i])
+      return 0;
+  }
+  for (i = 0; i < ent->size; i += n) {
+    for (n = 1; i + n < ent->size && ent->bytes[i + n] == ent->bytes[i];)
+      ++n;
+    if (n >= XLASI_FILLMIN)
+      XLASI_emitbyte(A->outbuf, ent->bytes[i], n);
+    else
+      XLASI_emit(A->outbuf, ent->bytes + i, n);
+  }
+  for (i = 0; i < ent->sitenum; ++i) {
+    site = XLASI_newsite(A);
+    A->sitetab[site].state = ent->after[i];
+  }
+  for (i = 0; i < ent->varnum; ++i) {
+    var = &ent->vars[i];
+    if (XLASI_setvar(A, var->name, var->val, var->islabel, var->isrel) != 0
+       || XLASI_finddecl(A, var->name) >= 0)
+      XLASI_asmerr("%s:%i:%i: Variable or label redefinition in the include\n"
+                  , tok.filename, tok.row, tok.col);
+  }
+  A->predicted |= ent->prednum > 0;
+  for (i = 0; i < ent->refnum; ++i)
+    XLASI_addref(A, ent->refs[i].name, ent->refs[i].addr, ent->refs[i].ismem);
+  for (i = 0; i < ent->loopnum; ++i)
+    XLASI_addloop(A, ent->loops[i].lo, ent->loops[i].hi);
+  for (i = 0; i < ent->takennum; ++i)
+    XLASI_marktaken(A, ent->taken[i]);
+  A->cachehits++;
+  return 1;
+}
+
+/************************************************************/
+void
+XLASI_beginframe(XLAS *A, const char *filename, const unsigned long *key)
+{
+  XLASI_Entry *fr = NULL;
+  A->frametab = XLASI_growarr(A->frametab, A->framenum
+                             , sizeof(A->frametab[0]));
+  fr = &A->frametab[A->framenum++];
+  memset(fr, 0, sizeof(*fr));
+  fr->key[0] = key[0];
+  fr->key[1] = key[1];
+  fr->filename = filename;
+  fr->lex = A->L;
+  fr->offset = A->outbuf->size;
+  fr->site = A->sitenum;
+  fr->varnum = A->varnum;
+  fr->vars = XLASI_domalloc((A->varnum + 1) * sizeof(fr->vars[0]));
+  memcpy(fr->vars, A->vartab, A->varnum * sizeof(fr->vars[0]));
+}
+
+/************************************************************/
+void
+XLASI_endframe(XLAS *A)
+{
+  XLASI_Entry *fr = &A->frametab[--A->framenum];
+  XLASI_Var *defs = NULL, *var = NULL;
+  int i = 0, n = 0;
+  fr->lex = NULL;
+  fr->size = A->outbuf->size - fr->offset;
+  if (fr->why == NULL) {
+    /* keep only what the include defines, skip $ */
+    defs = XLASI_domalloc((A->varnum + 1) * sizeof(defs[0]));
+    for (i = 1; i < A->varnum; ++i) {
+      var = &A->vartab[i];
+      if (i < fr->varnum && var->val == fr->vars[i].val
+         && var->isrel == fr->vars[i].isrel)
+        continue;
+      defs[n++] = *var;
+    }
+    free(fr->vars);
+    fr->vars = defs;
+    fr->varnum = n;
+    assert(fr->sitenum == A->sitenum - fr->site);
+    fr->after = XLASI_domalloc(fr->sitenum + 1);
+    for (i = 0; i < fr->sitenum; ++i)
+      fr->after[i] = A->sitetab[fr->site + i].state;
+  }
+  A->donetab = XLASI_growarr(A->donetab, A->donenum, sizeof(A->donetab[0]));
+  A->donetab[A->donenum++] = *fr;
+}
+
+/************************************************************/
+void
+XLASI_freeentry(XLASI_Entry *ent)
+{
+  free(ent->bytes);
+  free(ent->before);
+  free(ent->after);
+  free(ent->vars);
+  free(ent->preds);
+  free(ent->refs);
+  free(ent->loops);
+  free(ent->taken);
+  memset(ent, 0, sizeof(*ent));
+}
+
+/************************************************************/
+void
+XLASI_writecache(XLAS *A, const char *filename)
+{
+  char *tmp = NULL;
+  const char *path = NULL;
+  FILE *file = NULL;
+  XLASI_Entry *ent = NULL;
+  int i = 0, k = 0, n = 0, col = 0, byte = 0, stored = 0, skipped = 0;
+  int err = 0;
+  for (i = 0; i < A->donenum; ++i) {
+    ent = &A->donetab[i];
+    if (ent->why != NULL) {
+      fprintf(A->cacheout, "xlas: -C: %s: %s is not cached, it %s\n"
+             , filename, ent->filename, ent->why);
+      skipped++;
+      continue;
+    }
+    /* write aside and rename, other builds may read it */
+    path = XLASI_cachepath(A, ent->key);
+    tmp = XLASI_dorealloc(tmp, strlen(path) + 32);
+    sprintf(tmp, "%s.%ld.%i", path, (long)getpid(), A->id);
+    file = fopen(tmp, "w");
+    if (file == NULL) {
+      free(tmp);
+      XLASI_asmerr("%s: %s\n", path, strerror(errno));
+    }
+    fprintf(file, "xlcache 1 key %08lx%08lx\n", ent->key[0], ent->key[1]);
+    fprintf(file, "size %i\n", ent->size);
+    for (k = 0, col = 0; k < ent->size; k += n) {
+      byte = XLASI_sectbyte(A->outbuf, ent->offset + k);
+      for (n = 1; k + n < ent->size
+          && XLASI_sectbyte(A->outbuf, ent->offset + k + n) == byte; )
+        ++n;
+      if (n >= XLASI_FILLMIN) {
+        fprintf(file, "%s*%i %02X\n", col ? "\n" : "", n, byte);
+        col = 0;
+        continue;
+      }
+      n = 1;
+      fprintf(file, "%02X", byte);
+      if (++col == 32 || k + 1 == ent->size) {
+        fprintf(file, "\n");
+        col = 0;
+      }
+    }
+    fprintf(file, "sites %i\n", ent->sitenum);
+    for (k = 0; k < ent->sitenum; ++k)
+      fprintf(file, "%i %i\n", ent->before[k], ent->after[k]);
+    fprintf(file, "vars %i\n", ent->varnum);
+    for (k = 0; k < ent->varnum; ++k)
+      fprintf(file, "%s %i %i %i\n", XLASI_getstr(A, ent->vars[k].name)
+             , ent->vars[k].val, ent->vars[k].islabel
+             , ent->vars[k].isrel);
+    fprintf(file, "preds %i\n", ent->prednum);
+    for (k = 0; k < ent->prednum; ++k)
+      fprintf(file, "%s %i\n", XLASI_getstr(A, ent->preds[k].name)
+             , ent->preds[k].val);
+    fprintf(file, "refs %i\n", ent->refnum);
+    for (k = 0; k < ent->refnum; ++k)
+      fprintf(file, "%s %i %i\n", XLASI_getstr(A, ent->refs[k].name)
+             , ent->refs[k].addr, ent->refs[k].ismem);
+    fprintf(file, "loops %i\n", ent->loopnum);
+    for (k = 0; k < ent->loopnum; ++k)
+      fprintf(file, "%i %i\n", ent->loops[k].lo, ent->loops[k].hi);
+    fprintf(file, "taken %i\n", ent->takennum);
+    for (k = 0; k < ent->takennum; ++k)
+      fprintf(file, "%i\n", ent->taken[k]);
+    err = ferror(file);
+    if (fclose(file) != 0 || err || rename(tmp, path) != 0) {
+      remove(tmp);
+      free(tmp);
+      XLASI_asmerr("%s: Cannot write the cache\n", path);
+    }
+    stored++;
+  }
+  free(tmp);
+  fprintf(A->cacheout, "xlas: -C: %s: %i hits, %i stored, %i not cached\n"
+         , filename, A->cachehits, stored, skipped);
+}
+
+/************************************************************/
+void
+XLASI_planpatch(XLAS *A, int offset, int label, int isrel, int size
+               , XLASI_Tok tok)
+{
+  XLASI_Backpatch *bp = NULL;
+  if (A->bpnum + 1 > A->bpcap) {
+    A->bpcap *= 2;
+    A->bptab = XLASI_dorealloc(A->bptab, A->bpcap * sizeof(A->bptab[0]));
+  }
+  bp = &A->bptab[A->bpnum];
+  ++A->bpnum;
+  bp->offset = offset;
+  bp->label = label;
+  bp->isrel = isrel;
+  bp->size = size;
+  bp->tok = tok;
+}
+
+/************************************************************/
+int
+XLASI_findvar(XLAS *A, int name)
+{
+  if (name < 0 || name >= A->strnum)
+    return -1;
+  return A->varidx[name] - 1;
+}
+
+/************************************************************/
+int
+XLASI_setvar(XLAS *A, int name, int val, int islabel, int isrel)
+{
+  XLASI_Var *var = NULL;
+  int vi = XLASI_findvar(A, name);
+  if (vi >= 0) {
+    var = &A->vartab[vi];
+    if (var->islabel || islabel)
+      return 1;
+    var->val = val;
+    var->isrel = isrel;
+    return 0;
+  }
+  if (A->varnum + 1 > A->varcap) {
+    A->varcap *= 2;
+    A->vartab = XLASI_dorealloc(A->vartab, A->varcap * sizeof(A->vartab[0]));
+  }
+  var = &A->vartab[A->varnum];
+  ++A->varnum;
+  A->varidx[name] = A->varnum;
+  var->name = name;
+  var->val = val;
+  var->islabel = islabel;
+  var->isrel = isrel;
+  return 0;
+}
+
+/************************************************************/
+void
+XLASI_readinst(XLAS *A, int inst)
+{
+  XLASI_Tok tok = A->curtok, labtok;
+  char hint[256];
+  int mtype = Mnam, t = 0, i = 0, m = 0, val = 0, len = 0;
+  int label = 0, sz = 0, rel = 0, addr = 0, site = 0, known = 1;
+  int name = 0, ntok = 0, wmode = Mnam, vrel = 0, ismem = 0;
+  XLASI_Site *st = NULL;
+  A->linecycles = 0;
+  site = XLASI_newsite(A);
+  t = XLASI_readtok(A);
+        /**/ if (t == XLASI_Tnewline || t == XLASI_Teof) {
+    mtype = Mnam;
+    goto match;
+  }
+  else if (t == XLASI_Tsharp) {
+    mtype = Mimm;
+    XLASI_readtok(A);
+  }
+  else if (t == Tx || t == Ty) {
+    mtype = (t == Tx) ? Mabx : Maby;
+    XLASI_readtok(A);
+    if (A->curtok.type == XLASI_Tmult) {
+      mtype = (t == Tx) ? Mzvx : Mzyv;
+      XLASI_readtok(A);
+    }
+  }
+  else if (t == XLASI_Tmult) {
+    mtype = Mvec;
+    XLASI_readtok(A);
+  }
+  else if (t == XLASI_Tqnor) {
+    mtype = Mrel;
+    XLASI_readtok(A);
+  }
+  else {
+    mtype = Mabs;
+  }
+  if (A->curtok.type == XLASI_Tnewline || A->curtok.type == XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: No arument in the instruction\n"
+                , tok.filename, tok.row, tok.col);
+  st = &A->sitetab[site];
+  labtok = A->curtok;
+  if (A->curtok.type > Ty && XLASI_findvar(A, A->curtok.type) < 0
+     && XLASI_finddecl(A, A->curtok.type) < 0) {
+    name = A->curtok.type;
+    XLASI_readtok(A);
+  }
+  else {
+    name = (A->curtok.type > Ty) ? A->curtok.type : 0;
+    ntok = A->tokcount;
+    val = XLASI_evalexpr(A);
+    vrel = A->exprrel;
+    known = !A->exprpending;
+    if (A->tokcount != ntok + 1)
+      name = 0;
+  }
+  if (inst == Tcal && mtype == Mabs && name != 0
+     && XLASI_findmacro(A, name) >= 0
+     && A->mactab[XLASI_findmacro(A, name)].kind == XLASI_Kinline
+     && (A->curtok.type == XLASI_Tnewline || A->curtok.type == XLASI_Teof)) {
+    /* the body replaces the call */
+    XLASI_expand(A, XLASI_findmacro(A, name), NULL, NULL, 1);
+    return;
+  }
+  if (st->opt == XLASI_Othread && XLASI_findvar(A, st->target) >= 0) {
+    name = st->target;
+    val = A->vartab[XLASI_findvar(A, name)].val;
+    vrel = A->vartab[XLASI_findvar(A, name)].isrel;
+  }
+  else if (st->opt == XLASI_Othread) {
+    name = st->target;
+  }
+  if (name != 0 && XLASI_findvar(A, name) < 0) {
+    /* predict the forward name with its value in the previous pass,
+       names without one are imported from other objects */
+    label = name;
+    val = A->predval[label];
+    known = val >= 0;
+    XLASI_notepred(A, label);
+    A->guessed |= !known && A->passnum == 1;
+    A->predicted |= known;
+  }
+  if (A->passnum == 1 || A->framenum > 0) {
+    /* what the var allocation needs to know */
+    ismem = mtype != Mimm && mtype != Mrel;
+    if (label != 0 && XLASI_finddecl(A, label) < 0)
+      XLASI_addref(A, label, 0x8000 + A->outbuf->size, ismem);
+    if (label == 0 && ismem && known && val < 0x8000)
+      XLASI_marktaken(A, val);
+    if (label == 0 && known && (mtype == Mvec || mtype == Mzvx
+       || mtype == Mzyv) && val + 1 < 0x8000)
+      XLASI_marktaken(A, val + 1);
+    if ((inst == Tjmp || (Tjfb <= inst && inst <= Tjtz)) && label == 0
+       && name != 0 && A->vartab[XLASI_findvar(A, name)].islabel
+       && val <= 0x8000 + A->outbuf->size)
+      XLASI_addloop(A, val, 0x8000 + A->outbuf->size);
+  }
+  sz = (known && val <= 255) ? 1 : 2;
+  if (label != 0 && mtype != Mrel && known) {
+    /* take the zero page only if there is such an opcode */
+    m = (mtype == Mabx) ? Mzpx : (mtype == Maby) ? Mzpy : Mzpg;
+    if (mtype == Mabs || mtype == Mabx || mtype == Maby)
+      sz = XLASI_settle(A, site, sz == 2
+                                 || XL_opcodes[inst][m] == XL_NO_OPCODE)
+         ? 2 : 1;
+  }
+  wmode = mtype;
+  if (mtype == Mabx && sz == 1)
+    mtype = Mzpx;
+  if (mtype == Maby && sz == 1)
+    mtype = Mzpy;
+  if (mtype == Mabs && sz == 1)
+    mtype = Mzpg;
+match:
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  i = XL_opcodes[inst][mtype];
+  if (i == XL_NO_OPCODE) {
+    for (m = 0; m < Mcount; ++m) {
+      if (!(XL_instmodes[inst] & (1u << m)))
+        continue;
+      /* zpg looks just like abs */
+      if (m == Mzpg || m == Mzpx || m == Mzpy)
+        continue;
+      len += sprintf(hint + len, "%s%s%s%s", len ? ", " : ""
+                    , XL_keywords[inst], XL_msignatures[m]
+                    , m == Mnam ? "" : "n");
+    }
+    XLASI_asmerr("%s:%i:%i: Unknown instruction pattern\n"
+                 "Did you mean %s?\n"
+                , tok.filename, tok.row, tok.col, hint);
+  }
+  st = &A->sitetab[site];
+  XLASI_pushir(A, XLASI_Iinst, site, inst, wmode, i, name, known ? val : -1);
+  A->optnum[st->opt]++;
+  if (st->opt == XLASI_Oload || st->opt == XLASI_Otransfer
+     || st->opt == XLASI_Onext || st->opt == XLASI_Oret) {
+    A->optbytes += XL_modesizes[mtype];
+    A->optcycles += XL_opcycles(i);
+    return;
+  }
+  if (st->opt == XLASI_Otail) {
+    A->optcycles += XL_opcycles(i);
+    i = XL_opcodes[Tjmp][mtype];
+    A->optcycles -= XL_opcycles(i);
+  }
+  if (st->opt == XLASI_Othread)
+    A->optcycles += st->saved;
+  if (mtype == Mnam) {
+    XLASI_emitbyte(A->outbuf, i, 1);
+    A->linecycles += XL_opcycles(i);
+    return;
+  }
+  if (mtype == Mimm) {
+    XLASI_checkabs(A, vrel, tok);
+    XLASI_emitbyte(A->outbuf, i, 1);
+    A->linecycles += XL_opcycles(i);
+    if (label != 0 && !known)
+      XLASI_planpatch(A, A->outbuf->size, label, 0, 1, labtok);
+    XLASI_emitbyte(A->outbuf, val, 1);
+    return;
+  }
+  if (mtype == Mrel) {
+    if (A->objmode && label == 0 && !vrel)
+      XLASI_asmerr("%s:%i:%i: The jump target does not move with the object\n"
+                  , tok.filename, tok.row, tok.col);
+    addr = 0x8000 + A->outbuf->size;
+    rel = val - addr;
+    if (known && XLASI_settle(A, site, rel > 127 || rel < -128)) {
+      /* jtz ~far -> jfz ~next, jmp far, next: */
+      if (inst != Tjmp) {
+        XLASI_emitbyte(A->outbuf, XL_opcodes[XLASI_invbranch(inst)][Mrel], 1);
+        XLASI_emitbyte(A->outbuf, 2 + XL_modesizes[Mabs], 1);
+        A->linecycles += XL_opcycles(XL_opcodes[XLASI_invbranch(inst)][Mrel]);
+      }
+      i = XL_opcodes[Tjmp][Mabs];
+      mtype = Mabs;
+    }
+  }
+  XLASI_emitbyte(A->outbuf, i, 1);
+  A->linecycles += XL_opcycles(i);
+  sz = (mtype == Mrel) ? 1 : XL_modesizes[mtype] - 1;
+  if (label != 0) {
+    XLASI_planpatch(A, A->outbuf->size, label, mtype == Mrel, sz, labtok);
+    XLASI_emitbyte(A->outbuf, 0, sz);
+  }
+  else if (mtype == Mrel) {
+    XLASI_emitbyte(A->outbuf, rel, 1);
+  }
+  else {
+    if (sz == 1) XLASI_checkabs(A, vrel, tok);
+    if (sz == 1) XLASI_emitbyte(A->outbuf, val, 1);
+    if (sz == 2) XLASI_emitle16(A->outbuf, val);
+    if (sz == 2 && vrel)
+      XLASI_addreloc(A, A->outbuf->size - 2, XL_RELOC_ABS16, -1);
+  }
+}
+
+/************************************************************/
+void
+XLASI_dolet(XLAS *A)
+{
+  XLASI_Tok tok = A->curtok;
+  int val = 0, name = 0, t = 0;
+  name = XLASI_readtok(A);
+  if (name <= Ty)
+    XLASI_asmerr("%s:%i:%i: The let requires a name\n"
+                , tok.filename, tok.row, tok.col);
+  if (XLASI_finddecl(A, name) >= 0)
+    XLASI_asmerr("%s:%i:%i: Variable or label redefinition\n"
+                , tok.filename, tok.row, tok.col);
+  t = XLASI_readtok(A);
+  if (t == XLASI_Tnewline || t == XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: The let requires an expression\n"
+                , tok.filename, tok.row, tok.col);
+  val = XLASI_evalexpr(A);
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_readtok(A);
+  if (XLASI_setvar(A, name, val, 0, A->exprrel) != 0)
+    XLASI_asmerr("%s:%i:%i: Label redefinition\n"
+                , tok.filename, tok.row, tok.col);
+}
+
+/************************************************************/
+void
+XLASI_dovar(XLAS *A)
+{
+  XLASI_Tok tok = A->curtok;
+  XLASI_Decl *decl = NULL;
+  int name = 0, size = 1, di = 0;
+  if (A->objmode)
+    XLASI_asmerr("%s:%i:%i: The var needs the whole program, use let\n"
+                , tok.filename, tok.row, tok.col);
+  XLASI_taint(A, "declares a var");
+  name = XLASI_readtok(A);
+  if (name <= Ty)
+    XLASI_asmerr("%s:%i:%i: The var requires a name\n"
+                , tok.filename, tok.row, tok.col);
+  if (XLASI_readtok(A) == XLASI_Tcomma) {
+    XLASI_readtok(A);
+    if (A->curtok.type == XLASI_Tnewline || A->curtok.type == XLASI_Teof)
+      XLASI_asmerr("%s:%i:%i: The var requires a size after the comma\n"
+                  , tok.filename, tok.row, tok.col);
+    size = XLASI_evalexpr(A);
+    if (A->exprpending || size < 1 || size > 0x7DFF)
+      XLASI_asmerr("%s:%i:%i: Invalid var size\n"
+                  , tok.filename, tok.row, tok.col);
+  }
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_readtok(A);
+  di = XLASI_finddecl(A, name);
+  if (di < 0) {
+    if (XLASI_findvar(A, name) >= 0)
+      XLASI_asmerr("%s:%i:%i: Variable or label redefinition\n"
+                  , tok.filename, tok.row, tok.col);
+    if (A->declnum + 1 > A->declcap) {
+      A->declcap = A->declcap ? A->declcap * 2 : 16;
+      A->decltab = XLASI_dorealloc(A->decltab
+                                  , A->declcap * sizeof(A->decltab[0]));
+    }
+    di = A->declnum++;
+    A->declidx[name] = A->declnum;
+    decl = &A->decltab[di];
+    decl->tok = tok;
+    decl->name = name;
+    decl->size = size;
+    decl->addr = -1;
+    decl->order = di;
+    decl->pass = 0;
+    decl->weight = 0;
+  }
+  decl = &A->decltab[di];
+  if (decl->pass == A->passnum)
+    XLASI_asmerr("%s:%i:%i: Variable or label redefinition\n"
+                , tok.filename, tok.row, tok.col);
+  decl->pass = A->passnum;
+  A->guessed |= decl->addr < 0;
+  if (decl->addr >= 0 && XLASI_setvar(A, name, decl->addr, 0, 0) != 0)
+    XLASI_asmerr("%s:%i:%i: Variable or label redefinition\n"
+                , tok.filename, tok.row, tok.col);
+}
+
+/************************************************************/
+int
+XLASI_finddecl(XLAS *A, int name)
+{
+  if (name < 0 || name >= A->strnum)
+    return -1;
+  return A->declidx[name] - 1;
+}
+
+/************************************************************/
+void
+XLASI_addref(XLAS *A, int name, int addr, int ismem)
+{
+  XLASI_Ref *ref = NULL;
+  XLASI_Entry *fr = NULL;
+  if (A->framenum > 0) {
+    fr = &A->frametab[A->framenum - 1];
+    fr->refs = XLASI_growarr(fr->refs, fr->refnum, sizeof(fr->refs[0]));
+    ref = &fr->refs[fr->refnum++];
+    ref->name = name;
+    ref->addr = addr;
+    ref->ismem = ismem;
+  }
+  if (A->passnum != 1)
+    return;
+  if (A->refnum + 1 > A->refcap) {
+    A->refcap = A->refcap ? A->refcap * 2 : 256;
+    A->reftab = XLASI_dorealloc(A->reftab, A->refcap * sizeof(A->reftab[0]));
+  }
+  ref = &A->reftab[A->refnum++];
+  ref->name = name;
+  ref->addr = addr;
+  ref->ismem = ismem;
+}
+
+/************************************************************/
+void
+XLASI_marktaken(XLAS *A, int addr)
+{
+  XLASI_Entry *fr = NULL;
+  if (A->framenum > 0) {
+    fr = &A->frametab[A->framenum - 1];
+    fr->taken = XLASI_growarr(fr->taken, fr->takennum, sizeof(fr->taken[0]));
+    fr->taken[fr->takennum++] = addr;
+  }
+  if (A->passnum == 1)
+    A->taken[addr >> 3] |= 1 << (addr & 7);
+}
+
+/************************************************************/
+void
+XLASI_addloop(XLAS *A, int lo, int hi)
+{
+  XLASI_Entry *fr = NULL;
+  if (A->framenum > 0) {
+    fr = &A->frametab[A->framenum - 1];
+    fr->loops = XLASI_growarr(fr->loops, fr->loopnum, sizeof(fr->loops[0]));
+    fr->loops[fr->loopnum].lo = lo;
+    fr->loops[fr->loopnum++].hi = hi;
+  }
+  if (A->passnum != 1)
+    return;
+  if (A->loopnum + 1 > A->loopcap) {
+    A->loopcap = A->loopcap ? A->loopcap * 2 : 64;
+    A->looptab = XLASI_dorealloc(A->looptab
+                                , A->loopcap * sizeof(A->looptab[0]));
+  }
+  A->looptab[A->loopnum].lo = lo;
+  A->looptab[A->loopnum].hi = hi;
+  ++A->loopnum;
+}
+
+/************************************************************/
+void
+XLASI_allocvars(XLAS *A)
+{
+  XLASI_Decl **order = NULL;
+  XLASI_Decl *decl = NULL;
+  XLASI_Ref *ref = NULL;
+  int *starts = NULL;
+  int i = 0, j = 0, k = 0, vi = 0, di = 0, depth = 0, addr = 0;
+  if (A->declnum == 0)
+    return;
+  /* forward lets used as memory operands keep their bytes too */
+  for (i = 0; i < A->refnum; ++i) {
+    ref = &A->reftab[i];
+    vi = XLASI_findvar(A, ref->name);
+    if (!ref->ismem || vi < 0 || A->vartab[vi].islabel)
+      continue;
+    addr = A->vartab[vi].val;
+    if (addr >= 0 && addr < 0x8000)
+      A->taken[addr >> 3] |= 1 << (addr & 7);
+  }
+  /* the loop depth of an address is the number of backward jumps
+     over it, the references come in the order of addresses */
+  starts = XLASI_domalloc((A->loopnum + 1) * sizeof(starts[0]));
+  for (i = 0; i < A->loopnum; ++i)
+    starts[i] = A->looptab[i].lo;
+  qsort(starts, A->loopnum, sizeof(starts[0]), XLASI_cmpint);
+  for (i = 0; i < A->refnum; ++i) {
+    ref = &A->reftab[i];
+    while (j < A->loopnum && starts[j] <= ref->addr)
+      ++j;
+    while (k < A->loopnum && A->looptab[k].hi < ref->addr)
+      ++k;
+    di = XLASI_finddecl(A, ref->name);
+    if (di < 0)
+      continue;
+    depth = (j - k < 6) ? j - k : 6;
+    A->decltab[di].weight += (double)(1L << (3 * depth));
+  }
+  free(starts);
+  order = XLASI_domalloc(A->declnum * sizeof(order[0]));
+  for (i = 0; i < A->declnum; ++i)
+    order[i] = &A->decltab[i];
+  qsort(order, A->declnum, sizeof(order[0]), XLASI_cmpdecl);
+  for (i = 0; i < A->declnum; ++i) {
+    decl = order[i];
+    /* the zero page without the I/O port, then the RAM after
+       the stack without the exit port */
+    addr = XLASI_findfree(A, 0x00, 0xFF, decl->size);
+    if (addr < 0)
+      addr = XLASI_findfree(A, 0x200, 0x7FFF, decl->size);
+    if (addr < 0)
+      XLASI_asmerr("%s:%i:%i: No free RAM for the var\n"
+                  , decl->tok.filename, decl->tok.row, decl->tok.col);
+    for (j = addr; j < addr + decl->size; ++j)
+      A->taken[j >> 3] |= 1 << (j & 7);
+    decl->addr = addr;
+    A->predval[decl->name] = addr;
+  }
+  free(order);
+  free(A->reftab);
+  free(A->looptab);
+  A->reftab = NULL;
+  A->looptab = NULL;
+  A->refnum = A->refcap = A->loopnum = A->loopcap = 0;
+}
+
+/************************************************************/
+int
+XLASI_findfree(XLAS *A, int lo, int hi, int size)
+{
+  int addr = lo, i = 0;
+  while (addr + size <= hi) {
+    for (i = 0; i < size; ++i)
+      if (A->taken[(addr + i) >> 3] & (1 << ((addr + i) & 7)))
+        break;
+    if (i == size)
+      return addr;
+    addr += i + 1;
+  }
+  return -1;
+}
+
+/************************************************************/
+int
+XLASI_cmpdecl(const void *a, const void *b)
+{
+  const XLASI_Decl *x = *(const XLASI_Decl *const *)a;
+  const XLASI_Decl *y = *(const XLASI_Decl *const *)b;
+  double wx = x->weight / x->size, wy = y->weight / y->size;
+  if (wx != wy)
+    return (wx > wy) ? -1 : 1;
+  return x->order - y->order;
+}
+
+/************************************************************/
+int
+XLASI_cmpint(const void *a, const void *b)
+{
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+/************************************************************/
+void
+XLASI_dorb(XLAS *A)
+{
+  XLASI_Tok tok = A->curtok;
+  int n = 0, t = 0;
+  t = XLASI_readtok(A);
+  if (t == XLASI_Tnewline || t == XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: The rb requires an expression\n"
+                , tok.filename, tok.row, tok.col);
+  n = XLASI_evalexpr(A);
+  XLASI_checkabs(A, A->exprrel, tok);
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_readtok(A);
+  XLASI_emitbyte(A->outbuf, 0, n);
+}
+
+/************************************************************/
+void
+XLASI_defvals(XLAS *A, int iswords)
+{
+  XLASI_Tok tok = A->curtok;
+  void(*emitmethod)(XLASI_Sect *, int);
+  const char *ref = (iswords) ? "dw" : "db";
+  const char *str = NULL;
+  int t = 0;
+  emitmethod = (iswords) ? XLASI_emit16method : XLASI_emit8method;
+  for (;;) {
+    t = XLASI_readtok(A);
+    if (t == XLASI_Tnewline || t == XLASI_Teof)
+      XLASI_asmerr("%s:%i:%i: The %s requires an expression\n"
+                  , tok.filename, tok.row, tok.col, ref);
+    /**/ if (t == XLASI_Tstrlit) {
+      str = XLASI_getstr(A, A->curtok.strlit);
+      XLASI_emit(A->outbuf, str, strlen(str));
+      XLASI_readtok(A);
+    }
+    else if (t > Ty && XLASI_findvar(A, t) < 0) {
+      XLASI_notepred(A, A->curtok.type);
+      XLASI_planpatch(A, A->outbuf->size, A->curtok.type, 0, 2, A->curtok);
+      XLASI_emitle16(A->outbuf, 0);
+      XLASI_readtok(A);
+    }
+    else {
+      tok = A->curtok;
+      emitmethod(A->outbuf, XLASI_evalexpr(A));
+      if (!iswords)
+        XLASI_checkabs(A, A->exprrel, tok);
+      if (A->exprrel)
+        XLASI_addreloc(A, A->outbuf->size - 2, XL_RELOC_ABS16, -1);
+    }
+    if (A->curtok.type == XLASI_Tnewline || A->curtok.type == XLASI_Teof)
+      break;
+    if (A->curtok.type != XLASI_Tcomma)
+      XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+    tok = A->curtok;
+  }
+  XLASI_readtok(A);
+}
+
+/************************************************************/
+void
+XLASI_doinclude(XLAS *A)
+{
+  XLASI_Tok tok;
+  XLASI_Entry *ent = &A->hit;
+  unsigned long key[2];
+  const char *filename = NULL;
+  tok = A->curtok;
+  if (XLASI_readtok(A) != XLASI_Tstrlit)
+    XLASI_asmerr("%s:%i:%i: The include requires a filename string\n"
+                , tok.filename, tok.row, tok.col);
+  filename = XLASI_getstr(A, A->curtok.strlit);
+  XLASI_readtok(A);
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  /* the next line comes from the file */
+  A->curtok.type = XLASI_Tnewline;
+  XLASI_taint(A, "includes another file");
+  if (A->cachedir != NULL && XLASI_cachekey(A, filename, key) == 0) {
+    /* left by an error in a previous splice */
+    XLASI_freeentry(ent);
+    ent->key[0] = key[0];
+    ent->key[1] = key[1];
+    if (XLASI_loadentry(A, ent) == 0 && XLASI_splicecache(A, ent, tok)) {
+      XLASI_freeentry(ent);
+      return;
+    }
+    XLASI_freeentry(ent);
+    A->L = XLASI_newlex(A, filename, A->L);
+    XLASI_beginframe(A, filename, key);
+    return;
+  }
+  A->L = XLASI_newlex(A, filename, A->L);
+}
+
+/************************************************************/
+void
+XLASI_doincbin(XLAS *A)
+{
+  char buf[1024];
+  struct stat st;
+  XLASI_Tok tok;
+  const char *filename = NULL;
+  void *data = NULL;
+  ssize_t readn = 0;
+  int fd = -1;
+  tok = A->curtok;
+  if (XLASI_readtok(A) != XLASI_Tstrlit)
+    XLASI_asmerr("%s:%i:%i: The incbin requires a filename string\n"
+                , tok.filename, tok.row, tok.col);
+  filename = XLASI_getstr(A, A->curtok.strlit);
+  XLASI_readtok(A);
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_readtok(A);
+  XLASI_taint(A, "uses incbin");
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    XLASI_asmerr("%s:%i:%i: incbin: %s: %s\n", tok.filename, tok.row
+                , tok.col, filename, strerror(errno));
+  /* XLASI_asmerr does not return, so close the file before every one */
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    XLASI_asmerr("%s:%i:%i: incbin: %s: %s\n", tok.filename, tok.row
+                , tok.col, filename, strerror(errno));
+  }
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+    /* the section points into the file */
+    if (st.st_size > A->outbuf->maxsize - A->outbuf->size) {
+      close(fd);
+      XLASI_asmerr("%s:%i:%i: incbin: %s: Too much bytes in the program\n"
+                  , tok.filename, tok.row, tok.col, filename);
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      XLASI_asmerr("%s:%i:%i: incbin: %s: %s\n", tok.filename, tok.row
+                  , tok.col, filename, strerror(errno));
+    }
+    XLASI_emitmapped(A->outbuf, data, (int)st.st_size);
+  }
+  else {
+    while ((readn = read(fd, buf, sizeof(buf))) > 0) {
+      if (readn > A->outbuf->maxsize - A->outbuf->size) {
+        close(fd);
+        XLASI_asmerr("%s:%i:%i: incbin: %s: Too much bytes in the program\n"
+                    , tok.filename, tok.row, tok.col, filename);
+      }
+      XLASI_emit(A->outbuf, buf, (int)readn);
+    }
+    if (readn < 0) {
+      close(fd);
+      XLASI_asmerr("%s:%i:%i: incbin: %s: %s\n", tok.filename, tok.row
+                  , tok.col, filename, "Cannot read the file");
+    }
+  }
+  close(fd);
+}
+
+/************************************************************/
+void
+XLASI_domacro(XLAS *A, int kind)
+{
+  XLASI_Tok tok = A->curtok;
+  XLASI_Macro *mac = NULL;
+  int name = 0, mi = 0;
+  XLASI_taint(A, "defines a macro");
+  name = XLASI_readtok(A);
+  if (name <= Ty)
+    XLASI_asmerr("%s:%i:%i: The %s requires a name\n"
+                , tok.filename, tok.row, tok.col, XL_keywords[tok.type]);
+  if (XLASI_findvar(A, name) >= 0 || XLASI_finddecl(A, name) >= 0)
+    XLASI_asmerr("%s:%i:%i: The name is already a variable or a label\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  mi = XLASI_findmacro(A, name);
+  if (mi >= 0 && A->mactab[mi].pass == A->passnum)
+    XLASI_asmerr("%s:%i:%i: Macro redefinition\n"
+                , tok.filename, tok.row, tok.col);
+  if (mi < 0) {
+    if (A->macnum + 1 > A->maccap) {
+      A->maccap = A->maccap ? A->maccap * 2 : 64;
+      A->mactab = XLASI_dorealloc(A->mactab
+                                 , A->maccap * sizeof(A->mactab[0]));
+    }
+    mi = A->macnum++;
+    memset(&A->mactab[mi], 0, sizeof(A->mactab[mi]));
+    A->macidx[name] = mi + 1;
+  }
+  mac = &A->mactab[mi];
+  mac->tok = tok;
+  mac->name = name;
+  mac->kind = kind;
+  mac->pass = A->passnum;
+  mac->paramnum = 0;
+  XLASI_readtok(A);
+  while (kind == XLASI_Kmacro && A->curtok.type > Ty) {
+    mac->params = XLASI_dorealloc(mac->params
+                                 , (mac->paramnum + 1) * sizeof(int));
+    mac->params[mac->paramnum++] = A->curtok.type;
+    if (XLASI_readtok(A) != XLASI_Tcomma)
+      break;
+    if (XLASI_readtok(A) <= Ty)
+      XLASI_asmerr("%s:%i:%i: Expected a parameter name\n"
+                  , A->curtok.filename, A->curtok.row, A->curtok.col);
+  }
+  if (A->curtok.type != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_recordbody(A, mi, Tendm);
+}
+
+/************************************************************/
+void
+XLASI_dorept(XLAS *A)
+{
+  XLASI_Tok tok = A->curtok;
+  XLASI_Macro *mac = NULL;
+  int count = 0, mi = 0;
+  XLASI_readtok(A);
+  if (A->curtok.type == XLASI_Tnewline || A->curtok.type == XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: The rept requires a count\n"
+                , tok.filename, tok.row, tok.col);
+  count = XLASI_evalexpr(A);
+  if (A->exprpending || A->exprrel || count > 0x8000)
+    XLASI_asmerr("%s:%i:%i: The count must be known and at most 32768\n"
+                , tok.filename, tok.row, tok.col);
+  /* a rept is known by its place */
+  for (mi = 0; mi < A->macnum; ++mi) {
+    mac = &A->mactab[mi];
+    if (mac->kind == XLASI_Krept && mac->tok.filename == tok.filename
+       && mac->tok.row == tok.row && mac->tok.col == tok.col)
+      break;
+  }
+  if (mi == A->macnum) {
+    if (A->macnum + 1 > A->maccap) {
+      A->maccap = A->maccap ? A->maccap * 2 : 64;
+      A->mactab = XLASI_dorealloc(A->mactab
+                                 , A->maccap * sizeof(A->mactab[0]));
+    }
+    A->macnum++;
+    memset(&A->mactab[mi], 0, sizeof(A->mactab[mi]));
+  }
+  mac = &A->mactab[mi];
+  mac->tok = tok;
+  mac->kind = XLASI_Krept;
+  mac->pass = A->passnum;
+  XLASI_recordbody(A, mi, Tendr);
+  XLASI_expand(A, mi, NULL, NULL, count);
+}
+
+/************************************************************/
+void
+XLASI_recordbody(XLAS *A, int mi, int endtype)
+{
+  XLASI_Macro *mac = &A->mactab[mi];
+  XLASI_Mtok *mt = NULL;
+  const char *line = NULL;
+  int t = 0, atstart = 1, depth = 0, cand = 0, i = 0, last = -1;
+  int cap = 0;
+  mac->toknum = 0;
+  mac->localnum = 0;
+  for (;;) {
+    t = XLASI_readtok(A);
+    if (t == XLASI_Teof)
+      XLASI_asmerr("%s:%i:%i: No %s for the %s\n", mac->tok.filename
+                  , mac->tok.row, mac->tok.col, XL_keywords[endtype]
+                  , XL_keywords[mac->tok.type]);
+    if (atstart && t == endtype && depth == 0)
+      break;
+    if (atstart && (t == Tmacro || t == Tinline))
+      XLASI_asmerr("%s:%i:%i: A %s cannot be defined inside another one\n"
+                  , A->curtok.filename, A->curtok.row, A->curtok.col
+                  , XL_keywords[t]);
+    if (atstart && t == Trept)
+      ++depth;
+    if (atstart && t == Tendr)
+      --depth;
+    if (atstart && t != XLASI_Tnewline)
+      last = mac->toknum;
+    if (atstart)
+      line = (A->listname != NULL) ? XLASI_linetext(A) : NULL;
+    if (t == XLASI_Tcolon && cand != 0) {
+      /* a label of the body, unless the rept inside repeats it */
+      for (i = 0; i < mac->localnum && mac->locals[i] != cand; ++i);
+      if (i == mac->localnum) {
+        mac->locals = XLASI_dorealloc(mac->locals
+                                     , (mac->localnum + 1) * sizeof(int));
+        mac->locals[mac->localnum++] = cand;
+      }
+    }
+    cand = (atstart && t > Ty && depth == 0) ? t : 0;
+    if (mac->toknum + 1 > cap) {
+      cap = cap ? cap * 2 : 64;
+      mac->toks = XLASI_dorealloc(mac->toks, cap * sizeof(mac->toks[0]));
+    }
+    mt = &mac->toks[mac->toknum++];
+    mt->tok = A->curtok;
+    mt->line = line;
+    atstart = t == XLASI_Tnewline;
+  }
+  if (XLASI_readtok(A) != XLASI_Tnewline && A->curtok.type != XLASI_Teof)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  A->curtok.type = XLASI_Tnewline;
+  mac->bodynum = mac->toknum;
+  if (mac->kind != XLASI_Kinline)
+    return;
+  /* the inline procedure falls through to the next line instead */
+  if (last < 0 || mac->toks[last].tok.type != Tret
+     || mac->toks[last + 1].tok.type != XLASI_Tnewline)
+    XLASI_asmerr("%s:%i:%i: The inline procedure must end with ret\n"
+                , mac->tok.filename, mac->tok.row, mac->tok.col);
+  atstart = 1;
+  for (i = 0; i < last; ++i) {
+    t = mac->toks[i].tok.type;
+    if (atstart && (t == Tret || t == Trti))
+      XLASI_asmerr("%s:%i:%i: The inline procedure returns only at its end\n"
+                  , mac->toks[i].tok.filename, mac->toks[i].tok.row
+                  , mac->toks[i].tok.col);
+    atstart = t == XLASI_Tnewline;
+  }
+  mac->bodynum = last;
+}
+
+/************************************************************/
+void
+XLASI_callmacro(XLAS *A, int mi)
+{
+  XLASI_Tok tok = A->curtok;
+  XLASI_Mtok *args = NULL;
+  int *argstart = NULL;
+  int t = 0, argnum = 0, n = 0, cap = 0, paramnum = 0;
+  paramnum = A->mactab[mi].paramnum;
+  argstart = XLASI_domalloc((paramnum + 2) * sizeof(argstart[0]));
+  t = XLASI_readtok(A);
+  if (t != XLASI_Tnewline && t != XLASI_Teof)
+    argstart[argnum++] = 0;
+  while (t != XLASI_Tnewline && t != XLASI_Teof) {
+    if (t == XLASI_Tcomma || argnum > paramnum) {
+      if (n == argstart[argnum - 1] || argnum > paramnum)
+        break;
+      argstart[argnum++] = n;
+      t = XLASI_readtok(A);
+      continue;
+    }
+    if (n + 1 > cap) {
+      cap = cap ? cap * 2 : 16;
+      args = XLASI_dorealloc(args, cap * sizeof(args[0]));
+    }
+    args[n].tok = A->curtok;
+    args[n].line = NULL;
+    n++;
+    t = XLASI_readtok(A);
+  }
+  if (argnum != paramnum || (argnum > 0 && n == argstart[argnum - 1]))
+    XLASI_asmerr("%s:%i:%i: The macro takes %i arguments\n"
+                , tok.filename, tok.row, tok.col, paramnum);
+  argstart[argnum] = n;
+  XLASI_expand(A, mi, args, argstart, 1);
+  free(args);
+  free(argstart);
+}
+
+/************************************************************/
+void
+XLASI_expand(XLAS *A, int mi, const XLASI_Mtok *args, const int *argstart
+            , int copies)
+{
+  XLASI_Macro *mac = &A->mactab[mi];
+  XLASI_Lexer *lex = NULL;
+  XLASI_Mtok *out = NULL;
+  int *renamed = NULL;
+  char *buf = NULL;
+  int c = 0, k = 0, i = 0, t = 0, n = 0, cap = 0, len = 0;
+  if (A->expanddepth >= XLASI_EXPANDCAP)
+    XLASI_asmerr("%s:%i:%i: The expansions are nested too deep\n"
+                , A->curtok.filename, A->curtok.row, A->curtok.col);
+  XLASI_taint(A, "expands a macro");
+  renamed = XLASI_domalloc((mac->localnum + 1) * sizeof(renamed[0]));
+  for (c = 0; c < copies; ++c) {
+    /* the local labels get names that cannot be typed */
+    for (i = 0; i < mac->localnum; ++i) {
+      len = strlen(XLASI_getstr(A, mac->locals[i]));
+      buf = XLASI_dorealloc(buf, len + 16);
+      sprintf(buf, "%s@%i", XLASI_getstr(A, mac->locals[i]), ++A->expandnum);
+      renamed[i] = XLASI_getsi(A, buf);
+    }
+    for (k = 0; k < mac->bodynum; ++k) {
+      if (n + mac->bodynum + 1 > cap) {
+        cap = cap ? cap * 2 : 64;
+        cap += mac->bodynum;
+        out = XLASI_dorealloc(out, cap * sizeof(out[0]));
+      }
+      t = mac->toks[k].tok.type;
+      for (i = 0; t > Ty && i < mac->paramnum; ++i) {
+        if (mac->params[i] != t)
+          continue;
+        len = argstart[i + 1] - argstart[i];
+        if (n + len > cap) {
+          cap = (n + len) * 2;
+          out = XLASI_dorealloc(out, cap * sizeof(out[0]));
+        }
+        memcpy(out + n, args + argstart[i], len * sizeof(out[0]));
+        n += len;
+        break;
+      }
+      if (t > Ty && i < mac->paramnum)
+        continue;
+      out[n] = mac->toks[k];
+      for (i = 0; t > Ty && i < mac->localnum; ++i)
+        if (mac->locals[i] == t)
+          out[n].tok.type = renamed[i];
+      n++;
+    }
+  }
+  free(renamed);
+  free(buf);
+  mac->uses += copies;
+  lex = XLASI_NEW(XLASI_Lexer);
+  lex->prev = A->L;
+  lex->filename = A->L->filename;
+  lex->toks = out;
+  lex->toknum = n;
+  lex->macro = mi + 1;
+  lex->start = A->outbuf->size;
+  A->L = lex;
+  ++A->expanddepth;
+  /* the next line comes from the expansion */
+  A->curtok.type = XLASI_Tnewline;
+}
+
+/************************************************************/
+int
+XLASI_findmacro(XLAS *A, int name)
+{
+  if (name < 0 || name >= A->strnum)
+    return -1;
+  return A->macidx[name] - 1;
+}
+
+/************************************************************/
+const char *
+XLASI_linetext(XLAS *A)
+{
+  XLASI_Lexer *L = A->L;
+  const char *end = NULL;
+  if (L->line == NULL)
+    return NULL;
+  end = memchr(L->line, '\n', L->end - L->line);
+  if (end == NULL)
+    end = (const char *)L->end;
+  return XLASI_arenadup(A, (const char *)L->line
+                       , end - (const char *)L->line);
+}
+
+/************************************************************/
+void
+XLASI_reportexpand(XLAS *A)
+{
+  XLASI_Macro *mac = NULL;
+  int i = 0, saved = 0, added = 0;
+  saved = XL_opcycles(XL_opcodes[Tcal][Mabs])
+        + XL_opcycles(XL_opcodes[Tret][Mnam]);
+  for (i = 0; i < A->macnum; ++i) {
+    mac = &A->mactab[i];
+    if (mac->kind == XLASI_Kmacro)
+      fprintf(A->expandout
+             , "xlas: -e: macro %s: %i expansions, %i bytes\n"
+             , XLASI_getstr(A, mac->name), mac->uses, mac->bytes);
+    if (mac->kind == XLASI_Krept)
+      fprintf(A->expandout, "xlas: -e: rept at %s:%i: %i copies, %i bytes\n"
+             , mac->tok.filename, mac->tok.row, mac->uses, mac->bytes);
+    if (mac->kind != XLASI_Kinline)
+      continue;
+    /* against the calls and one copy with ret */
+    added = mac->bytes - mac->uses * XL_modesizes[Mabs];
+    if (mac->uses > 0)
+      added -= mac->bytes / mac->uses + 1;
+    fprintf(A->expandout, "xlas: -e: inline %s: %i calls, %+i bytes,"
+            " %i cycles less per call\n"
+           , XLASI_getstr(A, mac->name), mac->uses, added, saved);
+  }
+}
+
+/************************************************************/
+int
+XLASI_evalexpr(XLAS *A)
+{
+  XLASI_Tok tok;
+  int t = 0, term = 0, val = 0, rel = 0;
+  A->exprpending = 0;
+  val = XLASI_evalterm(A);
+  rel = A->termrel;
+  for (;;) {
+    t = XLASI_readtok(A);
+    tok = A->curtok;
+    if (t == XLASI_Tnewline || t == XLASI_Teof || t == XLASI_Tcomma)
+      break;
+    XLASI_readtok(A);
+    term = XLASI_evalterm(A);
+    /* only label + number and label - label survive relocation */
+    if (t != XLASI_Tminus && t != XLASI_Tplus)
+      XLASI_checkabs(A, rel || A->termrel, tok);
+    if (t == XLASI_Tminus) rel -= A->termrel;
+    if (t == XLASI_Tplus)  rel += A->termrel;
+    /**/ if (t == XLASI_Tminus) val -= term;
+    else if (t == XLASI_Tplus)  val += term;
+    else if (t == XLASI_Tmult)  val *= term;
+    else if (t == XLASI_Tdiv) {
+      if (term == 0)
+        XLASI_asmerr("%s:%i:%i: Division by zero\n"
+                    , A->curtok.filename, A->curtok.row, A->curtok.col);
+      val /= term;
+    }
+    else if (t == XLASI_Tqxor)  val ^= term;
+    else if (t == XLASI_Tqnor)  val = ~(val | term);
+    else if (t == XLASI_Tqor)   val |= term;
+    else if (t == XLASI_Tqand)  val &= term;
+    else if (t == XLASI_Tmore || t == XLASI_Tless) {
+      if (term < 0 || term > 16)
+        XLASI_asmerr("%s:%i:%i: Binary shift by more then 16\n"
+                    , A->curtok.filename, A->curtok.row, A->curtok.col);
+      if (t == XLASI_Tmore) val = val >> term;
+      if (t == XLASI_Tless) val = val << term;
+    }
+    else XLASI_asmerr("%s:%i:%i: Invalid operator\n"
+                     , tok.filename, tok.row, tok.col);
+  }
+  if (rel != 0 && rel != 1)
+    XLASI_checkabs(A, 1, A->curtok);
+  A->exprrel = A->objmode && rel == 1;
+  return val & 0xFFFF;
+}
+
+/************************************************************/
+int
+XLASI_evalterm(XLAS *A)
+{
+  int vi = 0, di = 0;
+  if (A->curtok.type > Ty) {
+    vi = XLASI_findvar(A, A->curtok.type);
+    di = XLASI_finddecl(A, A->curtok.type);
+    if (A->passnum == 1 && di >= 0)
+      XLASI_addref(A, A->curtok.type, 0x8000 + A->outbuf->size, 0);
+    A->termrel = 0;
+    if (vi < 0 && di >= 0) {
+      XLASI_taint(A, "uses a var declared later");
+      /* a var before its line or before the allocation */
+      A->exprpending |= A->decltab[di].addr < 0;
+      A->guessed |= A->decltab[di].addr < 0;
+      return (A->decltab[di].addr < 0) ? 0 : A->decltab[di].addr;
+    }
+    if (vi < 0)
+      XLASI_asmerr("%s:%i:%i: Undefined identifier\n"
+                  , A->curtok.filename, A->curtok.row, A->curtok.col);
+    A->termrel = A->vartab[vi].isrel;
+    return A->vartab[vi].val;
+  }
+  A->termrel = 0;
+  if (A->curtok.type == XLASI_Tconst)
+    return A->curtok.iconst;
+  XLASI_asmerr("%s:%i:%i: Is not an integer or a defined name\n"
+              , A->curtok.filename, A->curtok.row, A->curtok.col);
+  return 0;
+}
+
+/************************************************************/
+int
+XLASI_readline(XLAS *A)
+{
+  XLASI_Tok tok;
+  int t = 0, li = -1;
+  A->vartab[0].val = 0x8000 + A->outbuf->size;
+  t = A->curtok.type;
+  tok = A->curtok;
+  A->linecycles = -1;
+  if (A->listname != NULL && t != XLASI_Teof && t != XLASI_Tnewline)
+    li = XLASI_addlisting(A, tok);
+  if (t > Ty && XLASI_findmacro(A, t) >= 0) {
+    if (A->mactab[XLASI_findmacro(A, t)].kind != XLASI_Kmacro)
+      XLASI_asmerr("%s:%i:%i: The inline procedure is expanded by cal\n"
+                  , tok.filename, tok.row, tok.col);
+    XLASI_callmacro(A, XLASI_findmacro(A, t));
+    return 0;
+  }
+  if (t > Ty) {
+    if (XLASI_readtok(A) != XLASI_Tcolon)
+      XLASI_asmerr("%s:%i:%i: No colon after the label\n"
+                  , tok.filename, tok.row, tok.col);
+    if (XLASI_setvar(A, t, 0x8000 + A->outbuf->size, 1, 1) != 0
+       || XLASI_finddecl(A, t) >= 0)
+      XLASI_asmerr("%s:%i:%i: Variable or label redefinition\n"
+                  , tok.filename, tok.row, tok.col);
+    XLASI_pushir(A, XLASI_Ilabel, -1, 0, Mnam, 0, t
+                , 0x8000 + A->outbuf->size);
+    XLASI_readtok(A);
+    if (li >= 0)
+      A->lstab[li].cycles = -1;
+    return 0;
+  }
+  if (t == XLASI_Teof) return 1;
+  if (t == XLASI_Tnewline) {
+    XLASI_readtok(A);
+    return 0;
+  }
+  if (t >= Tlet)
+    XLASI_pushir(A, XLASI_Ibar, -1, t, Mnam, 0, 0, 0);
+  if (0 <= t && t < Tlet) XLASI_readinst(A, t);
+  if (t == Tlet) XLASI_dolet(A);
+  if (t == Tvar) XLASI_dovar(A);
+  if (t == Trb) XLASI_dorb(A);
+  if (t == Tdb) XLASI_defvals(A, 0);
+  if (t == Tdw) XLASI_defvals(A, 1);
+  if (t == Tinclude) XLASI_doinclude(A);
+  if (t == Tincbin) XLASI_doincbin(A);
+  if (t == Tmacro) XLASI_domacro(A, XLASI_Kmacro);
+  if (t == Tinline) XLASI_domacro(A, XLASI_Kinline);
+  if (t == Trept) XLASI_dorept(A);
+  if (t == Tendm || t == Tendr)
+    XLASI_asmerr("%s:%i:%i: No macro or rept to end\n"
+                , tok.filename, tok.row, tok.col);
+  if (t == Tx || t == Ty || t < 0)
+    XLASI_asmerr("%s:%i:%i: Unexpected token\n"
+                , tok.filename, tok.row, tok.col);
+  if (li >= 0) {
+    A->lstab[li].size = 0x8000 + A->outbuf->size - A->lstab[li].addr;
+    A->lstab[li].cycles = A->linecycles;
+  }
+  return 0;
+}
+
+/************************************************************/
+void
+XLASI_emit8method(XLASI_Sect *sect, int data)
+{
+  XLASI_emitbyte(sect, data, 1);
+}
+
+/************************************************************/
+void
+XLASI_emit16method(XLASI_Sect *sect, int data)
+{
+  XLASI_emitle16(sect, data);
+}
+
+/************************************************************/
+void
+XLASI_emitle16(XLASI_Sect *sect, unsigned int word)
+{
+  XLASI_emitbyte(sect, word & 0xFF, 1);
+  XLASI_emitbyte(sect, (word >> 8) & 0xFF, 1);
+}
+
+/************************************************************/
+void
+XLASI_emitbyte(XLASI_Sect *sect, unsigned char data, int times)
+{
+  XLASI_Run *run = NULL;
+  if (times <= 0)
+    return;
+  if (sect->size + times > sect->maxsize)
+    XLASI_asmerr("xlx: Too much bytes in the program\n");
+  if (times < XLASI_FILLMIN) {
+    run = XLASI_bytesrun(sect, times);
+    memset(run->data + run->size, data, times);
+  }
+  else {
+    run = (sect->runnum > 0) ? &sect->runs[sect->runnum - 1] : NULL;
+    if (run == NULL || run->kind != XLASI_Rfill || run->fill != data) {
+      run = XLASI_newrun(sect, XLASI_Rfill);
+      run->fill = data;
+    }
+  }
+  run->size += times;
+  sect->size += times;
+}
+
+/************************************************************/
+void
+XLASI_emit(XLASI_Sect *sect, const char *buf, int len)
+{
+  XLASI_Run *run = NULL;
+  if (len <= 0)
+    return;
+  if (sect->size + len > sect->maxsize)
+    XLASI_asmerr("xlx: Too much bytes in the program\n");
+  run = XLASI_bytesrun(sect, len);
+  memcpy(run->data + run->size, buf, len);
+  run->size += len;
+  sect->size += len;
+}
+
+/************************************************************/
+void
+XLASI_emitmapped(XLASI_Sect *sect, char *data, int size)
+{
+  XLASI_Run *run = XLASI_newrun(sect, XLASI_Rfile);
+  run->data = data;
+  run->size = size;
+  sect->size += size;
+}
+
+/************************************************************/
+void
+XLASI_patchbyte(XLASI_Sect *sect, int offset, unsigned char data)
+{
+  XLASI_Run *run = XLASI_findrun(sect, offset);
+  /* the placeholders are always emitted bytes */
+  assert(run != NULL && run->kind == XLASI_Rbytes);
+  run->data[offset - run->offset] = data;
+}
+
+/************************************************************/
+int
+XLASI_sectbyte(const XLASI_Sect *sect, int offset)
+{
+  const XLASI_Run *run = XLASI_findrun(sect, offset);
+  if (run == NULL)
+    return 0;
+  if (run->kind == XLASI_Rfill)
+    return run->fill;
+  return (unsigned char)run->data[offset - run->offset];
+}
+
+/************************************************************/
+XLASI_Run *
+XLASI_findrun(const XLASI_Sect *sect, int offset)
+{
+  int lo = 0, hi = sect->runnum - 1, mid = 0;
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if (offset < sect->runs[mid].offset)
+      hi = mid - 1;
+    else if (offset >= sect->runs[mid].offset + sect->runs[mid].size)
+      lo = mid + 1;
+    else
+      return &sect->runs[mid];
+  }
+  return NULL;
+}
+
+/************************************************************/
+XLASI_Run *
+XLASI_bytesrun(XLASI_Sect *sect, int len)
+{
+  XLASI_Run *run = NULL;
+  run = (sect->runnum > 0) ? &sect->runs[sect->runnum - 1] : NULL;
+  if (run == NULL || run->kind != XLASI_Rbytes)
+    run = XLASI_newrun(sect, XLASI_Rbytes);
+  if (run->size + len > run->cap) {
+    while (run->size + len > run->cap)
+      run->cap = run->cap ? run->cap * 2 : 256;
+    run->data = XLASI_dorealloc(run->data, run->cap);
+  }
+  return run;
+}
+
+/************************************************************/
+XLASI_Run *
+XLASI_newrun(XLASI_Sect *sect, int kind)
+{
+  XLASI_Run *run = NULL;
+  if (sect->runnum + 1 > sect->runcap) {
+    sect->runcap = sect->runcap ? sect->runcap * 2 : 16;
+    sect->runs = XLASI_dorealloc(sect->runs
+                                , sect->runcap * sizeof(sect->runs[0]));
+  }
+  run = &sect->runs[sect->runnum++];
+  memset(run, 0, sizeof(*run));
+  run->kind = kind;
+  run->offset = sect->size;
+  return run;
+}
+
+/************************************************************/
+void
+XLASI_clearsect(XLASI_Sect *sect)
+{
+  XLASI_Run *run = NULL;
+  int i = 0;
+  for (i = 0; i < sect->runnum; ++i) {
+    run = &sect->runs[i];
+    if (run->kind == XLASI_Rbytes)
+      free(run->data);
+    if (run->kind == XLASI_Rfile)
+      munmap(run->data, run->size);
+  }
+  sect->runnum = 0;
+  sect->size = 0;
+}
+
+/************************************************************/
+int
+XLASI_writesect(const XLASI_Sect *sect, FILE *out)
+{
+  struct iovec *iov = NULL;
+  const XLASI_Run *run = NULL;
+  char *fills[256];
+  ssize_t done = 0;
+  int i = 0, k = 0, n = 0, cap = 0, first = 0, batch = 0, err = 0;
+  memset(fills, 0, sizeof(fills));
+  for (i = 0; i < sect->runnum; ++i)
+    cap += (sect->runs[i].kind == XLASI_Rfill)
+         ? (sect->runs[i].size + XLASI_FILLCHUNK - 1) / XLASI_FILLCHUNK : 1;
+  iov = XLASI_domalloc((cap + 1) * sizeof(iov[0]));
+  for (i = 0; i < sect->runnum; ++i) {
+    run = &sect->runs[i];
+    if (run->kind != XLASI_Rfill) {
+      iov[n].iov_base = run->data;
+      iov[n++].iov_len = run->size;
+      continue;
+    }
+    /* every fill byte shares one chunk */
+    if (fills[run->fill] == NULL)
+      fills[run->fill] = memset(XLASI_domalloc(XLASI_FILLCHUNK), run->fill
+                               , XLASI_FILLCHUNK);
+    for (k = 0; k < run->size; k += XLASI_FILLCHUNK) {
+      iov[n].iov_base = fills[run->fill];
+      iov[n++].iov_len = (run->size - k < XLASI_FILLCHUNK)
+                       ? run->size - k : XLASI_FILLCHUNK;
+    }
+  }
+  if (fflush(out) != 0)
+    err = -1;
+  while (!err && first < n) {
+#ifdef IOV_MAX
+    batch = (n - first < IOV_MAX) ? n - first : IOV_MAX;
+#else
+    batch = (n - first < 16) ? n - first : 16;
+#endif
+    done = writev(fileno(out), iov + first, batch);
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0)
+      err = -1;
+    /* skip what went out, a short write leaves a part of one */
+    while (done > 0 && (size_t)done >= iov[first].iov_len)
+      done -= iov[first++].iov_len;
+    if (done > 0) {
+      iov[first].iov_base = (char *)iov[first].iov_base + done;
+      iov[first].iov_len -= done;
+    }
+  }
+  for (i = 0; i < 256; ++i)
+    free(fills[i]);
+  free(iov);
+  return err;
+}
+
+/************************************************************/
+XLASI_Lexer *
+XLASI_newlex(XLAS *A, const char *filename, XLASI_Lexer *prev)
+{
+  return XLASI_srclex(XLASI_findsrc(A, filename), filename, prev);
+}
+
+/************************************************************/
+XLASI_Lexer *
+XLASI_srclex(const XLASI_Source *src, const char *filename, XLASI_Lexer *prev)
+{
+  XLASI_Lexer *lex = XLASI_NEW(XLASI_Lexer);
+  lex->prev = prev;
+  lex->filename = filename;
+  lex->buf = src->buf;
+  lex->end = src->end;
+  lex->splices = src->splices;
+  lex->splicenum = src->splicenum;
+  lex->p = (const unsigned char *)lex->buf;
+  lex->line = lex->p;
+  lex->row = 1;
+  return lex;
+}
+
+/************************************************************/
+void
+XLASI_readsrc(XLASI_Source *source)
+{
+  FILE *file = NULL;
+  size_t size = 0, cap = 0x10000, readn = 0;
+  file = fopen(source->filename, "rb");
+  if (file == NULL)
+    XLASI_asmerr("%s: %s\n", source->filename, strerror(errno));
+  source->buf = XLASI_domalloc(cap);
+  while ((readn = fread(source->buf + size, 1, cap - size - 1, file)) != 0) {
+    size += readn;
+    if (size + 1 == cap) {
+      cap *= 2;
+      source->buf = XLASI_dorealloc(source->buf, cap);
+    }
+  }
+  if (ferror(file)) {
+    fclose(file);
+    XLASI_asmerr("%s: Cannot read the file\n", source->filename);
+  }
+  fclose(file);
+  XLASI_joinsrc(source, size);
+}
+
+/************************************************************/
+void
+XLASI_joinsrc(XLASI_Source *source, size_t size)
+{
+  char *src = NULL, *dst = NULL, *end = NULL;
+  int splicecap = 0;
+  end = source->buf + size;
+  /* join the lines in place, remember where to bump the row */
+  src = memchr(source->buf, '\\', size);
+  for (dst = src; src != NULL && src < end; ) {
+    if (src[0] == '\\' && src + 1 < end && src[1] == '\n') {
+      if (source->splicenum + 1 > splicecap) {
+        splicecap = splicecap ? splicecap * 2 : 8;
+        source->splices = XLASI_dorealloc(source->splices, splicecap
+                                          * sizeof(source->splices[0]));
+      }
+      source->splices[source->splicenum++] = dst - source->buf;
+      src += 2;
+      continue;
+    }
+    *dst++ = *src++;
+  }
+  if (dst != NULL)
+    end = dst;
+  *end = '\0';
+  source->end = (const unsigned char *)end;
+}
+
+/************************************************************/
+XLASI_Source *
+XLASI_findsrc(XLAS *A, const char *filename)
+{
+  struct stat st;
+  XLASI_Source *src = NULL;
+  unsigned long hash = 0;
+  int si = XLASI_getsi(A, filename);
+  if (A->srcidx[si] != 0)
+    return A->srctab[A->srcidx[si] - 1];
+  if (A->srcnum + 1 > A->srccap) {
+    A->srccap = A->srccap ? A->srccap * 2 : 8;
+    A->srctab = XLASI_dorealloc(A->srctab, A->srccap * sizeof(A->srctab[0]));
+  }
+  if (stat(filename, &st) != 0)
+    XLASI_asmerr("%s: %s\n", filename, strerror(errno));
+  hash = XLASI_strhash(filename, strlen(filename));
+  pthread_mutex_lock(&XLASI_srclock);
+  src = XLASI_srchash[hash % XLASI_SRCHASH];
+  while (src != NULL && strcmp(src->filename, filename) != 0)
+    src = src->next;
+  if (src != NULL && src->size == (long)st.st_size
+     && src->mtime == (long)st.st_mtime)
+    src->refs++;
+  else
+    src = NULL;
+  pthread_mutex_unlock(&XLASI_srclock);
+  if (src == NULL) {
+    /* read without the lock, counted before the read so that
+       XLAS_free finds what a failed read has allocated */
+    src = XLASI_NEW(XLASI_Source);
+    src->refs = 1;
+    src->size = (long)st.st_size;
+    src->mtime = (long)st.st_mtime;
+    A->srctab[A->srcnum++] = src;
+    src->filename = strcpy(XLASI_domalloc(strlen(filename) + 1), filename);
+    XLASI_readsrc(src);
+    pthread_mutex_lock(&XLASI_srclock);
+    XLASI_sharesrc(src, hash);
+    pthread_mutex_unlock(&XLASI_srclock);
+  }
+  else {
+    A->srctab[A->srcnum++] = src;
+  }
+  A->srcidx[si] = A->srcnum;
+  return src;
+}
+
+/************************************************************/
+void
+XLASI_sharesrc(XLASI_Source *src, unsigned long hash)
+{
+  XLASI_Source **link = &XLASI_srchash[hash % XLASI_SRCHASH];
+  XLASI_Source *old = NULL;
+  while (*link != NULL && strcmp((*link)->filename, src->filename) != 0)
+    link = &(*link)->next;
+  old = *link;
+  if (old != NULL) {
+    *link = old->next;
+    old->shared = 0;
+    if (old->refs == 0)
+      XLASI_freesrc(old);
+  }
+  src->next = XLASI_srchash[hash % XLASI_SRCHASH];
+  src->shared = 1;
+  XLASI_srchash[hash % XLASI_SRCHASH] = src;
+}
+
+/************************************************************/
+void
+XLASI_dropsrc(XLASI_Source *src)
+{
+  pthread_mutex_lock(&XLASI_srclock);
+  src->refs--;
+  if (src->refs == 0 && !src->shared)
+    XLASI_freesrc(src);
+  pthread_mutex_unlock(&XLASI_srclock);
+}
+
+/************************************************************/
+void
+XLASI_freesrcs(void)
+{
+  XLASI_Source *src = NULL;
+  int i = 0;
+  pthread_mutex_lock(&XLASI_srclock);
+  for (i = 0; i < XLASI_SRCHASH; ++i) {
+    while (XLASI_srchash[i] != NULL) {
+      src = XLASI_srchash[i];
+      XLASI_srchash[i] = src->next;
+      src->shared = 0;
+      /* a running assembler frees it in XLAS_free */
+      if (src->refs == 0)
+        XLASI_freesrc(src);
+    }
+  }
+  pthread_mutex_unlock(&XLASI_srclock);
+}
+
+/************************************************************/
+void
+XLASI_freesrc(XLASI_Source *src)
+{
+  free((char *)src->filename);
+  free(src->buf);
+  free(src->splices);
+  free(src);
+}
+
+/************************************************************/
+void
+XLASI_initclasses(void)
+{
+  static struct { int type; char ch; } ops[] = {
+    {XLASI_Tmore,   '>'}, {XLASI_Tless,   '<'}, {XLASI_Tqand,   '&'},
+    {XLASI_Tqor,    '|'}, {XLASI_Tqnor,   '~'}, {XLASI_Tqxor,   '^'},
+    {XLASI_Tminus,  '-'}, {XLASI_Tplus,   '+'}, {XLASI_Tdiv,    '/'},
+    {XLASI_Tcomma,  ','}, {XLASI_Tcolon,  ':'}, {XLASI_Tmult,   '*'},
+    {XLASI_Tsharp,  '#'}, {XLASI_Tnewline, '\n'}
+  };
+  int i = 0;
+  for (i = 0; i < 256; ++i) {
+    if (i != '\n' && isspace(i))
+      XLASI_cclass[i] |= XLASI_Cspace;
+    if (isalpha(i) || isdigit(i) || i == '_' || i == '$')
+      XLASI_cclass[i] |= XLASI_Cident;
+    if (isdigit(i))
+      XLASI_cclass[i] |= XLASI_Cdigit;
+  }
+  for (i = 0; i < (int)XLASI_NUMOF(ops); ++i) {
+    XLASI_cclass[(unsigned char)ops[i].ch] |= XLASI_Cop;
+    XLASI_ctype[(unsigned char)ops[i].ch] = ops[i].type;
+  }
+}
+
+/************************************************************/
+void
+XLASI_freelex(XLASI_Lexer *lex)
+{
+  free(lex->toks);
+  free(lex);
+}
+
+/************************************************************/
+int
+XLASI_readtok(XLAS *A)
+{
+  XLASI_Lexer *prev = NULL;
+start:
+  XLASI_readprototok(A);
+  if (A->L->ttype == XLASI_Teof && A->L->prev != NULL) {
+    prev = A->L->prev;
+    if (A->L->macro != 0) {
+      A->mactab[A->L->macro - 1].bytes += A->outbuf->size - A->L->start;
+      --A->expanddepth;
+    }
+    if (A->framenum > 0 && A->frametab[A->framenum - 1].lex == A->L)
+      XLASI_endframe(A);
+    XLASI_freelex(A->L);
+    A->L = prev;
+    goto start;
+  }
+  ++A->tokcount;
+  A->curtok.filename = A->L->filename;
+  A->curtok.row = A->L->trow;
+  A->curtok.col = A->L->tcol;
+  A->curtok.type = A->L->ttype;
+  A->curtok.strlit = A->L->tstrlit;
+  A->curtok.iconst = A->L->tconst;
+  return A->curtok.type;
+}
+
+/************************************************************/
+int
+XLASI_readprototok(XLAS *A)
+{
+  XLASI_Lexer *L = A->L;
+  const unsigned char *p = L->p, *q = NULL;
+  const XLASI_Mtok *mt = NULL;
+  int len = 0, err = 0;
+  if (L->toks != NULL) {
+    /* replay the expansion */
+    if (L->toki == L->toknum)
+      return L->ttype = XLASI_Teof;
+    mt = &L->toks[L->toki++];
+    L->filename = mt->tok.filename;
+    L->line = (const unsigned char *)mt->line;
+    L->end = L->line ? L->line + strlen(mt->line) : NULL;
+    L->trow = mt->tok.row;
+    L->tcol = mt->tok.col;
+    L->tconst = mt->tok.iconst;
+    L->tstrlit = mt->tok.strlit;
+    return L->ttype = mt->tok.type;
+  }
+  /* spaces and comment */
+  for (;;) {
+    while (XLASI_cclass[*p] & XLASI_Cspace)
+      ++p;
+    if (*p != ';')
+      break;
+    q = memchr(p, '\n', L->end - p);
+    p = (q != NULL) ? q : L->end;
+  }
+  while (L->splicei < L->splicenum
+        && (const unsigned char *)L->buf + L->splices[L->splicei] <= p) {
+    L->line = (const unsigned char *)L->buf + L->splices[L->splicei];
+    L->row++;
+    L->splicei++;
+  }
+  L->trow = L->row;
+  L->tcol = p - L->line + 1;
+  if (p == L->end) {
+    L->p = p;
+    return L->ttype = XLASI_Teof;
+  }
+  /* operators and separators */
+  if (XLASI_cclass[*p] & XLASI_Cop) {
+    L->ttype = XLASI_ctype[*p];
+    L->p = ++p;
+    if (L->ttype == XLASI_Tnewline) {
+      L->line = p;
+      L->row++;
+    }
+    return L->ttype;
+  }
+  /* string-literal */
+  if (*p == '\'') {
+    for (q = ++p; *p != '\'' && *p != '\n' && p != L->end; ++p)
+      /* nothing */;
+    if (p - q >= XLASI_TOKCAP - 1)
+      XLASI_asmerr("%s:%i:%i: The string is too long\n"
+                  , L->filename, L->trow, L->tcol);
+    if (*p != '\'')
+      XLASI_asmerr("%s:%i:%i: Missing closing quote\n"
+                  , L->filename, L->trow, L->tcol);
+    L->p = p + 1;
+    L->tstrlit = XLASI_getsn(A, (const char *)q, p - q);
+    return L->ttype = XLASI_Tstrlit;
+  }
+  /* identifier or integer constant */
+  if (XLASI_cclass[*p] & XLASI_Cident) {
+    for (q = p; XLASI_cclass[*p] & XLASI_Cident; ++p)
+      /* nothing */;
+    len = p - q;
+    L->p = p;
+    if (len >= XLASI_TOKCAP - 1)
+      XLASI_asmerr("%s:%i:%i: The token is too long\n"
+                  , L->filename, L->trow, L->tcol);
+    if (XLASI_cclass[*q] & XLASI_Cdigit) {
+      L->tconst = XLASI_strint((const char *)q, len, &err);
+      if (err)
+        XLASI_asmerr("%s:%i:%i: Invalid integer constant\n"
+                    , L->filename, L->trow, L->tcol);
+      return L->ttype = XLASI_Tconst;
+    }
+    return L->ttype = XLASI_getsn(A, (const char *)q, len);
+  }
+  XLASI_asmerr("%s:%i:%i: Invalid token\n"
+              , L->filename, L->trow, L->tcol);
+  return 0;
+}
+
+/************************************************************/
+int
+XLASI_strint(const char *s, int len, int *err_out)
+{
+  int sign = 1, base = 10, i = 0, num = 0, digit = 0, a = 0;
+  if (len == 0)
+    return *err_out = 1, 0;
+  *err_out = 0;
+  if (s[0] == '+' || s[0] == '-') {
+    sign = (s[0] == '+') ? 1 : -1;
+    if (len == 1)
+      return *err_out = 1, 0;
+    len -= 1;
+    s += 1;
+  }
+  if (s[0] == '0' && len > 1) {
+    base = 8;
+    i = 1;
+    a = tolower(s[1]);
+    if (a == 'x') {
+      base = 16;
+      i = 2;
+    }
+    else if (a == 'o') {
+      base = 8;
+      i = 2;
+    }
+    else if (a == 'b') {
+      base = 2;
+      i = 2;
+    }
+  }
+  for (; i < len; i++) {
+    digit = XLASI_digitv(s[i]);
+    if (digit < 0 || digit >= base)
+      return *err_out = 1, 0;
+    num *= base;
+    num += digit;
+  }
+  return sign * num;
+}
+
+/************************************************************/
+int
+XLASI_digitv(int ch) {
+  if ('0' <= ch && ch <= '9')
+    return ch - '0';
+  if ('A' <= ch && ch <= 'F')
+    return ch - 'A' + 10;
+  if ('a' <= ch && ch <= 'f')
+    return ch - 'a' + 10;
+  return -1;
+}
+
+/************************************************************/
+int
+XLASI_getsi(XLAS *A, const char *str)
+{
+  return XLASI_getsn(A, str, strlen(str));
+}
+
+/************************************************************/
+int
+XLASI_getsn(XLAS *A, const char *str, size_t len)
+{
+  unsigned long h = 0;
+  int i = 0, si = 0, mask = A->hcap - 1;
+  si = XL_find_keyword(str, (int)len);
+  if (si >= 0)
+    return si;
+  h = XLASI_strhash(str, len);
+  for (i = h & mask; A->htab[i] != 0; i = (i + 1) & mask) {
+    si = A->htab[i] - 1;
+    if (A->strhashes[si] == h && strncmp(str, A->strtab[si], len) == 0
+       && A->strtab[si][len] == '\0')
+      return si;
+  }
+  if (A->strnum + 1 > A->strcap) {
+    A->strcap *= 2;
+    A->strtab = XLASI_dorealloc(A->strtab, A->strcap * sizeof(A->strtab[0]));
+    A->strhashes = XLASI_dorealloc(A->strhashes
+                                  , A->strcap * sizeof(A->strhashes[0]));
+    A->varidx = XLASI_dorealloc(A->varidx, A->strcap * sizeof(A->varidx[0]));
+    A->predval = XLASI_dorealloc(A->predval
+                                , A->strcap * sizeof(A->predval[0]));
+    A->declidx = XLASI_dorealloc(A->declidx
+                                , A->strcap * sizeof(A->declidx[0]));
+    A->macidx = XLASI_dorealloc(A->macidx, A->strcap * sizeof(A->macidx[0]));
+    A->srcidx = XLASI_dorealloc(A->srcidx, A->strcap * sizeof(A->srcidx[0]));
+  }
+  A->varidx[A->strnum] = 0;
+  A->predval[A->strnum] = -1;
+  A->declidx[A->strnum] = 0;
+  A->macidx[A->strnum] = 0;
+  A->srcidx[A->strnum] = 0;
+  A->strtab[A->strnum] = XLASI_arenadup(A, str, len);
+  A->strhashes[A->strnum] = h;
+  ++A->strnum;
+  A->htab[i] = A->strnum;
+  if (A->strnum * 2 > A->hcap)
+    XLASI_rehash(A);
+  return A->strnum - 1;
+}
+
+/************************************************************/
+unsigned long
+XLASI_strhash(const char *str, size_t len)
+{
+  unsigned long h = 2166136261UL;
+  for (; len > 0; ++str, --len) {
+    h ^= (unsigned char)*str;
+    h = (h * 16777619UL) & 0xFFFFFFFFUL;
+  }
+  return h;
+}
+
+/************************************************************/
+void
+XLASI_rehash(XLAS *A)
+{
+  int i = 0, si = 0, mask = 0;
+  A->hcap *= 2;
+  mask = A->hcap - 1;
+  A->htab = XLASI_dorealloc(A->htab, A->hcap * sizeof(A->htab[0]));
+  memset(A->htab, 0, A->hcap * sizeof(A->htab[0]));
+  for (si = Tcount; si < A->strnum; ++si) {
+    for (i = A->strhashes[si] & mask; A->htab[i] != 0; i = (i + 1) & mask)
+      /* nothing */;
+    A->htab[i] = si + 1;
+  }
+}
+
+/************************************************************/
+const char *
+XLASI_arenadup(XLAS *A, const char *str, size_t len)
+{
+  XLASI_Arena *a = NULL;
+  char *cpy = NULL;
+  size_t cap = XLASI_ARENACAP;
+  if (A->arena == NULL || A->arena->size + len + 1 > A->arena->cap) {
+    if (len + 1 > cap)
+      cap = len + 1;
+    a = XLASI_domalloc(sizeof(XLASI_Arena) + cap);
+    a->prev = A->arena;
+    a->buf = (char *)(a + 1);
+    a->size = 0;
+    a->cap = cap;
+    A->arena = a;
+  }
+  cpy = A->arena->buf + A->arena->size;
+  memcpy(cpy, str, len);
+  cpy[len] = '\0';
+  A->arena->size += len + 1;
+  return cpy;
+}
+
+/************************************************************/
+const char *
+XLASI_getstr(XLAS *A, int si)
+{
+  if (si < 0 || si >= A->strnum)
+    XLASI_asmerr("xlas: invalid string index\n");
+  return A->strtab[si];
+}
+
+/************************************************************/
+void
+XLASI_asmerr(const char *fmt, ...)
+{
+  XLAS *A = NULL;
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  A = pthread_getspecific(XLASI_asmkey);
+  if (A != NULL)
+    longjmp(A->fail, 1);
+  exit(EXIT_FAILURE);
+}
+
+/************************************************************/
+void *
+XLASI_domalloc(size_t size)
+{
+  void *ptr = malloc(size);
+  if (ptr == NULL)
+    XLASI_asmerr("xlas: malloc failed\n");
+  return ptr;
+}
+
+/************************************************************/
+void *
+XLASI_dorealloc(void *oldptr, size_t newsize)
+{
+  void *ptr = realloc(oldptr, newsize);
+  if (ptr == NULL)
+    XLASI_asmerr("xlas: realloc failed\n");
+  return ptr;
+}
+
+#endif /* XLAS_IMPLEMENTED */
+#endif /* !XLAS_C */
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
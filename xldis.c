@@ -2,19 +2,35 @@
 xldis.c - is the XL disassembler.
 See LICENSE information in the end of the file.
   BUILD
-gcc -std=c89 -pedantic -Wall -Wextra -o xldis xldis.c
+gcc -std=c89 -pedantic -Wall -Wextra -pthread -o xldis xldis.c
   RUN
-xldis <input-files...>
+xldis [-r] [-l] [-j <threads>] [-h <heatmap-file>] [-g <dot-file>] [-J <json-file>] <input-files...>
+  OPTIONS
+-r  Follow the control flow from the vectors and print xlas source
+    with labels, the bytes that are never reached become data
+-l  Print one JSON object per instruction instead of the text
+-j  Disassemble the input files in the threads
+-h  Annotate instructions with executions and cycles from
+    the xlx heatmap, list accessed RAM addresses
+-g  Write the basic blocks of the code found by -r as a Graphviz graph
+-J  Write the basic blocks of the code found by -r as JSON
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #define numof(arr) \
   (sizeof(arr)/sizeof((arr)[0]))
@@ -22,102 +38,1126 @@ xldis <input-files...>
 #include "extended_lemon.h"
 #include "extended_lemon_extra.h"
 
+#define PRGSIZE 0x8000
+#define VECTORS 0x7FF8
+
+/* the room outf makes for one call */
+#define OUTLINE 256
+
+/* kinds of the program bytes found by -r */
+enum {
+  Bdata,
+  Bcode,   /* the first byte of an instruction */
+  Bnext    /* the other bytes of the instruction */
+};
+
+/* kinds of the edges between the blocks */
+enum {
+  Enext,   /* the next instruction */
+  Ejump,
+  Ecall
+};
+
+typedef struct Edge {
+  int to;   /* the block */
+  int kind;
+  int back; /* goes back to a block on the path, a loop */
+} Edge;
+
+/* the output of one file, written at once */
+typedef struct Out {
+  char *buf;
+  size_t len;
+  size_t cap;
+} Out;
+
+/* what -r finds in the program */
+typedef struct Flow {
+  unsigned char kind[PRGSIZE];
+  unsigned char label[PRGSIZE];
+  unsigned char leader[PRGSIZE]; /* starts a block */
+  int blockidx[PRGSIZE];
+} Flow;
+
+/* an input file, disassembled by a thread of -j */
+typedef struct Job {
+  const char *name;
+  Out out;
+  char err[300]; /* the error instead of the output */
+  int done;
+} Job;
+
+typedef struct Block {
+  int at;     /* the first byte */
+  int size;
+  int instnum;
+  long cycles;
+  Edge *out;
+  int outnum;
+  int entry;  /* 2 for a vector, 1 for a cal target */
+} Block;
+
 /*
 Print error and exit.
 */
 static void
 errf(const char *fmt, ...);
 
+/*
+Read the heatmap file.
+*/
+static void
+readheat(const char *filename, unsigned long **counts);
+
+/*
+Print heatmap counters of the instruction.
+*/
+static void
+printheat(Out *out, unsigned long **counts, unsigned long total
+         , long addr);
+
+/*
+Append the formatted text of up to OUTLINE bytes to the output.
+*/
+static void
+outf(Out *out, const char *fmt, ...);
+
+/*
+Append the string to the output.
+*/
+static void
+outs(Out *out, const char *str);
+
+/*
+Make room for n more bytes in the output.
+*/
+static void
+outroom(Out *out, size_t n);
+
+/*
+Disassemble the program from the beginning to the vectors.
+*/
+static void
+sweep(Out *out, const unsigned char *prg, unsigned long **counts
+     , unsigned long total);
+
+/*
+Find the instructions reachable from the vectors, following the jumps
+and calls with a worklist, and the labels of the addresses they use.
+*/
+static void
+descend(Flow *fl, const unsigned char *prg);
+
+/*
+Put the addresses the instruction continues at into targ, the jump
+target first, and return how many there are. The target of cal
+goes into callee, -1 if there is none.
+*/
+static int
+successors(const unsigned char *prg, int at, long *targ, long *callee);
+
+/*
+Tell whether xlas assembles the instruction back to the same bytes.
+*/
+static int
+encodable(const unsigned char *prg, int at);
+
+/*
+Print the result of descend as xlas source.
+*/
+static void
+printsrc(Out *out, Flow *fl, const unsigned char *prg
+        , unsigned long **counts, unsigned long total);
+
+/*
+Format the instruction found by descend as xlas source.
+*/
+static void
+formatinst(Flow *fl, const unsigned char *prg, int at, char *buf);
+
+/*
+Split the code found by descend into basic blocks and link them,
+return the number of blocks.
+*/
+static int
+findblocks(Flow *fl, const unsigned char *prg, Block **blocksp);
+
+/*
+Mark the edges that go back to a block on the path from an entry.
+*/
+static void
+findback(Block *blocks, int n);
+
+/*
+Write the blocks as a Graphviz graph.
+*/
+static void
+writedot(Flow *fl, const char *filename, const char *name
+        , const unsigned char *prg, Block *blocks, int n
+        , unsigned long **counts);
+
+/*
+Write the blocks as JSON.
+*/
+static void
+writejson(Flow *fl, const char *filename, const char *name
+         , const unsigned char *prg, Block *blocks, int n
+         , unsigned long **counts);
+
+/*
+Sum the heatmap cycles of the block.
+*/
+static unsigned long
+blockheat(unsigned long **counts, const Block *b);
+
+/*
+Print the data bytes as db and rb lines.
+*/
+static void
+printdata(Out *out, const unsigned char *b, int n);
+
+/*
+Format the address as a label if there is one.
+*/
+static int
+fmtaddr(Flow *fl, char *buf, long addr, int width);
+
+/*
+Print the instructions as JSON lines, only those found by descend
+if fl is not NULL.
+*/
+static void
+printlines(Out *out, Flow *fl, const char *name
+          , const unsigned char *prg);
+
+/*
+Append the string quoted for JSON to the output, the bytes below
+0x20 as \uXXXX. The DOT files quote the same way.
+*/
+static void
+outquoted(Out *out, const char *str);
+
+/*
+Map the program of the file into memory, or read it if the file
+cannot be mapped. Return NULL and set the error of the job if
+the file is not a program.
+*/
+static const unsigned char *
+mapprg(Job *job, int *mapped);
+
+/*
+Disassemble the file of the job into its output.
+*/
+static void
+dojob(Job *job, Flow *fl);
+
+/*
+Take the jobs of -j one by one until there are none.
+*/
+static void *
+worker(void *arg);
+
+static int recursive; /* -r */
+static int jsonlines; /* -l */
+static const char *dotname; /* -g */
+static const char *jsonname; /* -J */
+static unsigned long *counts[XL_HEAT_COUNT]; /* -h */
+static unsigned long total;
+
+static Job *jobtab; /* -j */
+static int jobnum;
+static int jobnext;
+static int jobwritten;
+static int jobahead; /* the jobs done before they are written */
+static pthread_mutex_t joblock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobcond = PTHREAD_COND_INITIALIZER;
+
 /************************************************************/
 int
 main(int argc, char **argv)
 {
-  unsigned char prg[0x8000];
-  FILE *f = NULL;
-  const char *name = NULL;
-  XL_Combo *p = NULL;
-  size_t readn = 0;
-  int a = 0, i = 0, n = 0, k = 0, limit = 0, zeros = 0;
-  int m = 0, nomem = 0, val = 0, prgsize = 0;
-  XL_Word addr = 0;
-  if (argc < 2)
+  const char *heatname = NULL;
+  pthread_t *threads = NULL;
+  Flow *fl = NULL;
+  Job *job = NULL;
+  int a = 0, i = 0, threadnum = 0, failed = 0;
+  for (a = 1; a < argc && argv[a][0] == '-'; ++a) {
+    /**/ if (strcmp(argv[a], "-h") == 0 && a + 1 < argc)
+      heatname = argv[++a];
+    else if (strcmp(argv[a], "-r") == 0)
+      recursive = 1;
+    else if (strcmp(argv[a], "-l") == 0)
+      jsonlines = 1;
+    else if (strcmp(argv[a], "-g") == 0 && a + 1 < argc)
+      dotname = argv[++a];
+    else if (strcmp(argv[a], "-J") == 0 && a + 1 < argc)
+      jsonname = argv[++a];
+    else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc) {
+      threadnum = atoi(argv[++a]);
+      if (threadnum <= 0)
+        errf("xldis: -j requires the number of threads\n");
+    }
+    else
+      errf("xldis: Unknown option %s\n", argv[a]);
+  }
+  if (a >= argc)
     errf("xldis: No input files\n");
-  prgsize = 0x8000 - 8;
-  for (a = 1; a < argc; ++a) {
-    name = argv[a];
-    f = fopen(name, "rb");
-    if (f == NULL)
-      errf("%s: %s\n", name, strerror(errno));
-    readn = fread(prg, 1, 0x8000, f);
-    if (ferror(f))
-      errf("%s: Cannot read the file\n", name);
-    if (readn < 0x8000)
-      errf("%s: Too few bytes in the file\n", name);
-    fclose(f);
-    printf("   \'%s\'\n", name);
-    printf("_addr__txt__b1_b2_b3__xlas_________________\n");
-    zeros = 0;
-    for (i = 0; i < prgsize; i += n) {
-      n = 0;
-      printf(" %04X  ", 0x8000 + i);
-      for (zeros = 0; prg[i] == 0 && i < prgsize; ++i)
-        ++zeros;
-      if (zeros > 0) {
-        printf("               rb %i\n", zeros);
-        zeros = 0;
+  if ((dotname != NULL || jsonname != NULL) && a + 1 < argc)
+    errf("xldis: -g and -J name one file, they need one input file\n");
+  XL_init_opcodes();
+  counts[XL_HEAT_EXEC] = NULL;
+  if (heatname != NULL) {
+    readheat(heatname, counts);
+    for (i = 0; i < 0x10000; ++i)
+      total += counts[XL_HEAT_CYCLES][i];
+  }
+  jobnum = argc - a;
+  jobtab = calloc(jobnum, sizeof(jobtab[0]));
+  if (jobtab == NULL)
+    errf("xldis: malloc failed\n");
+  for (i = 0; i < jobnum; ++i)
+    jobtab[i].name = argv[a + i];
+  if (threadnum > 0) {
+    threads = malloc(threadnum * sizeof(threads[0]));
+    if (threads == NULL)
+      errf("xldis: malloc failed\n");
+    jobahead = 2 * threadnum;
+    for (i = 0; i < threadnum; ++i)
+      if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+        errf("xldis: Cannot create the thread\n");
+  }
+  else {
+    fl = malloc(sizeof(*fl));
+    if (fl == NULL)
+      errf("xldis: malloc failed\n");
+  }
+  /* the outputs in the order of the files */
+  for (i = 0; i < jobnum; ++i) {
+    job = &jobtab[i];
+    if (threadnum > 0) {
+      pthread_mutex_lock(&joblock);
+      while (!job->done)
+        pthread_cond_wait(&jobcond, &joblock);
+      pthread_mutex_unlock(&joblock);
+    }
+    else {
+      dojob(job, fl);
+    }
+    if (job->err[0] != '\0') {
+      fputs(job->err, stderr);
+      ++failed;
+    }
+    else if (fwrite(job->out.buf, 1, job->out.len, stdout)
+            != job->out.len) {
+      errf("xldis: Cannot write the output\n");
+    }
+    free(job->out.buf);
+    job->out.buf = NULL;
+    if (threadnum > 0) {
+      pthread_mutex_lock(&joblock);
+      jobwritten = i + 1;
+      pthread_cond_broadcast(&jobcond);
+      pthread_mutex_unlock(&joblock);
+    }
+  }
+  for (i = 0; i < threadnum; ++i)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  free(fl);
+  free(jobtab);
+  if (failed != 0)
+    exit(EXIT_FAILURE);
+  return 0;
+}
+
+/************************************************************/
+void *
+worker(void *arg)
+{
+  Flow *fl = NULL;
+  int i = 0;
+  (void)arg;
+  fl = malloc(sizeof(*fl));
+  if (fl == NULL)
+    errf("xldis: malloc failed\n");
+  for (;;) {
+    pthread_mutex_lock(&joblock);
+    /* do not get too far ahead of the writing */
+    while (jobnext < jobnum && jobnext >= jobwritten + jobahead)
+      pthread_cond_wait(&jobcond, &joblock);
+    i = jobnext++;
+    pthread_mutex_unlock(&joblock);
+    if (i >= jobnum)
+      break;
+    dojob(&jobtab[i], fl);
+    pthread_mutex_lock(&joblock);
+    jobtab[i].done = 1;
+    pthread_cond_broadcast(&jobcond);
+    pthread_mutex_unlock(&joblock);
+  }
+  free(fl);
+  return NULL;
+}
+
+/************************************************************/
+void
+dojob(Job *job, Flow *fl)
+{
+  const unsigned char *prg = NULL;
+  Block *blocks = NULL;
+  Out *out = &job->out;
+  int i = 0, n = 0, mapped = 0;
+  prg = mapprg(job, &mapped);
+  if (prg == NULL)
+    return;
+  if (recursive || dotname != NULL || jsonname != NULL)
+    descend(fl, prg);
+  if (dotname != NULL || jsonname != NULL) {
+    n = findblocks(fl, prg, &blocks);
+    findback(blocks, n);
+    if (dotname != NULL)
+      writedot(fl, dotname, job->name, prg, blocks, n, counts);
+    if (jsonname != NULL)
+      writejson(fl, jsonname, job->name, prg, blocks, n, counts);
+    for (i = 0; i < n; ++i)
+      free(blocks[i].out);
+    free(blocks);
+  }
+  if (jsonlines) {
+    printlines(out, recursive ? fl : NULL, job->name, prg);
+  }
+  else {
+    outs(out, recursive ? "; \'" : "   \'");
+    outs(out, job->name);
+    outs(out, "\'\n");
+    if (recursive)
+      printsrc(out, fl, prg, counts, total);
+    else
+      sweep(out, prg, counts, total);
+  }
+  if (counts[XL_HEAT_EXEC] != NULL && !jsonlines) {
+    /* a comment in the source */
+    outf(out, "%s_addr______loads_____stores__ram_______________\n"
+        , recursive ? ";" : "");
+    for (i = 0; i < 0x8000; ++i) {
+      if (!counts[XL_HEAT_LOADS][i] && !counts[XL_HEAT_STORES][i])
         continue;
+      outf(out, "%s %04X %10lu %10lu\n", recursive ? ";" : ""
+          , i, counts[XL_HEAT_LOADS][i], counts[XL_HEAT_STORES][i]);
+    }
+  }
+  if (mapped)
+    munmap((void *)prg, PRGSIZE);
+  else
+    free((void *)prg);
+}
+
+/************************************************************/
+const unsigned char *
+mapprg(Job *job, int *mapped)
+{
+  struct stat st;
+  unsigned char *prg = NULL;
+  void *p = NULL;
+  ssize_t readn = 0;
+  int fd = -1, at = 0;
+  fd = open(job->name, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    sprintf(job->err, "%.200s: %s\n", job->name, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  *mapped = S_ISREG(st.st_mode);
+  if (*mapped && st.st_size >= PRGSIZE) {
+    p = mmap(NULL, PRGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      sprintf(job->err, "%.200s: %s\n", job->name, strerror(errno));
+      return NULL;
+    }
+    return p;
+  }
+  *mapped = 0;
+  prg = malloc(PRGSIZE);
+  if (prg == NULL)
+    errf("xldis: malloc failed\n");
+  /* pipes and devices */
+  while (at < PRGSIZE && (readn = read(fd, prg + at, PRGSIZE - at)) > 0)
+    at += readn;
+  close(fd);
+  if (readn < 0)
+    sprintf(job->err, "%.200s: Cannot read the file\n", job->name);
+  else if (at < PRGSIZE)
+    sprintf(job->err, "%.200s: Too few bytes in the file\n", job->name);
+  if (job->err[0] != '\0') {
+    free(prg);
+    return NULL;
+  }
+  return prg;
+}
+
+/************************************************************/
+void
+printlines(Out *out, Flow *fl, const char *name
+          , const unsigned char *prg)
+{
+  XL_Insn in;
+  char text[XL_FORMAT_MAX];
+  int at = 0, k = 0, size = 0;
+  for (at = 0; at < VECTORS; at += size) {
+    size = 1;
+    /* the zeros are rb for the sweep */
+    if (fl != NULL ? fl->kind[at] != Bcode : prg[at] == 0)
+      continue;
+    size = XL_modesizes[XL_combos[prg[at]].amode];
+    if (at + size > VECTORS)
+      break;
+    XL_decode(prg + at, (XL_Word)(0x8000 + at), &in);
+    XL_format(&in, text);
+    outs(out, "{\"file\": ");
+    outquoted(out, name);
+    outf(out, ", \"addr\": %u, \"bytes\": \"", in.addr);
+    for (k = 0; k < in.size; ++k)
+      outf(out, "%02X", in.bytes[k]);
+    outf(out, "\", \"inst\": \"%s\", \"mode\": \"%s\", \"text\": \"%s\""
+              ", \"cycles\": %i", XL_keywords[in.inst]
+        , XL_addrmodes[in.amode], text, XL_opcycles(prg[at]));
+    if (counts[XL_HEAT_EXEC] != NULL)
+      outf(out, ", \"exec\": %lu, \"execcycles\": %lu"
+          , counts[XL_HEAT_EXEC][in.addr], counts[XL_HEAT_CYCLES][in.addr]);
+    outs(out, "}\n");
+  }
+}
+
+/************************************************************/
+void
+outquoted(Out *out, const char *str)
+{
+  int c = 0;
+  outroom(out, 6 * strlen(str) + 2);
+  out->buf[out->len++] = '"';
+  for (; *str != '\0'; ++str) {
+    c = (unsigned char)*str;
+    if (c < 0x20) {
+      out->len += sprintf(out->buf + out->len, "\\u%04X", c);
+      continue;
+    }
+    if (c == '"' || c == '\\')
+      out->buf[out->len++] = '\\';
+    out->buf[out->len++] = (char)c;
+  }
+  out->buf[out->len++] = '"';
+}
+
+/************************************************************/
+void
+sweep(Out *out, const unsigned char *prg, unsigned long **counts
+     , unsigned long total)
+{
+  XL_Insn *insns = NULL;
+  XL_Insn *in = NULL;
+  char txt[4], hex[10], text[XL_FORMAT_MAX];
+  long num = 0, i = 0, zeros = 0;
+  int at = 0, n = 0, k = 0, val = 0;
+  outs(out, "_addr__txt__b1_b2_b3__xlas_________________\n");
+  insns = malloc(VECTORS * sizeof(insns[0]));
+  if (insns == NULL)
+    errf("xldis: malloc failed\n");
+  num = XL_decode_all(prg, VECTORS, 0x8000, insns);
+  for (i = 0; i < num; ++i) {
+    in = &insns[i];
+    if (in->bytes[0] == 0) {
+      for (zeros = 1; i + 1 < num && insns[i + 1].bytes[0] == 0; ++i)
+        ++zeros;
+      outf(out, " %04X                 rb %li\n", in->addr, zeros);
+      continue;
+    }
+    for (k = 0; k < in->size; ++k) {
+      txt[k] = isprint(in->bytes[k]) ? in->bytes[k] : '.';
+      sprintf(hex + k * 3, " %02X", in->bytes[k]);
+    }
+    txt[k] = '\0';
+    XL_format(in, text);
+    outf(out, " %04X  %-3s %-9s  %s", in->addr, txt, hex, text);
+    if (counts[XL_HEAT_EXEC] != NULL)
+      printheat(out, counts, total, in->addr);
+    outs(out, "\n");
+  }
+  /* the instruction that does not fit before the vectors */
+  at = num ? insns[num - 1].addr - 0x8000 + insns[num - 1].size : 0;
+  if (at < VECTORS) {
+    n = XL_modesizes[XL_combos[prg[at]].amode];
+    for (k = 0; at + k < VECTORS; ++k) {
+      txt[k] = isprint(prg[at + k]) ? prg[at + k] : '.';
+      sprintf(hex + k * 3, " %02X", prg[at + k]);
+    }
+    txt[k] = '\0';
+    outf(out, " %04X  %s%*s %s%*s\n", 0x8000 + at, txt, 3 - n, ""
+        , hex, 9 - 3 * n, "");
+  }
+  free(insns);
+  k = 0;
+  for (at = VECTORS; at < PRGSIZE; at += 2) {
+    val = (prg[at + 1] << 8) | prg[at];
+    outf(out, " %04X                 dw 0x%04X; %s\n", 0x8000 + at, val
+        , XL_interrupts[k]);
+    ++k;
+  }
+}
+
+/************************************************************/
+void
+descend(Flow *fl, const unsigned char *prg)
+{
+  XL_Combo *p = NULL;
+  long *stack = NULL;
+  long addr = 0, targ[2], callee = 0;
+  int top = 0, at = 0, size = 0, k = 0, targnum = 0;
+  memset(fl->kind, Bdata, PRGSIZE);
+  memset(fl->label, 0, PRGSIZE);
+  /* every instruction pushes two addresses at most */
+  stack = malloc((2 * PRGSIZE + Icount) * sizeof(stack[0]));
+  if (stack == NULL)
+    errf("xldis: malloc failed\n");
+  for (k = 0; k < Icount; ++k)
+    stack[top++] = prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8);
+  while (top > 0) {
+    addr = stack[--top];
+    if (addr < 0x8000 || addr >= 0x8000 + VECTORS)
+      continue;
+    at = addr - 0x8000;
+    if (fl->kind[at] != Bdata || !encodable(prg, at))
+      continue;
+    p = &XL_combos[prg[at]];
+    size = XL_modesizes[p->amode];
+    /* the first decoding of overlapping instructions wins */
+    for (k = 1; k < size && fl->kind[at + k] == Bdata; ++k)
+      /* nothing */;
+    if (k < size)
+      continue;
+    fl->kind[at] = Bcode;
+    for (k = 1; k < size; ++k)
+      fl->kind[at + k] = Bnext;
+    targnum = successors(prg, at, targ, &callee);
+    for (k = 0; k < targnum; ++k)
+      stack[top++] = targ[k];
+    if (callee >= 0)
+      stack[top++] = callee;
+  }
+  free(stack);
+  /* labels go only where a line starts */
+  for (k = 0; k < Icount; ++k) {
+    addr = prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8);
+    if (addr >= 0x8000 && addr < 0x8000 + VECTORS
+       && fl->kind[addr - 0x8000] != Bnext)
+      fl->label[addr - 0x8000] = fl->kind[addr - 0x8000] == Bcode ? 'L' : 'D';
+  }
+  for (at = 0; at < VECTORS; ++at) {
+    if (fl->kind[at] != Bcode)
+      continue;
+    p = &XL_combos[prg[at]];
+    if (p->amode == Mrel)
+      addr = 0x8000 + at + (prg[at + 1] ^ 0x80) - 0x80;
+    else if (XL_modesizes[p->amode] == 3)
+      addr = prg[at + 1] | (prg[at + 2] << 8);
+    else
+      continue;
+    if (addr >= 0x8000 && addr < 0x8000 + VECTORS
+       && fl->kind[addr - 0x8000] != Bnext)
+      fl->label[addr - 0x8000] = fl->kind[addr - 0x8000] == Bcode ? 'L' : 'D';
+  }
+}
+
+/************************************************************/
+int
+successors(const unsigned char *prg, int at, long *targ, long *callee)
+{
+  XL_Combo *p = &XL_combos[prg[at]];
+  long addr = 0x8000 + at, dest = -1;
+  int n = 0, follow = 0;
+  if (p->amode == Mrel)
+    dest = addr + (prg[at + 1] ^ 0x80) - 0x80;
+  else if (p->amode == Mabs)
+    dest = prg[at + 1] | (prg[at + 2] << 8);
+  /* a store to the xlx exit port ends the program */
+  follow = p->inst != Tret && p->inst != Trti && p->inst != Tjmp
+        && !((p->inst == Tsta || p->inst == Tstx || p->inst == Tsty)
+            && p->amode == Mabs && dest == 0x7FFF);
+  *callee = -1;
+  if (p->inst == Tcal)
+    *callee = dest;
+  else if (dest >= 0 && (p->inst == Tjmp
+          || (Tjfb <= p->inst && p->inst <= Tjtz)))
+    targ[n++] = dest;
+  if (follow)
+    targ[n++] = addr + XL_modesizes[p->amode];
+  return n;
+}
+
+/************************************************************/
+int
+encodable(const unsigned char *prg, int at)
+{
+  XL_Combo *p = &XL_combos[prg[at]];
+  int m = p->amode;
+  if (p->inst == Tinv || at + XL_modesizes[m] > VECTORS)
+    return 0;
+  /* the byte is not the opcode xlas picks for the pattern */
+  if (XL_opcodes[p->inst][m] != prg[at])
+    return 0;
+  /* xlas picks the zero page for the addresses below 256 */
+  if ((m == Mabs || m == Mabx || m == Maby) && prg[at + 2] == 0)
+    return 0;
+  /* nor can it write a relative jump that wraps around */
+  if (m == Mrel && 0x8000 + at + (prg[at + 1] ^ 0x80) - 0x80 > 0xFFFF)
+    return 0;
+  return 1;
+}
+
+/************************************************************/
+void
+printsrc(Out *out, Flow *fl, const unsigned char *prg
+        , unsigned long **counts, unsigned long total)
+{
+  char buf[64];
+  int i = 0, n = 0, k = 0;
+  for (i = 0; i < VECTORS; i += n) {
+    if (fl->label[i])
+      outf(out, "  %c%04X:\n", fl->label[i], 0x8000 + i);
+    if (fl->kind[i] != Bcode) {
+      /* the data up to the next label or instruction */
+      for (n = 1; i + n < VECTORS && fl->kind[i + n] == Bdata
+          && !fl->label[i + n]; ++n)
+        /* nothing */;
+      printdata(out, prg + i, n);
+      continue;
+    }
+    n = XL_modesizes[XL_combos[prg[i]].amode];
+    formatinst(fl, prg, i, buf);
+    outs(out, buf);
+    if (counts[XL_HEAT_EXEC] != NULL)
+      printheat(out, counts, total, 0x8000 + i);
+    outs(out, "\n");
+  }
+  for (k = 0; k < Icount; ++k) {
+    fmtaddr(fl, buf, prg[VECTORS + k * 2]
+               | (prg[VECTORS + k * 2 + 1] << 8), 4);
+    outf(out, "dw %s; %s\n", buf, XL_interrupts[k]);
+  }
+}
+
+/************************************************************/
+void
+formatinst(Flow *fl, const unsigned char *prg, int at, char *buf)
+{
+  XL_Insn in;
+  XL_decode(prg + at, (XL_Word)(0x8000 + at), &in);
+  buf += sprintf(buf, "%s%s", XL_keywords[in.inst]
+                , XL_msignatures[in.amode]);
+  /**/ if (in.amode == Mimm)
+    sprintf(buf, "%i", in.operand);
+  else if (in.amode == Mrel)
+    fmtaddr(fl, buf, in.target, 4);
+  else if (in.size > 1)
+    fmtaddr(fl, buf, in.operand, in.size == 3 ? 4 : 2);
+}
+
+/************************************************************/
+int
+findblocks(Flow *fl, const unsigned char *prg, Block **blocksp)
+{
+  Block *blocks = NULL;
+  Block *b = NULL;
+  long targ[2], callee = 0;
+  int at = 0, n = 0, k = 0, i = 0, size = 0, targnum = 0, falls = 0;
+  memset(fl->leader, 0, PRGSIZE);
+  for (k = 0; k < Icount; ++k) {
+    at = (prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8)) - 0x8000;
+    if (at >= 0 && at < VECTORS && fl->kind[at] == Bcode)
+      fl->leader[at] = 1;
+  }
+  /* a block starts at every target and after every jump */
+  falls = 0;
+  for (at = 0; at < VECTORS; at += size) {
+    size = 1;
+    if (fl->kind[at] != Bcode) {
+      falls = 0;
+      continue;
+    }
+    size = XL_modesizes[XL_combos[prg[at]].amode];
+    if (!falls)
+      fl->leader[at] = 1;
+    targnum = successors(prg, at, targ, &callee);
+    falls = targnum == 1 && targ[0] == 0x8000 + at + size;
+    for (k = 0; k < targnum; ++k)
+      if (targ[k] >= 0x8000 && targ[k] < 0x8000 + VECTORS
+         && targ[k] != 0x8000 + at + size
+         && fl->kind[targ[k] - 0x8000] == Bcode)
+        fl->leader[targ[k] - 0x8000] = 1;
+    if (callee >= 0x8000 && callee < 0x8000 + VECTORS
+       && fl->kind[callee - 0x8000] == Bcode)
+      fl->leader[callee - 0x8000] = 1;
+  }
+  for (at = 0; at < VECTORS; ++at)
+    n += fl->leader[at];
+  blocks = malloc((n + 1) * sizeof(blocks[0]));
+  if (blocks == NULL)
+    errf("xldis: malloc failed\n");
+  n = 0;
+  for (at = 0; at < VECTORS; at += size) {
+    size = 1;
+    if (fl->kind[at] != Bcode)
+      continue;
+    size = XL_modesizes[XL_combos[prg[at]].amode];
+    if (fl->leader[at]) {
+      b = &blocks[n];
+      fl->blockidx[at] = n++;
+      b->at = at;
+      b->size = 0;
+      b->instnum = 0;
+      b->cycles = 0;
+      b->out = NULL;
+      b->outnum = 0;
+      b->entry = 0;
+    }
+    b->size += size;
+    b->instnum++;
+    b->cycles += XL_opcycles(prg[at]);
+  }
+  for (k = 0; k < Icount; ++k) {
+    at = (prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8)) - 0x8000;
+    if (at >= 0 && at < VECTORS && fl->kind[at] == Bcode)
+      blocks[fl->blockidx[at]].entry = 2;
+  }
+  /* the edges of the last instructions and of the calls */
+  for (i = 0; i < n; ++i) {
+    b = &blocks[i];
+    b->out = malloc((b->instnum + 2) * sizeof(b->out[0]));
+    if (b->out == NULL)
+      errf("xldis: malloc failed\n");
+    for (at = b->at; at < b->at + b->size; at += size) {
+      size = XL_modesizes[XL_combos[prg[at]].amode];
+      targnum = successors(prg, at, targ, &callee);
+      if (callee >= 0x8000 && callee < 0x8000 + VECTORS
+         && fl->kind[callee - 0x8000] == Bcode) {
+        b->out[b->outnum].to = fl->blockidx[callee - 0x8000];
+        b->out[b->outnum].kind = Ecall;
+        if (blocks[fl->blockidx[callee - 0x8000]].entry == 0)
+          blocks[fl->blockidx[callee - 0x8000]].entry = 1;
+        b->out[b->outnum++].back = 0;
       }
-      p = &XL_combos[prg[i]];
-      n = XL_modesizes[p->amode];
-      nomem = i + n > prgsize;
-      if (nomem) limit = prgsize;
-      else       limit = i + n;
-      for (k = i; k < limit; ++k)
-        putchar(isprint(prg[k]) ? prg[k] : '.');
-      if (n == 2) printf(" ");
-      if (n == 1) printf("  ");
-      putchar(' ');
-      for (k = i; k < limit; ++k)
-        printf(" %02X", prg[k]);
-      if (n == 2) printf("   ");
-      if (n == 1) printf("      ");
-      if (nomem) {
-        putchar('\n');
+    }
+    at = b->at + b->size - size;
+    for (k = 0; k < targnum; ++k) {
+      if (targ[k] < 0x8000 || targ[k] >= 0x8000 + VECTORS
+         || fl->kind[targ[k] - 0x8000] != Bcode)
+        continue;
+      b->out[b->outnum].to = fl->blockidx[targ[k] - 0x8000];
+      b->out[b->outnum].kind = (targ[k] == 0x8000 + at + size
+                                && k == targnum - 1) ? Enext : Ejump;
+      b->out[b->outnum++].back = 0;
+    }
+  }
+  *blocksp = blocks;
+  return n;
+}
+
+/************************************************************/
+void
+findback(Block *blocks, int n)
+{
+  unsigned char *state = NULL; /* 0 new, 1 on the path, 2 done */
+  int *path = NULL, *edge = NULL;
+  int top = 0, i = 0, k = 0, phase = 0;
+  Edge *e = NULL;
+  state = calloc(n + 1, 1);
+  path = malloc((n + 1) * sizeof(path[0]));
+  edge = malloc((n + 1) * sizeof(edge[0]));
+  if (state == NULL || path == NULL || edge == NULL)
+    errf("xldis: malloc failed\n");
+  /* from the vectors, then from the routines, then from the rest */
+  for (phase = 2; phase >= 0; --phase)
+  for (i = 0; i < n; ++i) {
+    if (state[i] != 0 || blocks[i].entry < phase)
+      continue;
+    state[i] = 1;
+    path[0] = i;
+    edge[0] = 0;
+    top = 1;
+    while (top > 0) {
+      k = path[top - 1];
+      if (edge[top - 1] == blocks[k].outnum) {
+        state[k] = 2;
+        --top;
         continue;
       }
-      printf("  %s", XL_keywords[p->inst]);
-      m = p->amode;
-      printf("%s", XL_msignatures[m]);
-      if (n == 2) {
-        val = prg[i + 1];
-        /**/ if (m == Mimm) {
-          printf("%i", val);
-        }
-        else if (m == Mrel) {
-          if (val > 127)
-            val |= ~0xFF;
-          addr = 0x8000 + i + val;
-          printf("%i -> 0x%04X", val, addr);
-        }
-        else {
-          printf("0x%02X", val);
-        }
-      }
-      if (n == 3) {
-        val = (prg[i + 2] << 8) | prg[i + 1];
-        printf("0x%04X", val);
-      }
-      putchar('\n');
+      e = &blocks[k].out[edge[top - 1]++];
+      /* the calls are routines of their own */
+      if (e->kind == Ecall)
+        continue;
+      if (state[e->to] == 1)
+        e->back = 1;
+      if (state[e->to] != 0)
+        continue;
+      state[e->to] = 1;
+      path[top] = e->to;
+      edge[top++] = 0;
     }
-    k = 0;
-    for (i = 0x8000 - 8; i < 0x8000; i += 2) {
-      val = (prg[i + 1] << 8) | prg[i];
-      printf(" %04X                 dw ", 0x8000 + i);
-      printf("0x%04X; %s\n", val, XL_interrupts[k]);
-      ++k;
+  }
+  free(state);
+  free(path);
+  free(edge);
+}
+
+/************************************************************/
+void
+writedot(Flow *fl, const char *filename, const char *name
+        , const unsigned char *prg, Block *blocks, int n
+        , unsigned long **counts)
+{
+  static const char *styles[] = {"", " [style=bold]", " [style=dashed]"};
+  char buf[64];
+  Out q = {NULL, 0, 0};
+  FILE *f = NULL;
+  Block *b = NULL;
+  long addr = 0;
+  int i = 0, k = 0, at = 0;
+  f = fopen(filename, "w");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  outquoted(&q, name);
+  fprintf(f, "digraph ");
+  fwrite(q.buf, 1, q.len, f);
+  fprintf(f, " {\n  node [shape=box fontname=monospace];\n");
+  for (k = 0; k < Icount; ++k) {
+    addr = prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8);
+    if (addr < 0x8000 || addr >= 0x8000 + VECTORS
+       || fl->kind[addr - 0x8000] != Bcode)
+      continue;
+    fprintf(f, "  %s [shape=plaintext];\n", XL_interrupts[k]);
+    fprintf(f, "  %s -> L%04lX;\n", XL_interrupts[k], addr);
+  }
+  for (i = 0; i < n; ++i) {
+    b = &blocks[i];
+    fprintf(f, "  L%04X [label=\"L%04X size %i cycles %li\\l"
+           , 0x8000 + b->at, 0x8000 + b->at, b->size, b->cycles);
+    if (counts[XL_HEAT_EXEC] != NULL)
+      fprintf(f, "%lux %lu cycles\\l", counts[XL_HEAT_EXEC][0x8000 + b->at]
+             , blockheat(counts, b));
+    for (at = b->at; at < b->at + b->size
+        ; at += XL_modesizes[XL_combos[prg[at]].amode]) {
+      formatinst(fl, prg, at, buf);
+      fprintf(f, "%s\\l", buf);
     }
+    fprintf(f, "\"];\n");
+    for (k = 0; k < b->outnum; ++k)
+      fprintf(f, "  L%04X -> L%04X%s;\n", 0x8000 + b->at
+             , 0x8000 + blocks[b->out[k].to].at
+             , b->out[k].back ? " [color=red style=bold]"
+             : styles[b->out[k].kind]);
   }
-  return 0;
+  fprintf(f, "}\n");
+  free(q.buf);
+  if (ferror(f) || fclose(f) != 0)
+    errf("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+void
+writejson(Flow *fl, const char *filename, const char *name
+         , const unsigned char *prg, Block *blocks, int n
+         , unsigned long **counts)
+{
+  static const char *kinds[] = {"next", "jump", "call"};
+  char buf[64];
+  Out q = {NULL, 0, 0};
+  FILE *f = NULL;
+  Block *b = NULL;
+  long addr = 0;
+  int i = 0, k = 0, at = 0;
+  f = fopen(filename, "w");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  outquoted(&q, name);
+  fprintf(f, "{\"file\": ");
+  fwrite(q.buf, 1, q.len, f);
+  fprintf(f, ",\n \"entries\": {");
+  for (k = 0; k < Icount; ++k) {
+    addr = prg[VECTORS + k * 2] | (prg[VECTORS + k * 2 + 1] << 8);
+    fprintf(f, "%s\"%s\": %li", k ? ", " : "", XL_interrupts[k], addr);
+  }
+  fprintf(f, "},\n \"blocks\": [");
+  for (i = 0; i < n; ++i) {
+    b = &blocks[i];
+    fprintf(f, "%s\n  {\"addr\": %i, \"label\": \"L%04X\", \"size\": %i"
+              ", \"cycles\": %li", i ? "," : "", 0x8000 + b->at
+           , 0x8000 + b->at, b->size, b->cycles);
+    if (counts[XL_HEAT_EXEC] != NULL)
+      fprintf(f, ", \"exec\": %lu, \"execcycles\": %lu"
+             , counts[XL_HEAT_EXEC][0x8000 + b->at]
+             , blockheat(counts, b));
+    fprintf(f, ",\n   \"insts\": [");
+    for (at = b->at; at < b->at + b->size
+        ; at += XL_modesizes[XL_combos[prg[at]].amode]) {
+      formatinst(fl, prg, at, buf);
+      fprintf(f, "%s", at != b->at ? ", " : "");
+      q.len = 0;
+      outquoted(&q, buf);
+      fwrite(q.buf, 1, q.len, f);
+    }
+    fprintf(f, "],\n   \"out\": [");
+    for (k = 0; k < b->outnum; ++k)
+      fprintf(f, "%s{\"to\": %i, \"kind\": \"%s\", \"back\": %s}"
+             , k ? ", " : "", 0x8000 + blocks[b->out[k].to].at
+             , kinds[b->out[k].kind], b->out[k].back ? "true" : "false");
+    fprintf(f, "]}");
+  }
+  fprintf(f, "\n ]}\n");
+  free(q.buf);
+  if (ferror(f) || fclose(f) != 0)
+    errf("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+unsigned long
+blockheat(unsigned long **counts, const Block *b)
+{
+  unsigned long sum = 0;
+  int at = 0;
+  for (at = b->at; at < b->at + b->size; ++at)
+    sum += counts[XL_HEAT_CYCLES][0x8000 + at];
+  return sum;
+}
+
+/************************************************************/
+void
+printdata(Out *out, const unsigned char *b, int n)
+{
+  int i = 0, k = 0, zeros = 0, chars = 0, len = 0;
+  while (i < n) {
+    for (zeros = 0; i + zeros < n && b[i + zeros] == 0; ++zeros)
+      /* nothing */;
+    for (chars = 0; i + chars < n && isprint(b[i + chars])
+        && b[i + chars] != '\''; ++chars)
+      /* nothing */;
+    if (zeros >= 4) {
+      outf(out, "rb %i\n", zeros);
+      i += zeros;
+      continue;
+    }
+    if (chars >= 4) {
+      if (chars > 64)
+        chars = 64;
+      outf(out, "db \'%.*s\'\n", chars, (const char *)b + i);
+      i += chars;
+      continue;
+    }
+    /* the bytes up to the next run of zeros or characters */
+    outs(out, "db ");
+    for (len = 0; i < n && len < 8; ++len) {
+      for (k = 0; i + k < n && k < 4 && b[i + k] == 0; ++k)
+        /* nothing */;
+      if (len > 0 && k == 4)
+        break;
+      for (k = 0; i + k < n && k < 4 && isprint(b[i + k])
+          && b[i + k] != '\''; ++k)
+        /* nothing */;
+      if (len > 0 && k == 4)
+        break;
+      outf(out, "%s0x%02X", len ? ", " : "", b[i++]);
+    }
+    outs(out, "\n");
+  }
+}
+
+/************************************************************/
+int
+fmtaddr(Flow *fl, char *buf, long addr, int width)
+{
+  if (addr >= 0x8000 && addr < 0x8000 + VECTORS && fl->label[addr - 0x8000])
+    return sprintf(buf, "%c%04lX", fl->label[addr - 0x8000], addr);
+  return sprintf(buf, "0x%0*lX", width, addr);
+}
+
+/************************************************************/
+void
+readheat(const char *filename, unsigned long **counts)
+{
+  static unsigned char buf[0x10000 * 4];
+  FILE *f = NULL;
+  char magic[8];
+  unsigned char *b = NULL;
+  long i = 0;
+  int k = 0;
+  f = fopen(filename, "rb");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, XL_HEAT_MAGIC, 8))
+    errf("%s: Not an XL heatmap file\n", filename);
+  for (k = 0; k < XL_HEAT_COUNT; ++k) {
+    if (fread(buf, 1, sizeof(buf), f) != sizeof(buf))
+      errf("%s: Too few bytes in the file\n", filename);
+    counts[k] = malloc(0x10000 * sizeof(counts[k][0]));
+    if (counts[k] == NULL)
+      errf("xldis: malloc failed\n");
+    for (i = 0; i < 0x10000; ++i) {
+      b = &buf[i * 4];
+      counts[k][i] = (unsigned long)b[0] | ((unsigned long)b[1] << 8)
+                   | ((unsigned long)b[2] << 16)
+                   | ((unsigned long)b[3] << 24);
+    }
+  }
+  fclose(f);
+}
+
+/************************************************************/
+void
+printheat(Out *out, unsigned long **counts, unsigned long total
+         , long addr)
+{
+  unsigned long exec = counts[XL_HEAT_EXEC][addr];
+  unsigned long cycles = counts[XL_HEAT_CYCLES][addr];
+  if (exec == 0)
+    return;
+  outf(out, "  ; %lux %lu cycles %.2f%%", exec, cycles
+      , total ? 100.0 * cycles / total : 0.0);
+}
+
+/************************************************************/
+void
+outf(Out *out, const char *fmt, ...)
+{
+  va_list args;
+  outroom(out, OUTLINE);
+  va_start(args, fmt);
+  out->len += vsprintf(out->buf + out->len, fmt, args);
+  va_end(args);
+}
+
+/************************************************************/
+void
+outs(Out *out, const char *str)
+{
+  size_t n = strlen(str);
+  outroom(out, n);
+  memcpy(out->buf + out->len, str, n);
+  out->len += n;
+}
+
+/************************************************************/
+void
+outroom(Out *out, size_t n)
+{
+  if (out->len + n + 1 <= out->cap)
+    return;
+  if (out->cap == 0)
+    out->cap = 0x10000;
+  while (out->len + n + 1 > out->cap)
+    out->cap *= 2;
+  out->buf = realloc(out->buf, out->cap);
+  if (out->buf == NULL)
+    errf("xldis: malloc failed\n");
 }
 
 /************************************************************/
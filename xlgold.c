@@ -0,0 +1,1027 @@
+/*
+xlgold.c - records golden traces of XL and checks engines with them.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -o xlgold xlgold.c
+ or, with the core engine of extended_lemon.hpp,
+g++ -std=c++17 -Wall -Wextra -x c++ -o xlgold xlgold.c
+  RUN
+xlgold [-n <cases>] [-l <steps>] [-s <seed>] -w <gold-file>
+ or
+xlgold [-e <engine>] [-k] <gold-file>
+ or
+xlgold [-n <cases>] [-s <seed>] -m
+  OPTIONS
+-w  Run the random cases on XL_cycle and write the golden trace
+-n  Cases for every opcode (64 by default)
+-l  Instructions of every case, the first is the opcode (4 by default)
+-s  Seed of the random cases (1 by default)
+-e  Replay the trace on the engine: xl (by default), or core of
+    extended_lemon.hpp when built as C++
+-k  Keep going after a case diverges, report the first divergence
+    of every case
+-m  Check XL_opinfo of extended_lemon_extra.h on XL_cycle with the
+    random cases of one instruction, each run again with every
+    register and flag flipped
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+#ifdef __cplusplus
+#include "extended_lemon.hpp"
+#endif
+
+/* the accesses of a step, more only count */
+#define ACCCAP 64
+
+/* XL_cycle calls of a step that never returns 1 */
+#define CALLCAP 64
+
+/*
+An engine runs the XL state like XL_init and XL_cycle do. The
+registers and the methods are set between init and the first cycle.
+*/
+typedef struct Engine {
+  const char *name;
+  void (*init)(XL *xl);
+  XL_Bool (*cycle)(XL *xl);
+} Engine;
+
+typedef struct Access {
+  unsigned char kind; /* XL_GOLD_ */
+  XL_Word addr;
+  XL_Byte data;
+} Access;
+
+typedef struct Regs {
+  XL_Word p;
+  XL_Byte a, f, s, x, y;
+} Regs;
+
+typedef struct Step {
+  unsigned char calls; /* XL_cycle calls up to the instruction */
+  unsigned char icycles; /* cycles left after it */
+  Regs regs;
+  int accnum;
+  Access acc[ACCCAP];
+} Step;
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/*
+Get the next random number.
+*/
+static unsigned long
+rnd(void);
+
+/*
+Get a random byte, often one of the edge values.
+*/
+static XL_Byte
+rndbyte(void);
+
+/*
+Get the byte of the case memory nobody stored to, often A or one of
+the edge values, so that compares get equal operands.
+*/
+static XL_Byte
+membyte(unsigned long seed, XL_Byte a, XL_Word addr);
+
+/*
+Get the byte of the case memory as it is now, without an access.
+*/
+static XL_Byte
+peek(XL_Word addr);
+
+/*
+Start a case: forget the stores, put the opcode at P and set
+the registers of the engine.
+*/
+static void
+startcase(XL *xl, const Engine *en, unsigned long seed, const Regs *r
+         , int op);
+
+/*
+Call the cycle method until it returns 1, record the accesses.
+*/
+static void
+runstep(XL *xl, const Engine *en, Step *st);
+
+/*
+Bus and event methods that record the accesses to the current step.
+*/
+static XL_Byte
+load(XL *xl, XL_Word addr);
+
+static void
+store(XL *xl, XL_Word addr, XL_Byte data);
+
+static void
+event(XL *xl, XL_Uint event);
+
+static void
+error(XL *xl, XL_Uint ecode);
+
+/*
+Add an access to the current step.
+*/
+static void
+record(int kind, XL_Word addr, XL_Byte data);
+
+/*
+Write the golden trace of the random cases.
+*/
+static void
+generate(const char *filename, long cases, int steps);
+
+/*
+Replay the golden trace on the engine, return the diverged cases.
+*/
+static long
+replay(const char *filename, const Engine *en, int keepgoing);
+
+/*
+Check XL_opinfo on the random cases, return the opcodes it does
+not describe.
+*/
+static long
+checkinfo(long cases);
+
+/*
+Check the case against the metadata of the opcode, add the effects
+seen to seen, return what differs or NULL.
+*/
+static const char *
+checkcase(int op, unsigned long seed, const Regs *r, XL_Opinfo *seen);
+
+/*
+Run the instruction of the case on XL_cycle, with the case memory
+of a instead of A, put the address of the addressing mode to addr.
+*/
+static void
+trycase(int op, unsigned long seed, const Regs *r, XL_Byte a, Step *st
+       , XL_Word *addr);
+
+/*
+Return 1 if the steps took the same cycles, accesses and registers.
+*/
+static int
+samestep(const Step *x, const Step *y);
+
+/*
+Get the register of the XL_REG_ mask.
+*/
+static XL_Byte *
+regbyte(Regs *r, int reg);
+
+/*
+Print the masks of the metadata.
+*/
+static void
+printinfo(const char *title, const XL_Opinfo *in);
+
+/*
+Compare the steps, print the first difference and return 1 if
+there is one.
+*/
+static int
+diverges(const Step *want, const Step *got);
+
+/*
+Print the access as text.
+*/
+static void
+printaccess(const Access *ac);
+
+/*
+Write and read the step and the little endian numbers.
+*/
+static void
+putstep(FILE *f, const Step *st);
+
+static int
+getstep(FILE *f, Step *st);
+
+static void
+putregs(FILE *f, const Regs *r);
+
+static void
+getregs(FILE *f, Regs *r);
+
+static void
+putnum(FILE *f, unsigned long num, int size);
+
+static unsigned long
+getnum(FILE *f, int size);
+
+#ifdef __cplusplus
+/*
+Bus of xl::Core that calls the methods of the XL state.
+*/
+struct GoldBus {
+  XL *xl;
+  XL_Byte load(XL_Word addr) { return xl->load(xl, addr); }
+  void store(XL_Word addr, XL_Byte data) { xl->store(xl, addr, data); }
+  void error(XL_Uint ecode) { xl->error(xl, ecode); }
+  void event(XL_Uint event) { xl->event(xl, event); }
+};
+
+/*
+Run one cycle of xl::Core on the registers of the XL state.
+*/
+static XL_Bool
+corecycle(XL *xl);
+#endif
+
+static const Engine engines[] = {
+  {"xl", XL_init, XL_cycle}
+#ifdef __cplusplus
+  , {"core", XL_init, corecycle}
+#endif
+};
+
+/* the registers flipped by the checks of XL_opinfo */
+static const int flipregs[] = {XL_REG_A, XL_REG_S, XL_REG_X, XL_REG_Y};
+
+static const XL_Byte edges[] = {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF};
+static XL_Byte mem[0x10000];
+static unsigned char stored[0x10000]; /* mem has the byte */
+static XL_Word storedtab[0x10000]; /* addresses to forget */
+static long storednum;
+static unsigned long memseed;
+static XL_Byte mema; /* A at the start of the case */
+static unsigned long rndstate = 1;
+static Step *cur; /* step of the accesses */
+static const char *goldname;
+static int goldeof; /* the file ended early */
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  const char *wname = NULL, *ename = "xl";
+  const Engine *en = NULL;
+  long cases = 64, fails = 0;
+  int i = 0, k = 0, steps = 4, keepgoing = 0, ischeck = 0;
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    /**/ if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+      wname = argv[++i];
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      cases = atol(argv[++i]);
+    else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+      steps = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      rndstate = strtoul(argv[++i], NULL, 0);
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+      ename = argv[++i];
+    else if (strcmp(argv[i], "-k") == 0)
+      keepgoing = 1;
+    else if (strcmp(argv[i], "-m") == 0)
+      ischeck = 1;
+    else
+      errf("xlgold: Unknown option %s\n", argv[i]);
+  }
+  XL_init_opcodes();
+  if (ischeck) {
+    if (cases <= 0 || (rndstate &= 0xFFFFFFFFUL) == 0)
+      errf("xlgold: Invalid number\n");
+    fails = checkinfo(cases);
+    fflush(stdout);
+    if (fails > 0)
+      errf("xlgold: XL_opinfo differs from XL_cycle in %li opcodes\n"
+          , fails);
+    return 0;
+  }
+  if (wname != NULL) {
+    if (cases <= 0 || steps <= 0 || steps > 0xFFFF
+       || (rndstate &= 0xFFFFFFFFUL) == 0)
+      errf("xlgold: Invalid number\n");
+    generate(wname, cases, steps);
+    return 0;
+  }
+  if (i >= argc)
+    errf("xlgold: No golden trace\n");
+  for (k = 0; k < (int)(sizeof(engines) / sizeof(engines[0])); ++k)
+    if (strcmp(engines[k].name, ename) == 0)
+      en = &engines[k];
+  if (en == NULL)
+    errf("xlgold: Unknown engine %s\n", ename);
+  fails = replay(argv[i], en, keepgoing);
+  fflush(stdout);
+  if (fails > 0)
+    errf("xlgold: %s: %li cases diverged on %s\n"
+        , argv[i], fails, en->name);
+  return 0;
+}
+
+/************************************************************/
+unsigned long
+rnd(void)
+{
+  /* xorshift32 */
+  rndstate ^= (rndstate << 13) & 0xFFFFFFFFUL;
+  rndstate ^= rndstate >> 17;
+  rndstate ^= (rndstate << 5) & 0xFFFFFFFFUL;
+  return rndstate;
+}
+
+/************************************************************/
+XL_Byte
+rndbyte(void)
+{
+  unsigned long r = rnd();
+  if ((r & 0x300) == 0)
+    return edges[(r >> 10) % sizeof(edges)];
+  return r & 0xFF;
+}
+
+/************************************************************/
+XL_Byte
+membyte(unsigned long seed, XL_Byte a, XL_Word addr)
+{
+  unsigned long h = (seed ^ (addr * 0x9E3779B1UL)) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  h = (h * 0x85EBCA6BUL) & 0xFFFFFFFFUL;
+  h ^= h >> 13;
+  h = (h * 0xC2B2AE35UL) & 0xFFFFFFFFUL;
+  h ^= h >> 16;
+  switch ((h >> 8) & 7) {
+  case 0:
+    return a;
+  case 1:
+    return edges[(h >> 11) % sizeof(edges)];
+  default:
+    return h & 0xFF;
+  }
+}
+
+/************************************************************/
+XL_Byte
+peek(XL_Word addr)
+{
+  return stored[addr] ? mem[addr] : membyte(memseed, mema, addr);
+}
+
+/************************************************************/
+void
+startcase(XL *xl, const Engine *en, unsigned long seed, const Regs *r
+         , int op)
+{
+  while (storednum > 0)
+    stored[storedtab[--storednum]] = 0;
+  memseed = seed;
+  mema = r->a;
+  en->init(xl);
+  xl->load = load;
+  xl->store = store;
+  xl->event = event;
+  xl->error = error;
+  xl->p = r->p;
+  xl->a = r->a;
+  xl->f = r->f;
+  xl->s = r->s;
+  xl->x = r->x;
+  xl->y = r->y;
+  mem[r->p] = op;
+  stored[r->p] = 1;
+  storedtab[storednum++] = r->p;
+}
+
+/************************************************************/
+void
+runstep(XL *xl, const Engine *en, Step *st)
+{
+  int r = 0;
+  cur = st;
+  st->accnum = 0;
+  st->calls = 0;
+  do {
+    r = en->cycle(xl);
+    st->calls += 1;
+  } while (!r && st->calls < CALLCAP);
+  st->icycles = xl->icycles;
+  st->regs.p = xl->p;
+  st->regs.a = xl->a;
+  st->regs.f = xl->f;
+  st->regs.s = xl->s;
+  st->regs.x = xl->x;
+  st->regs.y = xl->y;
+  cur = NULL;
+}
+
+/************************************************************/
+XL_Byte
+load(XL *xl, XL_Word addr)
+{
+  XL_Byte data = peek(addr);
+  (void)xl;
+  record(XL_GOLD_LOAD, addr, data);
+  return data;
+}
+
+/************************************************************/
+void
+store(XL *xl, XL_Word addr, XL_Byte data)
+{
+  (void)xl;
+  record(XL_GOLD_STORE, addr, data);
+  mem[addr] = data;
+  if (!stored[addr]) {
+    stored[addr] = 1;
+    storedtab[storednum++] = addr;
+  }
+}
+
+/************************************************************/
+void
+event(XL *xl, XL_Uint event)
+{
+  (void)xl;
+  record(XL_GOLD_EVENT, event, 0);
+}
+
+/************************************************************/
+void
+error(XL *xl, XL_Uint ecode)
+{
+  (void)xl;
+  record(XL_GOLD_ERROR, ecode, 0);
+}
+
+/************************************************************/
+void
+record(int kind, XL_Word addr, XL_Byte data)
+{
+  Access *ac = NULL;
+  if (cur == NULL)
+    return;
+  if (cur->accnum < ACCCAP) {
+    ac = &cur->acc[cur->accnum];
+    ac->kind = kind;
+    ac->addr = addr;
+    ac->data = data;
+  }
+  cur->accnum += 1;
+}
+
+/************************************************************/
+void
+generate(const char *filename, long cases, int steps)
+{
+  XL xl;
+  Step st;
+  Regs r;
+  FILE *f = NULL;
+  unsigned long seed = 0;
+  long k = 0;
+  int op = 0, i = 0;
+  f = fopen(filename, "wb");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  fwrite(XL_GOLD_MAGIC, 1, 8, f);
+  putnum(f, cases * XL_NUM_COMBOS, 4);
+  for (op = 0; op < XL_NUM_COMBOS; ++op) {
+    for (k = 0; k < cases; ++k) {
+      seed = rnd();
+      r.p = rndbyte() | (rndbyte() << 8);
+      r.a = rndbyte();
+      r.f = rndbyte();
+      r.s = rndbyte();
+      r.x = rndbyte();
+      r.y = rndbyte();
+      putnum(f, op, 1);
+      putnum(f, seed, 4);
+      putregs(f, &r);
+      putnum(f, steps, 2);
+      startcase(&xl, &engines[0], seed, &r, op);
+      for (i = 0; i < steps; ++i) {
+        runstep(&xl, &engines[0], &st);
+        if (st.accnum > ACCCAP)
+          errf("xlgold: Opcode 0x%02X made %i accesses in a step\n"
+              , op, st.accnum);
+        putstep(f, &st);
+      }
+    }
+  }
+  if (fclose(f) != 0)
+    errf("%s: Cannot write the file\n", filename);
+}
+
+/************************************************************/
+long
+replay(const char *filename, const Engine *en, int keepgoing)
+{
+  char magic[8];
+  char text[XL_FORMAT_MAX];
+  XL xl;
+  XL_Insn in;
+  XL_Byte bytes[3];
+  Step want, got;
+  Regs r, from;
+  FILE *f = NULL;
+  unsigned long seed = 0, casenum = 0, k = 0;
+  long fails = 0;
+  int op = 0, steps = 0, i = 0, j = 0;
+  goldname = filename;
+  f = fopen(filename, "rb");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, XL_GOLD_MAGIC, 8) != 0)
+    errf("%s: Not a golden trace\n", filename);
+  casenum = getnum(f, 4);
+  for (k = 0; k < casenum; ++k) {
+    op = getnum(f, 1);
+    seed = getnum(f, 4);
+    getregs(f, &r);
+    steps = getnum(f, 2);
+    if (goldeof)
+      break;
+    startcase(&xl, en, seed, &r, op);
+    from = r;
+    for (i = 0; i < steps; ++i) {
+      if (!getstep(f, &want))
+        break;
+      for (j = 0; j < 3; ++j)
+        bytes[j] = peek((XL_Word)(from.p + j));
+      runstep(&xl, en, &got);
+      if (!diverges(&want, &got)) {
+        from = want.regs;
+        continue;
+      }
+      XL_decode(bytes, from.p, &in);
+      XL_format(&in, text);
+      printf("  step %i, %s at 0x%04X from A=%02X F=%02X S=%02X X=%02X"
+             " Y=%02X\n", i + 1, text, from.p, from.a, from.f, from.s
+            , from.x, from.y);
+      printf("  case %lu, opcode 0x%02X, seed 0x%08lX, P=%04X A=%02X"
+             " F=%02X S=%02X X=%02X Y=%02X\n", k + 1, op, seed, r.p
+            , r.a, r.f, r.s, r.x, r.y);
+      ++fails;
+      if (!keepgoing) {
+        fclose(f);
+        return fails;
+      }
+      /* skip the rest of the case */
+      while (++i < steps && getstep(f, &want))
+        /* nothing */;
+      break;
+    }
+    if (goldeof)
+      break;
+  }
+  if (goldeof || ferror(f))
+    errf("%s: Too few bytes in the file\n", filename);
+  fclose(f);
+  printf("xlgold: %lu cases, %li diverged\n", casenum, fails);
+  return fails;
+}
+
+/************************************************************/
+long
+checkinfo(long cases)
+{
+  XL_Opinfo seen;
+  const XL_Opinfo *in = NULL;
+  const char *what = NULL;
+  Regs r;
+  unsigned long seed = 0;
+  long k = 0, fails = 0;
+  int op = 0;
+  for (op = 0; op < XL_NUM_COMBOS; ++op) {
+    in = &XL_opinfo[op];
+    memset(&seen, 0, sizeof(seen));
+    what = NULL;
+    for (k = 0; k < cases && what == NULL; ++k) {
+      seed = rnd();
+      r.p = rndbyte() | (rndbyte() << 8);
+      r.a = rndbyte();
+      r.f = rndbyte();
+      r.s = rndbyte();
+      r.x = rndbyte();
+      r.y = rndbyte();
+      what = checkcase(op, seed, &r, &seen);
+    }
+    if (what != NULL) {
+      printf("xlgold: Opcode 0x%02X %s %s %s\n", op
+            , XL_keywords[in->inst], XL_addrmodes[in->amode], what);
+      printf("  case %li, seed 0x%08lX, P=%04X A=%02X F=%02X S=%02X"
+             " X=%02X Y=%02X\n", k, seed, r.p, r.a, r.f, r.s, r.x, r.y);
+      fails += 1;
+      continue;
+    }
+    /* P is never flipped, the read of P is taken on trust */
+    seen.regsread |= in->regsread & XL_REG_P;
+    if (seen.flagsread != in->flagsread
+       || seen.flagswritten != in->flagswritten
+       || seen.regsread != in->regsread
+       || seen.regswritten != in->regswritten
+       || seen.mem != in->mem) {
+      printf("xlgold: Opcode 0x%02X %s %s has other effects in %li"
+             " cases\n", op, XL_keywords[in->inst]
+            , XL_addrmodes[in->amode], cases);
+      printinfo("XL_opinfo", in);
+      printinfo("XL_cycle", &seen);
+      fails += 1;
+    }
+  }
+  return fails;
+}
+
+/************************************************************/
+const char *
+checkcase(int op, unsigned long seed, const Regs *r, XL_Opinfo *seen)
+{
+  const XL_Opinfo *in = &XL_opinfo[op];
+  const Access *ac = NULL;
+  Step st, st2;
+  Regs r2;
+  XL_Word addr = 0, next = (XL_Word)(r->p + in->size);
+  XL_Byte d = 0;
+  int i = 0, k = 0, n = 0, changed = 0, mem = 0;
+  trycase(op, seed, r, r->a, &st, &addr);
+  if (st.calls != 1 || st.accnum > ACCCAP)
+    return "does not start in one cycle";
+  r2 = *r;
+  changed = st.regs.p != next ? XL_REG_P : 0;
+  for (k = 0; k < 4; ++k)
+    if (*regbyte(&st.regs, flipregs[k]) != *regbyte(&r2, flipregs[k]))
+      changed |= flipregs[k];
+  if (1 + st.icycles != in->cycles + (changed & XL_REG_P ? in->taken : 0))
+    return "takes other cycles";
+  if ((changed & ~in->regswritten) != 0)
+    return "writes other registers";
+  if (((st.regs.f ^ r->f) & ~in->flagswritten) != 0)
+    return "writes other flags";
+  seen->regswritten |= changed;
+  seen->flagswritten |= st.regs.f ^ r->f;
+  for (i = 0; i < st.accnum; ++i) {
+    ac = &st.acc[i];
+    if (ac->kind == XL_GOLD_EVENT || ac->kind == XL_GOLD_ERROR)
+      continue;
+    n += 1;
+    /* the opcode and the operands, imm leaves its operand to
+       the instruction */
+    if (n <= (in->amode == Mimm ? 1 : in->size)) {
+      if (ac->kind != XL_GOLD_LOAD || ac->addr != (XL_Word)(r->p + n - 1))
+        return "fetches other bytes";
+    }
+    else if (n <= in->size + 2 && (in->mem & XL_MEM_POINTER) != 0
+            && ac->kind == XL_GOLD_LOAD)
+      mem |= XL_MEM_POINTER;
+    else if (ac->addr == addr && (in->mem & XL_MEM_LOAD) != 0
+            && ac->kind == XL_GOLD_LOAD)
+      mem |= XL_MEM_LOAD;
+    else if (ac->addr == addr && (in->mem & XL_MEM_STORE) != 0
+            && ac->kind == XL_GOLD_STORE)
+      mem |= XL_MEM_STORE;
+    else if ((ac->addr >> 8) == 0x01 && (in->mem & XL_MEM_PULL) != 0
+            && ac->kind == XL_GOLD_LOAD)
+      mem |= XL_MEM_PULL;
+    else if ((ac->addr >> 8) == 0x01 && (in->mem & XL_MEM_PUSH) != 0
+            && ac->kind == XL_GOLD_STORE)
+      mem |= XL_MEM_PUSH;
+    else
+      return "accesses other memory";
+  }
+  seen->mem |= mem;
+  /* a register or a flag is read when flipping it changes more
+     than itself */
+  for (k = 0; k < 4; ++k) {
+    r2 = *r;
+    d = (XL_Byte)(rnd() % 255 + 1);
+    *regbyte(&r2, flipregs[k]) ^= d;
+    trycase(op, seed, &r2, r->a, &st2, &addr);
+    if ((in->regswritten & flipregs[k]) == 0)
+      *regbyte(&st2.regs, flipregs[k]) ^= d;
+    if (samestep(&st, &st2))
+      continue;
+    seen->regsread |= flipregs[k];
+    if ((in->regsread & flipregs[k]) == 0)
+      return "reads other registers";
+  }
+  for (k = 0; k < 8; ++k) {
+    r2 = *r;
+    r2.f ^= 1 << k;
+    trycase(op, seed, &r2, r->a, &st2, &addr);
+    /* a flag written and not read does not follow the flag it
+       had before, for and fnd keep the flags they read */
+    st2.regs.f ^= 1 << k;
+    if ((in->flagswritten & ~in->flagsread & (1 << k)) != 0
+       && samestep(&st, &st2))
+      return "does not write the flags";
+    if ((in->flagswritten & (1 << k)) != 0)
+      st2.regs.f ^= 1 << k;
+    if (samestep(&st, &st2))
+      continue;
+    seen->flagsread |= 1 << k;
+    if ((in->flagsread & (1 << k)) == 0)
+      return "reads other flags";
+  }
+  return NULL;
+}
+
+/************************************************************/
+void
+trycase(int op, unsigned long seed, const Regs *r, XL_Byte a, Step *st
+       , XL_Word *addr)
+{
+  XL xl;
+  startcase(&xl, &engines[0], seed, r, op);
+  mema = a;
+  runstep(&xl, &engines[0], st);
+  *addr = xl.addr;
+}
+
+/************************************************************/
+int
+samestep(const Step *x, const Step *y)
+{
+  int i = 0;
+  if (x->calls != y->calls || x->icycles != y->icycles
+     || x->regs.p != y->regs.p || x->regs.a != y->regs.a
+     || x->regs.f != y->regs.f || x->regs.s != y->regs.s
+     || x->regs.x != y->regs.x || x->regs.y != y->regs.y
+     || x->accnum != y->accnum)
+    return 0;
+  for (i = 0; i < x->accnum && i < ACCCAP; ++i)
+    if (x->acc[i].kind != y->acc[i].kind
+       || x->acc[i].addr != y->acc[i].addr
+       || x->acc[i].data != y->acc[i].data)
+      return 0;
+  return 1;
+}
+
+/************************************************************/
+XL_Byte *
+regbyte(Regs *r, int reg)
+{
+  switch (reg) {
+  case XL_REG_A:
+    return &r->a;
+  case XL_REG_S:
+    return &r->s;
+  case XL_REG_X:
+    return &r->x;
+  default:
+    return &r->y;
+  }
+}
+
+/************************************************************/
+void
+printinfo(const char *title, const XL_Opinfo *in)
+{
+  printf("  %-9s flags read %02X written %02X, registers read %02X"
+         " written %02X, memory %02X\n", title, in->flagsread
+        , in->flagswritten, in->regsread, in->regswritten, in->mem);
+}
+
+/************************************************************/
+int
+diverges(const Step *want, const Step *got)
+{
+  static const char *names[] = {"P", "A", "F", "S", "X", "Y"};
+  int w[6], g[6];
+  int i = 0, n = 0;
+  n = want->accnum < got->accnum ? want->accnum : got->accnum;
+  n = n < ACCCAP ? n : ACCCAP;
+  for (i = 0; i < n; ++i) {
+    if (want->acc[i].kind == got->acc[i].kind
+       && want->acc[i].addr == got->acc[i].addr
+       && want->acc[i].data == got->acc[i].data)
+      continue;
+    printf("xlgold: %s: Access %i is ", goldname, i + 1);
+    printaccess(&got->acc[i]);
+    printf(", expected ");
+    printaccess(&want->acc[i]);
+    printf("\n");
+    return 1;
+  }
+  if (want->accnum != got->accnum) {
+    printf("xlgold: %s: %i accesses, expected %i", goldname
+          , got->accnum, want->accnum);
+    if (i < got->accnum && i < ACCCAP) {
+      printf(", the first extra is ");
+      printaccess(&got->acc[i]);
+    }
+    printf("\n");
+    return 1;
+  }
+  if (want->calls != got->calls || want->icycles != got->icycles) {
+    printf("xlgold: %s: %i cycle calls and %i cycles left"
+           ", expected %i and %i\n", goldname, got->calls
+          , got->icycles, want->calls, want->icycles);
+    return 1;
+  }
+  w[0] = want->regs.p, g[0] = got->regs.p;
+  w[1] = want->regs.a, g[1] = got->regs.a;
+  w[2] = want->regs.f, g[2] = got->regs.f;
+  w[3] = want->regs.s, g[3] = got->regs.s;
+  w[4] = want->regs.x, g[4] = got->regs.x;
+  w[5] = want->regs.y, g[5] = got->regs.y;
+  for (i = 0; i < 6; ++i) {
+    if (w[i] != g[i]) {
+      printf("xlgold: %s: %s=%02X, expected %02X\n"
+            , goldname, names[i], g[i], w[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/************************************************************/
+void
+printaccess(const Access *ac)
+{
+  switch (ac->kind) {
+  case XL_GOLD_LOAD:
+    printf("load %02X from 0x%04X", ac->data, ac->addr);
+    break;
+  case XL_GOLD_STORE:
+    printf("store %02X to 0x%04X", ac->data, ac->addr);
+    break;
+  case XL_GOLD_EVENT:
+    printf("event %i", ac->addr);
+    break;
+  default:
+    printf("error %i", ac->addr);
+    break;
+  }
+}
+
+/************************************************************/
+void
+putstep(FILE *f, const Step *st)
+{
+  int i = 0;
+  putnum(f, st->calls, 1);
+  putnum(f, st->icycles, 1);
+  putregs(f, &st->regs);
+  putnum(f, st->accnum, 2);
+  for (i = 0; i < st->accnum; ++i) {
+    putnum(f, st->acc[i].kind, 1);
+    putnum(f, st->acc[i].addr, 2);
+    putnum(f, st->acc[i].data, 1);
+  }
+}
+
+/************************************************************/
+int
+getstep(FILE *f, Step *st)
+{
+  int i = 0;
+  st->calls = getnum(f, 1);
+  st->icycles = getnum(f, 1);
+  getregs(f, &st->regs);
+  st->accnum = getnum(f, 2);
+  if (st->accnum > ACCCAP)
+    errf("%s: Too many accesses in a step\n", goldname);
+  for (i = 0; i < st->accnum; ++i) {
+    st->acc[i].kind = getnum(f, 1);
+    st->acc[i].addr = getnum(f, 2);
+    st->acc[i].data = getnum(f, 1);
+  }
+  return !goldeof;
+}
+
+/************************************************************/
+void
+putregs(FILE *f, const Regs *r)
+{
+  putnum(f, r->p, 2);
+  putnum(f, r->a, 1);
+  putnum(f, r->f, 1);
+  putnum(f, r->s, 1);
+  putnum(f, r->x, 1);
+  putnum(f, r->y, 1);
+}
+
+/************************************************************/
+void
+getregs(FILE *f, Regs *r)
+{
+  r->p = getnum(f, 2);
+  r->a = getnum(f, 1);
+  r->f = getnum(f, 1);
+  r->s = getnum(f, 1);
+  r->x = getnum(f, 1);
+  r->y = getnum(f, 1);
+}
+
+/************************************************************/
+void
+putnum(FILE *f, unsigned long num, int size)
+{
+  int i = 0;
+  for (i = 0; i < size; ++i)
+    fputc((num >> (i * 8)) & 0xFF, f);
+}
+
+/************************************************************/
+unsigned long
+getnum(FILE *f, int size)
+{
+  unsigned long num = 0;
+  int i = 0, c = 0;
+  for (i = 0; i < size; ++i) {
+    c = fgetc(f);
+    if (c == EOF) {
+      goldeof = 1;
+      return 0;
+    }
+    num |= (unsigned long)c << (i * 8);
+  }
+  return num;
+}
+
+#ifdef __cplusplus
+/************************************************************/
+XL_Bool
+corecycle(XL *xl)
+{
+  GoldBus bus = {xl};
+  xl::Core<GoldBus> core(bus);
+  XL_Bool started = 0;
+  core.icycles = xl->icycles;
+  core.addr = xl->addr;
+  core.p = xl->p;
+  core.a = xl->a;
+  core.f = xl->f;
+  core.s = xl->s;
+  core.x = xl->x;
+  core.y = xl->y;
+  core.next_b_flag = xl->next_b_flag;
+  core.is_invalid = xl->is_invalid;
+  core.is_break = xl->is_break;
+  core.is_react = xl->is_react;
+  core.is_reset = xl->is_reset;
+  started = core.cycle();
+  xl->icycles = core.icycles;
+  xl->addr = core.addr;
+  xl->p = core.p;
+  xl->a = core.a;
+  xl->f = core.f;
+  xl->s = core.s;
+  xl->x = core.x;
+  xl->y = core.y;
+  xl->next_b_flag = core.next_b_flag;
+  xl->is_invalid = core.is_invalid;
+  xl->is_break = core.is_break;
+  xl->is_react = core.is_react;
+  xl->is_reset = core.is_reset;
+  return started;
+}
+#endif
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+#define EXTENDED_LEMON_C
+#include "extended_lemon.h"
+#define XL_EXTRA_C
+#include "extended_lemon_extra.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
@@ -0,0 +1,513 @@
+/*
+xlld.c - is the XL linker.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -o xlld xlld.c
+  RUN
+xlld [-e <reset>] [-b <break>] [-r <react>] [-m <map-file>] <output-file> <object-file>...
+  OPTIONS
+-e  The label of the reset vector, reset by default
+-b  The label of the break vector
+-r  The label of the react vector
+-m  Write the addresses of all labels to the file
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+
+/*
+The image covers $8000 to $FFFF, the vectors take the last 8 bytes.
+*/
+#define IMAGECAP 0x8000
+#define VECTORS 0x7FF8
+
+typedef struct Sym {
+  char *name;
+  int kind; /* XL_SYM_ */
+  int value; /* offset in the code */
+  int def; /* global index of the definition, -1 if not resolved */
+} Sym;
+
+typedef struct Reloc {
+  int offset;
+  int kind; /* XL_RELOC_ */
+  int sym; /* index in the object or XL_RELOC_SELF */
+} Reloc;
+
+typedef struct Obj {
+  const char *filename;
+  unsigned char *code;
+  int size;
+  Sym *syms;
+  int symnum;
+  Reloc *rels;
+  int relnum;
+  int base; /* address of the code, -1 if dropped */
+  int live;
+} Obj;
+
+typedef struct Global {
+  const char *name;
+  unsigned long hash;
+  int obj;
+  int value;
+  int dups; /* the number of other objects defining the name */
+} Global;
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/*
+Garantee to malloc
+*/
+static void *
+domalloc(size_t size);
+
+/*
+Read the object file.
+*/
+static void
+readobj(const char *filename, Obj *obj);
+
+/*
+Read the 16-bit little endian number.
+*/
+static int
+getle16(const unsigned char *p);
+
+/*
+Hash the string (FNV-1a).
+*/
+static unsigned long
+strhash(const char *str);
+
+/*
+Find the global definition of the name, -1 if there is none.
+*/
+static int
+findglob(const char *name);
+
+/*
+Add the exported symbol to the global table.
+*/
+static void
+addglob(const char *name, int obj, int value);
+
+/*
+Find the definition of the name for the object, stop if there is
+none or more than one.
+*/
+static int
+resolve(const char *name, const char *user);
+
+/*
+Mark the object and everything it references as live.
+*/
+static void
+markobj(int obj);
+
+/*
+Patch the placed code of the object.
+*/
+static void
+relocate(Obj *obj, unsigned char *image);
+
+/*
+Write the addresses of all labels of live objects to the file.
+*/
+static void
+writemap(const char *filename);
+
+static Obj *objtab;
+static int objnum;
+
+static Global *globtab;
+static int globnum;
+static int globcap;
+
+static int *htab; /* globtab index + 1, or 0 for an empty slot */
+static int hcap;
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  static unsigned char image[IMAGECAP];
+  static const char *vecnames[Icount];
+  FILE *out = NULL;
+  const char *oname = NULL, *mname = NULL;
+  Obj *obj = NULL;
+  int a = 0, i = 0, j = 0, g = 0, addr = 0;
+  vecnames[Ireset] = "reset";
+  for (a = 1; a < argc && argv[a][0] == '-'; ++a) {
+    /**/ if (strcmp(argv[a], "-e") == 0 && a + 1 < argc)
+      vecnames[Ireset] = argv[++a];
+    else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc)
+      vecnames[Ibreak] = argv[++a];
+    else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc)
+      vecnames[Ireact] = argv[++a];
+    else if (strcmp(argv[a], "-m") == 0 && a + 1 < argc)
+      mname = argv[++a];
+    else
+      errf("xlld: Unknown option %s\n", argv[a]);
+  }
+  if (argc - a < 2)
+    errf("xlld: Missing output and object file names\n");
+  oname = argv[a++];
+  objnum = argc - a;
+  objtab = memset(domalloc(objnum * sizeof(objtab[0])), 0
+                 , objnum * sizeof(objtab[0]));
+  for (hcap = 16; hcap < objnum * 64; hcap *= 2)
+    /* nothing */;
+  htab = memset(domalloc(hcap * sizeof(htab[0])), 0
+               , hcap * sizeof(htab[0]));
+  for (i = 0; i < objnum; ++i) {
+    obj = &objtab[i];
+    readobj(argv[a + i], obj);
+    for (j = 0; j < obj->symnum; ++j)
+      if (obj->syms[j].kind == XL_SYM_EXPORT)
+        addglob(obj->syms[j].name, i, obj->syms[j].value);
+  }
+  /* the vectors are the roots, everything else must be reachable */
+  for (i = 0; i < Icount; ++i) {
+    if (vecnames[i] == NULL)
+      continue;
+    g = resolve(vecnames[i], "xlld");
+    markobj(globtab[g].obj);
+  }
+  for (i = 0, addr = 0; i < objnum; ++i) {
+    obj = &objtab[i];
+    obj->base = -1;
+    if (!obj->live)
+      continue;
+    if (addr + obj->size > VECTORS)
+      errf("%s: The objects do not fit in the image\n", obj->filename);
+    obj->base = 0x8000 + addr;
+    memcpy(image + addr, obj->code, obj->size);
+    addr += obj->size;
+  }
+  for (i = 0; i < objnum; ++i)
+    if (objtab[i].live)
+      relocate(&objtab[i], image);
+  for (i = 0; i < Icount; ++i) {
+    if (vecnames[i] == NULL)
+      continue;
+    g = findglob(vecnames[i]);
+    addr = objtab[globtab[g].obj].base + globtab[g].value;
+    image[VECTORS + i * 2] = addr & 0xFF;
+    image[VECTORS + i * 2 + 1] = (addr >> 8) & 0xFF;
+  }
+  out = fopen(oname, "wb");
+  if (out == NULL)
+    errf("%s: %s\n", oname, strerror(errno));
+  if (fwrite(image, 1, IMAGECAP, out) != IMAGECAP)
+    errf("%s: Cannot write the file\n", oname);
+  fclose(out);
+  if (mname != NULL)
+    writemap(mname);
+  return 0;
+}
+
+/************************************************************/
+void
+readobj(const char *filename, Obj *obj)
+{
+  unsigned char head[14];
+  unsigned char rec[6];
+  FILE *f = NULL;
+  Sym *sym = NULL;
+  Reloc *rl = NULL;
+  int i = 0, len = 0;
+  obj->filename = filename;
+  f = fopen(filename, "rb");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  if (fread(head, 1, sizeof(head), f) != sizeof(head)
+     || memcmp(head, XL_OBJECT_MAGIC, 8))
+    errf("%s: Not an XL object file\n", filename);
+  obj->size = getle16(head + 8);
+  obj->symnum = getle16(head + 10);
+  obj->relnum = getle16(head + 12);
+  obj->code = domalloc(obj->size + 1);
+  obj->syms = domalloc((obj->symnum + 1) * sizeof(obj->syms[0]));
+  obj->rels = domalloc((obj->relnum + 1) * sizeof(obj->rels[0]));
+  if (fread(obj->code, 1, obj->size, f) != (size_t)obj->size)
+    errf("%s: Too few bytes in the file\n", filename);
+  for (i = 0; i < obj->symnum; ++i) {
+    sym = &obj->syms[i];
+    if (fread(rec, 1, 4, f) != 4)
+      errf("%s: Too few bytes in the file\n", filename);
+    sym->value = getle16(rec);
+    sym->kind = rec[2];
+    sym->def = -1;
+    len = rec[3];
+    sym->name = domalloc(len + 1);
+    if (fread(sym->name, 1, len, f) != (size_t)len)
+      errf("%s: Too few bytes in the file\n", filename);
+    sym->name[len] = '\0';
+  }
+  for (i = 0; i < obj->relnum; ++i) {
+    rl = &obj->rels[i];
+    if (fread(rec, 1, 6, f) != 6)
+      errf("%s: Too few bytes in the file\n", filename);
+    rl->offset = getle16(rec);
+    rl->kind = rec[2];
+    rl->sym = getle16(rec + 4);
+    if (rl->sym != XL_RELOC_SELF && rl->sym >= obj->symnum)
+      errf("%s: Invalid symbol index %i\n", filename, rl->sym);
+    if (rl->offset + ((rl->kind == XL_RELOC_ABS16) ? 2 : 1) > obj->size)
+      errf("%s: Invalid relocation offset %i\n", filename, rl->offset);
+  }
+  if (ferror(f))
+    errf("%s: Cannot read the file\n", filename);
+  fclose(f);
+}
+
+/************************************************************/
+int
+getle16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+/************************************************************/
+void
+markobj(int root)
+{
+  int *stack = NULL;
+  Obj *obj = NULL;
+  Sym *sym = NULL;
+  int top = 0, i = 0, g = 0;
+  if (objtab[root].live)
+    return;
+  stack = domalloc(objnum * sizeof(stack[0]));
+  objtab[root].live = 1;
+  stack[top++] = root;
+  while (top > 0) {
+    obj = &objtab[stack[--top]];
+    for (i = 0; i < obj->symnum; ++i) {
+      sym = &obj->syms[i];
+      if (sym->kind != XL_SYM_IMPORT)
+        continue;
+      g = resolve(sym->name, obj->filename);
+      sym->def = g;
+      if (objtab[globtab[g].obj].live)
+        continue;
+      objtab[globtab[g].obj].live = 1;
+      stack[top++] = globtab[g].obj;
+    }
+  }
+  free(stack);
+}
+
+/************************************************************/
+void
+relocate(Obj *obj, unsigned char *image)
+{
+  Reloc *rl = NULL;
+  Sym *sym = NULL;
+  unsigned char *p = NULL;
+  int i = 0, addr = 0, at = 0, rel = 0;
+  for (i = 0; i < obj->relnum; ++i) {
+    rl = &obj->rels[i];
+    at = obj->base + rl->offset;
+    p = image + (at - 0x8000);
+    if (rl->sym == XL_RELOC_SELF) {
+      addr = obj->base - 0x8000;
+      sym = NULL;
+    }
+    else {
+      sym = &obj->syms[rl->sym];
+      if (sym->kind == XL_SYM_EXPORT)
+        addr = obj->base + sym->value;
+      else
+        addr = objtab[globtab[sym->def].obj].base + globtab[sym->def].value;
+    }
+    /**/ if (rl->kind == XL_RELOC_ABS16) {
+      addr += getle16(p);
+      p[0] = addr & 0xFF;
+      p[1] = (addr >> 8) & 0xFF;
+    }
+    else if (rl->kind == XL_RELOC_ABS8) {
+      if (addr > 255)
+        errf("%s: %s does not fit in the zero page\n", obj->filename
+            , sym ? sym->name : "The object");
+      p[0] = addr;
+    }
+    else if (rl->kind == XL_RELOC_REL8) {
+      rel = addr - (at - 1);
+      if (rel > 127 || rel < -128)
+        errf("%s: %s is too far from 0x%04X\n", obj->filename
+            , sym ? sym->name : "The object", at - 1);
+      p[0] = rel & 0xFF;
+    }
+    else {
+      errf("%s: Unknown relocation kind %i\n", obj->filename, rl->kind);
+    }
+  }
+}
+
+/************************************************************/
+int
+resolve(const char *name, const char *user)
+{
+  int g = findglob(name);
+  if (g < 0)
+    errf("%s: Undefined label %s\n", user, name);
+  if (globtab[g].dups > 0)
+    errf("%s: The label %s is defined in %s and %i more objects\n"
+        , user, name, objtab[globtab[g].obj].filename, globtab[g].dups);
+  return g;
+}
+
+/************************************************************/
+int
+findglob(const char *name)
+{
+  unsigned long h = strhash(name);
+  int i = 0, g = 0, mask = hcap - 1;
+  for (i = h & mask; htab[i] != 0; i = (i + 1) & mask) {
+    g = htab[i] - 1;
+    if (globtab[g].hash == h && strcmp(globtab[g].name, name) == 0)
+      return g;
+  }
+  return -1;
+}
+
+/************************************************************/
+void
+addglob(const char *name, int obj, int value)
+{
+  Global *glob = NULL;
+  int g = findglob(name), i = 0, mask = 0;
+  if (g >= 0) {
+    globtab[g].dups++;
+    return;
+  }
+  if (globnum + 1 > globcap) {
+    globcap = globcap ? globcap * 2 : 64;
+    globtab = realloc(globtab, globcap * sizeof(globtab[0]));
+    if (globtab == NULL)
+      errf("xlld: realloc failed\n");
+  }
+  glob = &globtab[globnum++];
+  glob->name = name;
+  glob->hash = strhash(name);
+  glob->obj = obj;
+  glob->value = value;
+  glob->dups = 0;
+  if (globnum * 2 > hcap) {
+    /* double the table and put everything back */
+    free(htab);
+    hcap *= 2;
+    htab = memset(domalloc(hcap * sizeof(htab[0])), 0
+                 , hcap * sizeof(htab[0]));
+    for (g = 0; g < globnum - 1; ++g) {
+      for (i = globtab[g].hash & (hcap - 1); htab[i] != 0
+          ; i = (i + 1) & (hcap - 1))
+        /* nothing */;
+      htab[i] = g + 1;
+    }
+  }
+  mask = hcap - 1;
+  for (i = glob->hash & mask; htab[i] != 0; i = (i + 1) & mask)
+    /* nothing */;
+  htab[i] = globnum;
+}
+
+/************************************************************/
+unsigned long
+strhash(const char *str)
+{
+  unsigned long h = 2166136261UL;
+  for (; *str != '\0'; ++str) {
+    h ^= (unsigned char)*str;
+    h = (h * 16777619UL) & 0xFFFFFFFFUL;
+  }
+  return h;
+}
+
+/************************************************************/
+void
+writemap(const char *filename)
+{
+  FILE *map = NULL;
+  Obj *obj = NULL;
+  Sym *sym = NULL;
+  int i = 0, j = 0;
+  map = fopen(filename, "w");
+  if (map == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  for (i = 0; i < objnum; ++i) {
+    obj = &objtab[i];
+    if (!obj->live)
+      continue;
+    for (j = 0; j < obj->symnum; ++j) {
+      sym = &obj->syms[j];
+      if (sym->kind == XL_SYM_EXPORT)
+        fprintf(map, "0x%04X L %s\n", obj->base + sym->value, sym->name);
+    }
+  }
+  if (ferror(map))
+    errf("%s: Cannot write the file\n", filename);
+  fclose(map);
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+/************************************************************/
+void *
+domalloc(size_t size)
+{
+  void *ptr = malloc(size);
+  if (ptr == NULL)
+    errf("xlld: malloc failed\n");
+  return ptr;
+}
+
+#define XL_EXTRA_C
+#include "extended_lemon_extra.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,263 @@
+/*
+xltrace.c - is the XL execution trace decoder.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -o xltrace xltrace.c
+  RUN
+xltrace [-p <from>:<to>] [-a <from>:<to>] [-n <count>] <trace-file>
+  OPTIONS
+-p  Print only instructions at addresses in the range
+-a  Print only instructions accessing addresses in the range
+-n  Print only the last <count> instructions, with the input and
+    output records between them
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+
+/*
+The number of records read from the file at once.
+*/
+#define CHUNKCAP 0x4000
+
+/*
+The size of the text written to the output at once, and the room
+for one record.
+*/
+#define OUTCAP 0x40000
+#define OUTLINE 256
+
+typedef struct Range {
+  long from;
+  long to;
+} Range;
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/*
+Parse the range in the form <from>:<to>.
+*/
+static void
+readrange(const char *s, Range *range);
+
+/*
+Check if the record passes the filters.
+*/
+static int
+ismatch(const XL_Trace *tr, const Range *prange, const Range *arange);
+
+/*
+Print the record in the XLXDB text format.
+*/
+static void
+printrec(const XL_Trace *tr);
+
+/*
+Write the printed records to the output.
+*/
+static void
+flushout(void);
+
+static char outbuf[OUTCAP];
+static size_t outlen;
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  static XL_Trace chunk[CHUNKCAP];
+  FILE *f = NULL;
+  const char *name = NULL;
+  char magic[8];
+  Range prange, arange;
+  size_t readn = 0, k = 0;
+  long lastcap = 0, skip = 0;
+  int a = 0, instonly = 0, pass = 0;
+  prange.from = arange.from = 0;
+  prange.to = arange.to = 0xFFFF;
+  for (a = 1; a < argc && argv[a][0] == '-'; ++a) {
+    /**/ if (strcmp(argv[a], "-p") == 0 && a + 1 < argc)
+      readrange(argv[++a], &prange);
+    else if (strcmp(argv[a], "-a") == 0 && a + 1 < argc)
+      readrange(argv[++a], &arange);
+    else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+      lastcap = strtol(argv[++a], NULL, 0);
+    else
+      errf("xltrace: Unknown option %s\n", argv[a]);
+  }
+  if (a >= argc)
+    errf("xltrace: No input file\n");
+  name = argv[a];
+  instonly = prange.from != 0 || prange.to != 0xFFFF
+          || arange.from != 0 || arange.to != 0xFFFF;
+  if (lastcap < 0)
+    errf("xltrace: Invalid count\n");
+  f = fopen(name, "rb");
+  if (f == NULL)
+    errf("%s: %s\n", name, strerror(errno));
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, XL_TRACE_MAGIC, 8))
+    errf("%s: Not an XL trace file\n", name);
+  /* -n counts the instructions in the first pass and skips all
+     but the last ones in the second */
+  for (pass = lastcap > 0 ? 0 : 1; pass < 2; ++pass) {
+    if (pass == 1 && lastcap > 0) {
+      skip = skip > lastcap ? skip - lastcap : 0;
+      if (fseek(f, 8, SEEK_SET) != 0)
+        errf("%s: Cannot read the file\n", name);
+    }
+    while ((readn = fread(chunk, XL_TRACE_SIZE, CHUNKCAP, f)) != 0) {
+      for (k = 0; k < readn; ++k) {
+        if (chunk[k].kind != XL_TRACE_INST && instonly)
+          continue;
+        if (!ismatch(&chunk[k], &prange, &arange))
+          continue;
+        if (pass == 0 || skip > 0) {
+          if (chunk[k].kind == XL_TRACE_INST)
+            skip += pass == 0 ? 1 : -1;
+          continue;
+        }
+        printrec(&chunk[k]);
+      }
+    }
+    if (ferror(f))
+      errf("%s: Cannot read the file\n", name);
+  }
+  fclose(f);
+  flushout();
+  return 0;
+}
+
+/************************************************************/
+void
+readrange(const char *s, Range *range)
+{
+  char *end = NULL;
+  range->from = strtol(s, &end, 0);
+  if (*end != ':')
+    errf("xltrace: Invalid range %s\n", s);
+  range->to = strtol(end + 1, &end, 0);
+  if (*end != '\0' || range->from > range->to)
+    errf("xltrace: Invalid range %s\n", s);
+}
+
+/************************************************************/
+int
+ismatch(const XL_Trace *tr, const Range *prange, const Range *arange)
+{
+  long p = 0, addr = 0;
+  int m = 0;
+  if (tr->kind != XL_TRACE_INST)
+    return 1;
+  p = tr->p[0] | (tr->p[1] << 8);
+  if (p < prange->from || p > prange->to)
+    return 0;
+  m = XL_combos[tr->inst[0]].amode;
+  if (m == Mnam || m == Mimm || m == Mrel)
+    return arange->from == 0 && arange->to == 0xFFFF;
+  addr = tr->addr[0] | (tr->addr[1] << 8);
+  return arange->from <= addr && addr <= arange->to;
+}
+
+/************************************************************/
+void
+printrec(const XL_Trace *tr)
+{
+  XL_Insn in;
+  char *out = NULL;
+  if (outlen + OUTLINE > OUTCAP)
+    flushout();
+  out = outbuf + outlen;
+  if (tr->kind == XL_TRACE_INPUT) {
+    outlen += sprintf(out, "input VVV %i\n", tr->data);
+    return;
+  }
+  if (tr->kind == XL_TRACE_OUTPUT) {
+    outlen += sprintf(out, "output VVV %i\n", tr->data);
+    return;
+  }
+  XL_decode(tr->inst, (XL_Word)(tr->p[0] | (tr->p[1] << 8)), &in);
+  out += sprintf(out, " %04X  ", in.addr);
+  out += XL_format(&in, out);
+  if (tr->mask)
+    out += sprintf(out, " >>>");
+  if (tr->mask & XL_TRACE_F) {
+    out += sprintf(out, " f: %c%c%c%c%c%c%c%c;"
+                  , (tr->f & XL_FLAG_Z) ? 'Z' : '-'
+                  , (tr->f & XL_FLAG_V) ? 'V' : '-'
+                  , (tr->f & XL_FLAG_U) ? 'U' : '-'
+                  , (tr->f & XL_FLAG_R) ? 'R' : '-'
+                  , (tr->f & XL_FLAG_N) ? 'N' : '-'
+                  , (tr->f & XL_FLAG_D) ? 'D' : '-'
+                  , (tr->f & XL_FLAG_C) ? 'C' : '-'
+                  , (tr->f & XL_FLAG_B) ? 'B' : '-');
+  }
+  if (tr->mask & XL_TRACE_A)
+    out += sprintf(out, " a = %i;", tr->a);
+  if (tr->mask & XL_TRACE_S)
+    out += sprintf(out, " s = %i;", tr->s);
+  if (tr->mask & XL_TRACE_X)
+    out += sprintf(out, " x = %i;", tr->x);
+  if (tr->mask & XL_TRACE_Y)
+    out += sprintf(out, " y = %i;", tr->y);
+  *out++ = '\n';
+  outlen = out - outbuf;
+}
+
+/************************************************************/
+void
+flushout(void)
+{
+  if (fwrite(outbuf, 1, outlen, stdout) != outlen)
+    errf("xltrace: Cannot write the output\n");
+  outlen = 0;
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+#define XL_EXTRA_C
+#include "extended_lemon_extra.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,824 @@
+/*
+xlwcet.c - is the XL worst-case timing analyzer.
+See LICENSE information in the end of the file.
+  BUILD
+gcc -std=c89 -pedantic -Wall -Wextra -o xlwcet xlwcet.c
+  RUN
+xlwcet [-s <map-file>] [-b <bounds-file>] <xlx-file>
+  OPTIONS
+-s  Read the labels from the xlas map file
+-b  Read the loop bounds and the cycle budgets from the file
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extended_lemon.h"
+#include "extended_lemon_extra.h"
+
+#define PRGSIZE 0x8000
+#define VECTORS 0x7FF8
+
+/* the cycles of taking an interrupt before the first instruction */
+#define INTCYCLES 5
+
+/* results of routines that have no cycle count */
+enum {
+  Wunbounded = -1, /* see the reason */
+  Wnoreturn  = -2  /* no path reaches ret or rti */
+};
+
+/* reasons of unbounded routines */
+enum {
+  Rnone,
+  Rloop,      /* the loop has no bound */
+  Rjump,      /* a jump that cannot be followed */
+  Rrecursion  /* the routine calls itself back */
+};
+
+typedef struct Node {
+  int addr;
+  long cost; /* the instruction and what it calls, or the loop */
+  int *out; /* successor nodes */
+  int outnum;
+  int isret; /* ret, rti or exit, or a loop that contains one */
+  int rep; /* the outermost collapsed loop of the node */
+  int loop; /* the last loop the node belongs to */
+} Node;
+
+typedef struct Loop {
+  int head;
+  int *body;
+  int bodynum;
+} Loop;
+
+typedef struct Limit {
+  char name[256];
+  int addr;
+  long value;
+  int isbudget;
+} Limit;
+
+/*
+Print error and exit.
+*/
+static void
+errf(const char *fmt, ...);
+
+/*
+Garantee to malloc
+*/
+static void *
+domalloc(size_t size);
+
+/*
+Garantee to realloc
+*/
+static void *
+dorealloc(void *oldptr, size_t newsize);
+
+/*
+Read the labels of the map file.
+*/
+static void
+readmap(const char *filename);
+
+/*
+Read the loop bounds and the budgets.
+*/
+static void
+readbounds(const char *filename);
+
+/*
+Get the address of the label or the number.
+*/
+static int
+findaddr(const char *name);
+
+/*
+Get the loop bound of the header, -1 if there is none.
+*/
+static long
+findbound(int addr);
+
+/*
+Compute the worst-case cycles of the routine from its entry to
+ret or rti, or one of Wunbounded and Wnoreturn.
+*/
+static long
+analyze(int entry);
+
+/*
+Collect the instructions of the routine, stop at calls.
+*/
+static int
+discover(int entry, Node **nodesp);
+
+/*
+Find the loops of the routine, the innermost first.
+*/
+static int
+findloops(Node *nodes, int n, Loop **loopsp);
+
+/*
+Get the longest path in cycles from the start node over
+the collapsed graph. In the loop mode only the nodes of the loop
+count and the jumps back to the start are the iterations.
+*/
+static void
+longest(Node *nodes, int n, int start, int loop, long *iter
+       , long *exitc);
+
+/*
+Record why the routine is unbounded and return Wunbounded.
+*/
+static long
+unbounded(int entry, int reason, int at);
+
+/*
+Print the result of the routine.
+*/
+static void
+printroutine(int addr, int vec);
+
+/*
+Order the loops by size, the inner loops first.
+*/
+static int
+cmploop(const void *a, const void *b);
+
+static unsigned char prg[PRGSIZE];
+static const char *names[PRGSIZE]; /* labels by the address */
+
+static long wcet[PRGSIZE];
+static unsigned char state[PRGSIZE]; /* 0 new, 1 in progress, 2 done */
+static unsigned char reason[PRGSIZE];
+static int reasonat[PRGSIZE];
+
+static int seen[PRGSIZE]; /* the stamp of the routine */
+static int nodeidx[PRGSIZE];
+static int stamp;
+
+static Limit *limtab;
+static int limnum;
+static int limcap;
+
+/************************************************************/
+int
+main(int argc, char **argv)
+{
+  FILE *f = NULL;
+  const char *mapname = NULL, *boundsname = NULL, *name = NULL;
+  Limit *lim = NULL;
+  long w = 0;
+  int a = 0, i = 0, vec[Icount], fails = 0;
+  for (a = 1; a < argc && argv[a][0] == '-'; ++a) {
+    /**/ if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+      mapname = argv[++a];
+    else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc)
+      boundsname = argv[++a];
+    else
+      errf("xlwcet: Unknown option %s\n", argv[a]);
+  }
+  if (a >= argc)
+    errf("xlwcet: No input file\n");
+  name = argv[a];
+  f = fopen(name, "rb");
+  if (f == NULL)
+    errf("%s: %s\n", name, strerror(errno));
+  if (fread(prg, 1, PRGSIZE, f) != PRGSIZE)
+    errf("%s: Too few bytes in the file\n", name);
+  fclose(f);
+  if (mapname != NULL)
+    readmap(mapname);
+  if (boundsname != NULL)
+    readbounds(boundsname);
+  for (i = Ibreak; i < Icount; ++i) {
+    vec[i] = prg[VECTORS + i * 2] | (prg[VECTORS + i * 2 + 1] << 8);
+    if (vec[i] >= 0x8000 && vec[i] < 0x8000 + VECTORS)
+      analyze(vec[i]);
+    else
+      vec[i] = -1;
+  }
+  for (i = 0; i < limnum; ++i)
+    if (limtab[i].isbudget)
+      analyze(limtab[i].addr);
+  if (mapname != NULL)
+    printf("_addr_____cycles__routine_____________\n");
+  else
+    printf("_addr_____cycles______________________\n");
+  for (a = 0; a < VECTORS; ++a) {
+    if (state[a] != 2)
+      continue;
+    for (i = Icount - 1; i >= Ibreak && vec[i] != 0x8000 + a; --i)
+      /* nothing */;
+    printroutine(0x8000 + a, i >= Ibreak ? i : -1);
+  }
+  for (i = 0; i < limnum; ++i) {
+    lim = &limtab[i];
+    if (!lim->isbudget)
+      continue;
+    w = wcet[lim->addr - 0x8000];
+    if (w >= 0 && (lim->addr == vec[Ibreak] || lim->addr == vec[Ireact]))
+      w += INTCYCLES;
+    if (w == Wnoreturn || (w >= 0 && w <= lim->value))
+      continue;
+    if (w < 0)
+      printf("xlwcet: %s has no bound, the budget is %li\n"
+            , lim->name, lim->value);
+    else
+      printf("xlwcet: %s takes %li cycles, the budget is %li\n"
+            , lim->name, w, lim->value);
+    ++fails;
+  }
+  return fails ? EXIT_FAILURE : 0;
+}
+
+/************************************************************/
+long
+analyze(int entry)
+{
+  Node *nodes = NULL;
+  Loop *loops = NULL;
+  Loop *lp = NULL;
+  Node *nd = NULL;
+  XL_Combo *p = NULL;
+  long w = 0, iter = 0, exitc = 0, bound = 0, result = 0;
+  int e = entry - 0x8000, n = 0, loopnum = 0, i = 0, j = 0, k = 0;
+  int callee = 0, r = 0, v = 0, isret = 0, *exits = NULL, exitnum = 0;
+  if (state[e] == 2)
+    return wcet[e];
+  if (state[e] == 1)
+    return unbounded(entry, Rrecursion, entry);
+  state[e] = 1;
+  n = discover(entry, &nodes);
+  if (n < 0) {
+    result = Wunbounded;
+    goto done;
+  }
+  /* the costs of the calls, the nodes do not use the index table */
+  for (i = 0; i < n; ++i) {
+    nd = &nodes[i];
+    p = &XL_combos[prg[nd->addr - 0x8000]];
+    if (p->inst != Tcal && p->inst != Tbrk)
+      continue;
+    if (p->inst == Tbrk)
+      callee = prg[VECTORS + Ibreak * 2]
+             | (prg[VECTORS + Ibreak * 2 + 1] << 8);
+    else if (p->amode == Mrel)
+      callee = nd->addr + (prg[nd->addr - 0x8000 + 1] ^ 0x80) - 0x80;
+    else
+      callee = prg[nd->addr - 0x8000 + 1]
+             | (prg[nd->addr - 0x8000 + 2] << 8);
+    if (callee < 0x8000 || callee >= 0x8000 + VECTORS)
+      w = unbounded(callee = entry, Rjump, nd->addr);
+    else
+      w = analyze(callee);
+    if (w == Wunbounded) {
+      reason[e] = reason[callee - 0x8000];
+      reasonat[e] = reasonat[callee - 0x8000];
+      result = Wunbounded;
+      goto done;
+    }
+    if (w == Wnoreturn) {
+      nd->outnum = 0;
+      continue;
+    }
+    nd->cost += w + ((p->inst == Tbrk) ? INTCYCLES : 0);
+  }
+  loopnum = findloops(nodes, n, &loops);
+  exits = domalloc((n + 1) * sizeof(exits[0]));
+  for (k = 0; k < loopnum; ++k) {
+    lp = &loops[k];
+    for (i = 0; i < lp->bodynum; ++i)
+      nodes[lp->body[i]].loop = k;
+    if (nodes[lp->head].rep != lp->head)
+      errf("xlwcet: The loops at 0x%04X and 0x%04X overlap\n"
+          , nodes[lp->head].addr, nodes[nodes[lp->head].rep].addr);
+    longest(nodes, n, lp->head, k, &iter, &exitc);
+    bound = findbound(nodes[lp->head].addr);
+    if (bound < 0) {
+      result = unbounded(entry, Rloop, nodes[lp->head].addr);
+      goto done;
+    }
+    /* collapse the loop into its header */
+    exitnum = 0;
+    isret = 0;
+    for (i = 0; i < lp->bodynum; ++i) {
+      r = nodes[lp->body[i]].rep;
+      if (r != lp->body[i])
+        continue;
+      isret |= nodes[r].isret;
+      for (j = 0; j < nodes[r].outnum; ++j) {
+        v = nodes[r].out[j];
+        if (nodes[v].loop != k)
+          exits[exitnum++] = v;
+      }
+    }
+    for (i = 0; i < lp->bodynum; ++i)
+      nodes[lp->body[i]].rep = lp->head;
+    nd = &nodes[lp->head];
+    free(nd->out);
+    nd->out = memcpy(domalloc((exitnum + 1) * sizeof(exits[0])), exits
+                    , exitnum * sizeof(exits[0]));
+    nd->outnum = exitnum;
+    nd->isret = isret;
+    nd->cost = (exitc < 0) ? 0 : (bound - 1) * iter + exitc;
+  }
+  longest(nodes, n, 0, -1, &iter, &exitc);
+  result = (exitc < 0) ? Wnoreturn : exitc;
+done:
+  wcet[e] = result;
+  state[e] = 2;
+  for (i = 0; i < n; ++i)
+    free(nodes[i].out);
+  for (k = 0; k < loopnum; ++k)
+    free(loops[k].body);
+  free(nodes);
+  free(loops);
+  free(exits);
+  return result;
+}
+
+/************************************************************/
+int
+discover(int entry, Node **nodesp)
+{
+  Node *nodes = NULL;
+  Node *nd = NULL;
+  XL_Combo *p = NULL;
+  int *stack = NULL;
+  int top = 0, n = 0, cap = 64, at = 0, addr = 0, i = 0, k = 0;
+  int size = 0, targ[2], targnum = 0, follow = 0, bad = -1;
+  ++stamp;
+  nodes = domalloc(cap * sizeof(nodes[0]));
+  stack = domalloc(PRGSIZE * sizeof(stack[0]));
+  seen[entry - 0x8000] = stamp;
+  nodeidx[entry - 0x8000] = n++;
+  nodes[0].out = NULL;
+  stack[top++] = entry;
+  while (top > 0 && bad < 0) {
+    addr = stack[--top];
+    at = addr - 0x8000;
+    p = &XL_combos[prg[at]];
+    size = XL_modesizes[p->amode];
+    nd = &nodes[nodeidx[at]];
+    nd->addr = addr;
+    nd->cost = XL_opcycles(prg[at]);
+    /* a store to the xlx exit port ends the program */
+    nd->isret = p->inst == Tret || p->inst == Trti
+             || ((p->inst == Tsta || p->inst == Tstx || p->inst == Tsty)
+                && p->amode == Mabs && at + 2 < VECTORS
+                && (prg[at + 1] | (prg[at + 2] << 8)) == 0x7FFF);
+    nd->rep = nodeidx[at];
+    nd->loop = -1;
+    nd->out = domalloc(2 * sizeof(nd->out[0]));
+    nd->outnum = 0;
+    if (p->inst == Tinv || at + size > VECTORS) {
+      bad = addr;
+      break;
+    }
+    targnum = 0;
+    follow = !nd->isret;
+    if (p->inst == Tjmp || (Tjfb <= p->inst && p->inst <= Tjtz)) {
+      follow = p->inst != Tjmp;
+      if (p->amode == Mrel)
+        targ[targnum++] = addr + (prg[at + 1] ^ 0x80) - 0x80;
+      else if (p->amode == Mabs)
+        targ[targnum++] = prg[at + 1] | (prg[at + 2] << 8);
+      else
+        targ[targnum++] = -1;
+    }
+    else if (p->inst == Tcal && p->amode != Mrel && p->amode != Mabs) {
+      targ[targnum++] = -1;
+    }
+    if (follow)
+      targ[targnum++] = addr + size;
+    for (i = 0; i < targnum; ++i) {
+      if (targ[i] < 0x8000 || targ[i] >= 0x8000 + VECTORS) {
+        bad = addr;
+        break;
+      }
+      k = targ[i] - 0x8000;
+      if (seen[k] != stamp) {
+        if (n + 1 > cap) {
+          cap *= 2;
+          nodes = dorealloc(nodes, cap * sizeof(nodes[0]));
+          nd = &nodes[nodeidx[at]];
+        }
+        seen[k] = stamp;
+        nodeidx[k] = n;
+        nodes[n++].out = NULL;
+        stack[top++] = targ[i];
+      }
+      nd->out[nd->outnum++] = nodeidx[k];
+    }
+  }
+  free(stack);
+  *nodesp = nodes;
+  if (bad >= 0) {
+    for (i = 0; i < n; ++i)
+      free(nodes[i].out);
+    free(nodes);
+    *nodesp = NULL;
+    unbounded(entry, Rjump, bad);
+    return -1;
+  }
+  return n;
+}
+
+/************************************************************/
+int
+findloops(Node *nodes, int n, Loop **loopsp)
+{
+  Loop *loops = NULL;
+  Loop *lp = NULL;
+  int *color = NULL, *stackn = NULL, *stacki = NULL, *backs = NULL;
+  int *predoff = NULL, *preds = NULL, *mark = NULL, *headof = NULL;
+  int top = 0, u = 0, v = 0, i = 0, j = 0, backnum = 0, loopnum = 0;
+  color = memset(domalloc(n * sizeof(color[0])), 0, n * sizeof(color[0]));
+  stackn = domalloc(n * sizeof(stackn[0]));
+  stacki = domalloc(n * sizeof(stacki[0]));
+  backs = domalloc(2 * (n * 2 + 1) * sizeof(backs[0]));
+  /* a jump to a node on the DFS stack is a back edge */
+  color[0] = 1;
+  stackn[0] = 0;
+  stacki[0] = 0;
+  top = 1;
+  while (top > 0) {
+    u = stackn[top - 1];
+    if (stacki[top - 1] < nodes[u].outnum) {
+      v = nodes[u].out[stacki[top - 1]++];
+      if (color[v] == 1) {
+        backs[backnum * 2] = u;
+        backs[backnum * 2 + 1] = v;
+        ++backnum;
+      }
+      else if (color[v] == 0) {
+        color[v] = 1;
+        stackn[top] = v;
+        stacki[top] = 0;
+        ++top;
+      }
+    }
+    else {
+      color[u] = 2;
+      --top;
+    }
+  }
+  predoff = memset(domalloc((n + 1) * sizeof(predoff[0])), 0
+                  , (n + 1) * sizeof(predoff[0]));
+  for (u = 0; u < n; ++u)
+    for (i = 0; i < nodes[u].outnum; ++i)
+      predoff[nodes[u].out[i] + 1]++;
+  for (u = 0; u < n; ++u)
+    predoff[u + 1] += predoff[u];
+  preds = domalloc((predoff[n] + 1) * sizeof(preds[0]));
+  memset(stacki, 0, n * sizeof(stacki[0]));
+  for (u = 0; u < n; ++u) {
+    for (i = 0; i < nodes[u].outnum; ++i) {
+      v = nodes[u].out[i];
+      preds[predoff[v] + stacki[v]++] = u;
+    }
+  }
+  mark = memset(domalloc(n * sizeof(mark[0])), 0xFF, n * sizeof(mark[0]));
+  headof = memset(domalloc(n * sizeof(headof[0])), 0xFF
+                 , n * sizeof(headof[0]));
+  loops = domalloc((backnum + 1) * sizeof(loops[0]));
+  /* the natural loop is everything that reaches the back edge
+     without passing the header */
+  for (j = 0; j < backnum; ++j) {
+    u = backs[j * 2];
+    v = backs[j * 2 + 1];
+    if (headof[v] < 0) {
+      headof[v] = loopnum;
+      lp = &loops[loopnum++];
+      lp->head = v;
+      lp->body = domalloc(n * sizeof(lp->body[0]));
+      lp->bodynum = 0;
+      lp->body[lp->bodynum++] = v;
+      mark[v] = headof[v];
+    }
+    lp = &loops[headof[v]];
+    if (mark[u] == headof[v])
+      continue;
+    mark[u] = headof[v];
+    lp->body[lp->bodynum++] = u;
+    top = 0;
+    stackn[top++] = u;
+    while (top > 0) {
+      u = stackn[--top];
+      for (i = predoff[u]; i < predoff[u + 1]; ++i) {
+        if (mark[preds[i]] == headof[v])
+          continue;
+        mark[preds[i]] = headof[v];
+        lp->body[lp->bodynum++] = preds[i];
+        stackn[top++] = preds[i];
+      }
+    }
+  }
+  /* a loop with another entry reaches the routine entry backwards
+     without passing the header */
+  for (j = 0; j < loopnum; ++j) {
+    lp = &loops[j];
+    for (i = 0; lp->head != 0 && i < lp->bodynum; ++i)
+      if (lp->body[i] == 0)
+        errf("xlwcet: The loop at 0x%04X has more than one entry\n"
+            , nodes[lp->head].addr);
+  }
+  qsort(loops, loopnum, sizeof(loops[0]), cmploop);
+  free(color);
+  free(stackn);
+  free(stacki);
+  free(backs);
+  free(predoff);
+  free(preds);
+  free(mark);
+  free(headof);
+  *loopsp = loops;
+  return loopnum;
+}
+
+/************************************************************/
+void
+longest(Node *nodes, int n, int start, int loop, long *iter
+       , long *exitc)
+{
+  int *color = NULL, *post = NULL, *stackn = NULL, *stacki = NULL;
+  long *dist = NULL;
+  int top = 0, postnum = 0, r = 0, v = 0, rv = 0, i = 0;
+  color = memset(domalloc(n * sizeof(color[0])), 0, n * sizeof(color[0]));
+  post = domalloc(n * sizeof(post[0]));
+  stackn = domalloc(n * sizeof(stackn[0]));
+  stacki = domalloc(n * sizeof(stacki[0]));
+  dist = domalloc(n * sizeof(dist[0]));
+  *iter = -1;
+  *exitc = -1;
+  color[start] = 1;
+  stackn[0] = start;
+  stacki[0] = 0;
+  top = 1;
+  while (top > 0) {
+    r = stackn[top - 1];
+    if (stacki[top - 1] < nodes[r].outnum) {
+      v = nodes[r].out[stacki[top - 1]++];
+      rv = nodes[v].rep;
+      if (loop >= 0 && (rv == start || nodes[v].loop != loop))
+        continue;
+      if (color[rv] == 1)
+        errf("xlwcet: The loop at 0x%04X has more than one entry\n"
+            , nodes[rv].addr);
+      if (color[rv] == 0) {
+        color[rv] = 1;
+        stackn[top] = rv;
+        stacki[top] = 0;
+        ++top;
+      }
+    }
+    else {
+      color[r] = 2;
+      post[postnum++] = r;
+      --top;
+    }
+  }
+  for (i = 0; i < postnum; ++i)
+    dist[post[i]] = -1;
+  dist[start] = nodes[start].cost;
+  while (postnum > 0) {
+    r = post[--postnum];
+    if (dist[r] < 0)
+      continue;
+    if (nodes[r].isret && dist[r] > *exitc)
+      *exitc = dist[r];
+    for (i = 0; i < nodes[r].outnum; ++i) {
+      v = nodes[r].out[i];
+      rv = nodes[v].rep;
+      if (loop >= 0 && rv == start) {
+        if (dist[r] > *iter)
+          *iter = dist[r];
+      }
+      else if (loop >= 0 && nodes[v].loop != loop) {
+        if (dist[r] > *exitc)
+          *exitc = dist[r];
+      }
+      else if (dist[r] + nodes[rv].cost > dist[rv]) {
+        dist[rv] = dist[r] + nodes[rv].cost;
+      }
+    }
+  }
+  free(color);
+  free(post);
+  free(stackn);
+  free(stacki);
+  free(dist);
+}
+
+/************************************************************/
+long
+unbounded(int entry, int why, int at)
+{
+  reason[entry - 0x8000] = why;
+  reasonat[entry - 0x8000] = at;
+  return Wunbounded;
+}
+
+/************************************************************/
+void
+printroutine(int addr, int vec)
+{
+  const char *name = names[addr - 0x8000], *sep = "";
+  long w = wcet[addr - 0x8000];
+  int at = reasonat[addr - 0x8000];
+  if (w >= 0 && (vec == Ibreak || vec == Ireact))
+    w += INTCYCLES;
+  printf(" %04X ", addr);
+  if (w >= 0)
+    printf("%10li  ", w);
+  else
+    printf("%10s  ", "-");
+  /* without a label the notes take the place of the name */
+  if (name != NULL) {
+    printf("%s", name);
+    sep = " ";
+  }
+  if (vec >= 0) {
+    printf("%s(%s)", sep, XL_interrupts[vec]);
+    sep = " ";
+  }
+  if (w == Wnoreturn)
+    printf("%snever returns", sep);
+  if (w == Wunbounded && reason[addr - 0x8000] == Rloop)
+    printf("%sno bound for the loop at 0x%04X", sep, at);
+  if (w == Wunbounded && reason[addr - 0x8000] == Rjump)
+    printf("%scannot follow the jump at 0x%04X", sep, at);
+  if (w == Wunbounded && reason[addr - 0x8000] == Rrecursion)
+    printf("%s0x%04X calls itself back", sep, at);
+  putchar('\n');
+}
+
+/************************************************************/
+void
+readmap(const char *filename)
+{
+  FILE *map = NULL;
+  char name[256];
+  char kind = 0;
+  unsigned int addr = 0;
+  map = fopen(filename, "r");
+  if (map == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  while (fscanf(map, "%x %c %255s", &addr, &kind, name) == 3) {
+    if (kind != 'L' || addr < 0x8000 || addr >= 0x8000 + VECTORS)
+      continue;
+    if (names[addr - 0x8000] != NULL)
+      continue;
+    names[addr - 0x8000] = strcpy(domalloc(strlen(name) + 1), name);
+  }
+  if (!feof(map))
+    errf("%s: Invalid map file\n", filename);
+  fclose(map);
+}
+
+/************************************************************/
+void
+readbounds(const char *filename)
+{
+  char line[512];
+  char word[16];
+  FILE *f = NULL;
+  Limit *lim = NULL;
+  char *s = NULL;
+  int row = 0;
+  f = fopen(filename, "r");
+  if (f == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  while (fgets(line, sizeof(line), f) != NULL) {
+    ++row;
+    for (s = line; *s == ' ' || *s == '\t'; ++s)
+      /* nothing */;
+    if (*s == ';' || *s == '\n' || *s == '\r' || *s == '\0')
+      continue;
+    if (limnum + 1 > limcap) {
+      limcap = limcap ? limcap * 2 : 16;
+      limtab = dorealloc(limtab, limcap * sizeof(limtab[0]));
+    }
+    lim = &limtab[limnum];
+    if (sscanf(s, "%15s %255s %li", word, lim->name, &lim->value) != 3)
+      errf("%s:%i: Expected loop or budget, a label and a number\n"
+          , filename, row);
+    /**/ if (strcmp(word, "loop") == 0)
+      lim->isbudget = 0;
+    else if (strcmp(word, "budget") == 0)
+      lim->isbudget = 1;
+    else
+      errf("%s:%i: Unknown word %s\n", filename, row, word);
+    if (lim->value < (lim->isbudget ? 0 : 1))
+      errf("%s:%i: Invalid number %li\n", filename, row, lim->value);
+    lim->addr = findaddr(lim->name);
+    if (lim->addr < 0x8000 || lim->addr >= 0x8000 + VECTORS)
+      errf("%s:%i: Unknown label %s\n", filename, row, lim->name);
+    ++limnum;
+  }
+  if (ferror(f))
+    errf("%s: Cannot read the file\n", filename);
+  fclose(f);
+}
+
+/************************************************************/
+int
+findaddr(const char *name)
+{
+  char *end = NULL;
+  long addr = 0;
+  int i = 0;
+  if ('0' <= name[0] && name[0] <= '9') {
+    addr = strtol(name, &end, 0);
+    return (*end == '\0') ? (int)addr : -1;
+  }
+  for (i = 0; i < VECTORS; ++i)
+    if (names[i] != NULL && strcmp(names[i], name) == 0)
+      return 0x8000 + i;
+  return -1;
+}
+
+/************************************************************/
+long
+findbound(int addr)
+{
+  int i = 0;
+  for (i = 0; i < limnum; ++i)
+    if (!limtab[i].isbudget && limtab[i].addr == addr)
+      return limtab[i].value;
+  return -1;
+}
+
+/************************************************************/
+int
+cmploop(const void *a, const void *b)
+{
+  const Loop *x = a, *y = b;
+  return x->bodynum - y->bodynum;
+}
+
+/************************************************************/
+void
+errf(const char *fmt, ...)
+{
+  va_list args;
+  assert(fmt != NULL);
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  exit(EXIT_FAILURE);
+}
+
+/************************************************************/
+void *
+domalloc(size_t size)
+{
+  void *ptr = malloc(size);
+  if (ptr == NULL)
+    errf("xlwcet: malloc failed\n");
+  return ptr;
+}
+
+/************************************************************/
+void *
+dorealloc(void *oldptr, size_t newsize)
+{
+  void *ptr = realloc(oldptr, newsize);
+  if (ptr == NULL)
+    errf("xlwcet: realloc failed\n");
+  return ptr;
+}
+
+#define XL_EXTRA_C
+#include "extended_lemon_extra.h"
+
+/*
+MIT License
+
+Copyright (c) 2024 Artem Pirunov
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
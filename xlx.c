@@ -2,17 +2,28 @@
 xlx.c - is a simple XL powered virtual vachine.
 See LICENSE information in the end of the file.
   BUILD
-gcc -std=c89 -pedantic -Wall -Wextra -o xlx xlx.c
+gcc -std=c89 -pedantic -Wall -Wextra -pthread -o xlx xlx.c
  or
-gcc -std=c89 -pedantic -Wall -Wextra -DXLXDB -o xlxdb xlx.c
+gcc -std=c89 -pedantic -Wall -Wextra -pthread -DXLXDB -o xlxdb xlx.c
   RUN
 xlx <input-files...>
  or
-xlxdb <input-files...>
+xlxdb [-t <trace-file>] [-r] <input-files...>
+ The input files ending with .xlas are assembled in memory.
+  OPTIONS
+-p  Profile subroutines, write collapsed stacks to the file
+-s  Read symbols for the profile from the xlas map file
+-h  Count executions and memory accesses per address, write
+    the heatmap to the file
+-t  Write the execution trace to the file (xlx.trace by default)
+-r  Keep only the last XLX_RING_SIZE trace records
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,6 +32,7 @@ xlxdb <input-files...>
 
 #include "extended_lemon.h"
 #include "extended_lemon_extra.h"
+#include "xlas.h"
 
 #ifdef XLXDB
 #define XLXDEBUG 1
@@ -28,18 +40,80 @@ xlxdb <input-files...>
 #define XLXDEBUG 0
 #endif
 
+/*
+The number of trace records buffered in memory.
+*/
+#define XLX_RING_SIZE 0x10000
+
+/*
+The maximum depth of the profiler call tree.
+*/
+#define XLX_PROF_DEPTH 256
+
 typedef struct XLX {
   XL_Byte mem[0x10000];
   const char *filename;
   int stop;
 } XLX;
 
+typedef struct XLXTrace {
+  XL_Trace ring[XLX_RING_SIZE];
+  FILE *file;
+  const char *filename;
+  unsigned long head; /* Next record in the ring */
+  unsigned long num; /* Records in the ring */
+  int isring; /* Overwrite the oldest records instead of flushing */
+  XL_Byte regs[5]; /* f, a, s, x, y after the last instruction */
+} XLXTrace;
+
+typedef struct XLXSym {
+  XL_Word addr;
+  char *name;
+} XLXSym;
+
+typedef struct XLXNode {
+  long parent;
+  long child; /* The first callee */
+  long sibling; /* The next callee of the parent */
+  unsigned long self; /* Cycles spent in the routine itself */
+  unsigned long calls;
+  XL_Word addr; /* Address of the routine */
+  int depth;
+} XLXNode;
+
+typedef struct XLXProf {
+  XLXNode *nodes; /* Call tree, the node 0 is the root */
+  long nodenum;
+  long nodecap;
+  long cur; /* The node of the running routine */
+  long over; /* Calls past XLX_PROF_DEPTH, not in the tree */
+  unsigned long now; /* Cycles since the start */
+  unsigned long last; /* Cycles at the last event */
+  XLXSym *syms; /* sorted by the address */
+  int symnum;
+  int symcap;
+  int ismap; /* the symbols come from the map file */
+  const char *filename;
+} XLXProf;
+
+typedef struct XLXHeat {
+  unsigned long *counts[XL_HEAT_COUNT]; /* NULL if disabled */
+  const char *filename;
+} XLXHeat;
+
 /*
 Print error and exit.
 */
 void
 errf(const char *fmt, ...);
 
+/*
+Remember the signal, main exits at the next instruction so that
+the trace, the profile and the heatmap are written.
+*/
+void
+xlx_onsignal(int sig);
+
 /*
 Error method to handle XL exceptions.
 */
@@ -65,10 +139,99 @@ void
 xlx_init(XLX *xlx, const char *filename);
 
 /*
-Printf the difference.
+Assemble the xlas source into the ROM and keep its labels.
+*/
+void
+xlx_assemble(XLX *xlx, const char *filename);
+
+/*
+Get the address and its symbolic name if there is one.
+*/
+const char *
+xlx_where(XL_Word addr);
+
+/*
+Create the trace file.
+*/
+void
+xlxdb_open(const char *filename, int isring);
+
+/*
+Add a new record to the trace.
+*/
+XL_Trace *
+xlxdb_push(int kind);
+
+/*
+Add the instruction that has started at the address.
+*/
+void
+xlxdb_inst(XLX *xlx, XL *xl, XL_Word p);
+
+/*
+Write the buffered records to the trace file.
+*/
+void
+xlxdb_flush(void);
+
+/*
+Event method to profile subroutines.
+*/
+void
+xlx_event(XL *xl, XL_Uint ecode);
+
+/*
+Start the profiler.
 */
 void
-xlxdb_diff(XL *prevxl, XL *xl);
+xlxpf_open(const char *filename, const char *mapname);
+
+/*
+Get the callee node of the routine at the address.
+*/
+long
+xlxpf_enter(long parent, XL_Word addr);
+
+/*
+Add the symbol of the address.
+*/
+void
+xlxpf_addsym(XL_Word addr, const char *name);
+
+/*
+Forget all the symbols.
+*/
+void
+xlxpf_clearsyms(void);
+
+/*
+Get the symbolic name of the address.
+*/
+const char *
+xlxpf_name(XL_Word addr);
+
+/*
+Write the collapsed stacks and print the flat profile.
+*/
+void
+xlxpf_write(void);
+
+/*
+Start counting for the heatmap.
+*/
+void
+xlxhm_open(const char *filename);
+
+/*
+Write the heatmap file.
+*/
+void
+xlxhm_write(void);
+
+static XLXTrace xlxtr;
+static XLXProf xlxpf;
+static XLXHeat xlxhm;
+static volatile sig_atomic_t xlxsig; /* SIGINT or SIGTERM received */
 
 /************************************************************/
 int
@@ -76,104 +239,448 @@ main(int argc, char **argv)
 {
   static XLX static_xlx;
   static XL static_xl;
-  static XL static_pervxl;
   XL *xl = &static_xl;
-  XL *prevxl = &static_pervxl;
   XLX *xlx = &static_xlx;
-  XL_Combo *p = NULL;
+  const char *tracename = "xlx.trace";
+  const char *profname = NULL, *mapname = NULL, *heatname = NULL;
+  unsigned long *exec = NULL, *cycles = NULL;
+  struct sigaction sa;
   time_t t0, t;
-  int i = 0, c = 0, m = 0, n = 0, val = 0;
-  XL_Word addr = 0;
-  if (argc < 2)
+  int i = 0, c = 0, isring = 0, iscount = 0;
+  XL_Word p = 0;
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    /**/ if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      tracename = argv[++i];
+    else if (strcmp(argv[i], "-r") == 0)
+      isring = 1;
+    else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+      profname = argv[++i];
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      mapname = argv[++i];
+    else if (strcmp(argv[i], "-h") == 0 && i + 1 < argc)
+      heatname = argv[++i];
+    else
+      errf("xlx: Unknown option %s\n", argv[i]);
+  }
+  if (i >= argc)
     errf("xlx: No input files\n");
   XL_init(xl);
   xl->error = xlx_error;
   xl->load = xlx_load;
   xl->store = xlx_store;
   xl->userdata = (void *)xlx;
+  /* no SA_RESTART, so getchar of the input returns too */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = xlx_onsignal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  if (XLXDEBUG)
+    xlxdb_open(tracename, isring);
+  if (profname != NULL) {
+    xlxpf_open(profname, mapname);
+    xl->event = xlx_event;
+  }
+  if (heatname != NULL) {
+    xlxhm_open(heatname);
+    exec = xlxhm.counts[XL_HEAT_EXEC];
+    cycles = xlxhm.counts[XL_HEAT_CYCLES];
+  }
+  iscount = profname != NULL || heatname != NULL;
   t0 = t = time(NULL);
-  for (i = 1; i < argc; ++i) {
+  for (; i < argc; ++i) {
     xlx_init(xlx, argv[i]);
     XL_restart(xl);
-    memcpy(prevxl, xl, sizeof(*xl));
-    prevxl->p = xlx->mem[0xFFFE];
-    prevxl->p |= xlx->mem[0xFFFF] << 8;
-    while (!xlx->stop) {
+    /* the reset zeroes the registers the trace compares with */
+    memset(xlxtr.regs, 0, sizeof(xlxtr.regs));
+    while (!xlx->stop && !xlxsig) {
       if (!XLXDEBUG) {
-        for (c = 0; c < XL_FREQ && !xlx->stop; ++c)
-          XL_cycle(xl);
-        while (t0 == t && !xlx->stop)
+        if (!iscount)
+          for (c = 0; c < XL_FREQ && !xlx->stop; ++c)
+            XL_cycle(xl);
+        else
+          for (c = 0; c < XL_FREQ && !xlx->stop; ++c) {
+            ++xlxpf.now;
+            p = xl->p;
+            if (XL_cycle(xl) && exec != NULL) {
+              exec[p] += 1;
+              cycles[p] += 1 + xl->icycles;
+            }
+          }
+        while (t0 == t && !xlx->stop && !xlxsig)
           t = time(NULL);
         t0 = t;
       }
       else {
-        while (!XL_cycle(xl))
-          /* nothing */;
-        p = &XL_combos[xlx->mem[prevxl->p]];
-        n = XL_modesizes[p->amode];
-        m = p->amode;
-        fprintf(stderr, " %04X  ", prevxl->p);
-        fprintf(stderr, "%s", XL_keywords[p->inst]);
-        fprintf(stderr, "%s", XL_msignatures[m]);
-        addr = prevxl->p + 1;
-        if (n == 2) {
-          val = xlx->mem[addr];
-          /**/ if (m == Mimm) {
-            fprintf(stderr, "%i", val);
-          }
-          else if (m == Mrel) {
-            if (val > 127)
-              val |= ~0xFF;
-            addr = prevxl->p + val;
-            fprintf(stderr, "%i -> 0x%04X", val, addr);
-          }
-          else {
-            fprintf(stderr, "0x%02X", val);
-          }
-        }
-        if (n == 3) {
-          val = xlx->mem[addr];
-          ++addr;
-          val |= xlx->mem[addr] << 8;
-          fprintf(stderr, "0x%04X", val);
+        do p = xl->p, ++xlxpf.now;
+        while (!XL_cycle(xl));
+        xlxdb_inst(xlx, xl, p);
+        if (exec != NULL) {
+          exec[p] += 1;
+          cycles[p] += 1 + xl->icycles;
         }
-        xlxdb_diff(prevxl, xl);
-        fprintf(stderr, "\n");
-        memcpy(prevxl, xl, sizeof(*xl));
       }
     }
+    /* the atexit functions write the files */
+    if (xlxsig)
+      exit(128 + xlxsig);
   }
   return 0;
 }
 
 /************************************************************/
 void
-xlxdb_diff(XL *prevxl, XL *xl)
+xlx_onsignal(int sig)
 {
-  int diff = (prevxl->f != xl->f) || (prevxl->a != xl->a)
-          || (prevxl->s != xl->s) || (prevxl->x != xl->x)
-          || (prevxl->y != xl->y);
-  if (diff)
-    fprintf(stderr, " >>>");
-  if (prevxl->f != xl->f) {
-    fprintf(stderr, " f: %c%c%c%c%c%c%c%c;"
-           , XL_get_flag(xl, XL_FLAG_Z) ? 'Z' : '-'
-           , XL_get_flag(xl, XL_FLAG_V) ? 'V' : '-'
-           , XL_get_flag(xl, XL_FLAG_U) ? 'U' : '-'
-           , XL_get_flag(xl, XL_FLAG_R) ? 'R' : '-'
-           , XL_get_flag(xl, XL_FLAG_N) ? 'N' : '-'
-           , XL_get_flag(xl, XL_FLAG_D) ? 'D' : '-'
-           , XL_get_flag(xl, XL_FLAG_C) ? 'C' : '-'
-           , XL_get_flag(xl, XL_FLAG_B) ? 'B' : '-');
+  xlxsig = sig;
+}
+
+/************************************************************/
+void
+xlxdb_open(const char *filename, int isring)
+{
+  xlxtr.filename = filename;
+  xlxtr.isring = isring;
+  xlxtr.file = fopen(filename, "wb");
+  if (xlxtr.file == NULL)
+    errf("%s: %s\n", filename, strerror(errno));
+  fwrite(XL_TRACE_MAGIC, 1, 8, xlxtr.file);
+  atexit(xlxdb_flush);
+}
+
+/************************************************************/
+XL_Trace *
+xlxdb_push(int kind)
+{
+  XL_Trace *tr = NULL;
+  if (xlxtr.num == XLX_RING_SIZE && !xlxtr.isring)
+    xlxdb_flush();
+  tr = &xlxtr.ring[xlxtr.head];
+  xlxtr.head = (xlxtr.head + 1) % XLX_RING_SIZE;
+  if (xlxtr.num < XLX_RING_SIZE)
+    ++xlxtr.num;
+  memset(tr, 0, sizeof(*tr));
+  tr->kind = kind;
+  return tr;
+}
+
+/************************************************************/
+void
+xlxdb_inst(XLX *xlx, XL *xl, XL_Word p)
+{
+  XL_Trace *tr = xlxdb_push(XL_TRACE_INST);
+  XL_Byte regs[5];
+  int i = 0, n = 0;
+  regs[0] = xl->f;
+  regs[1] = xl->a;
+  regs[2] = xl->s;
+  regs[3] = xl->x;
+  regs[4] = xl->y;
+  for (i = 0; i < 5; ++i)
+    if (regs[i] != xlxtr.regs[i])
+      tr->mask |= 1 << i;
+  memcpy(xlxtr.regs, regs, 5);
+  n = XL_modesizes[XL_combos[xlx->mem[p]].amode];
+  for (i = 0; i < n; ++i)
+    tr->inst[i] = xlx->mem[(XL_Word)(p + i)];
+  tr->p[0] = p & 0xFF;
+  tr->p[1] = p >> 8;
+  tr->addr[0] = xl->addr & 0xFF;
+  tr->addr[1] = xl->addr >> 8;
+  tr->f = xl->f;
+  tr->a = xl->a;
+  tr->s = xl->s;
+  tr->x = xl->x;
+  tr->y = xl->y;
+  tr->cycles = 1 + xl->icycles;
+}
+
+/************************************************************/
+void
+xlxdb_flush(void)
+{
+  unsigned long tail = 0, n = 0;
+  if (xlxtr.file == NULL)
+    return;
+  n = xlxtr.num;
+  tail = (xlxtr.head + XLX_RING_SIZE - n) % XLX_RING_SIZE;
+  if (tail + n > XLX_RING_SIZE) {
+    fwrite(xlxtr.ring + tail, XL_TRACE_SIZE
+          , XLX_RING_SIZE - tail, xlxtr.file);
+    n -= XLX_RING_SIZE - tail;
+    tail = 0;
+  }
+  fwrite(xlxtr.ring + tail, XL_TRACE_SIZE, n, xlxtr.file);
+  fflush(xlxtr.file);
+  if (ferror(xlxtr.file))
+    fprintf(stderr, "%s: Cannot write the file\n", xlxtr.filename);
+  xlxtr.head = 0;
+  xlxtr.num = 0;
+}
+
+/************************************************************/
+void
+xlx_event(XL *xl, XL_Uint event)
+{
+  XLXNode *node = &xlxpf.nodes[xlxpf.cur];
+  /* the rest of this instruction belongs to the current node */
+  node->self += xlxpf.now + xl->icycles - xlxpf.last;
+  xlxpf.last = xlxpf.now + xl->icycles;
+  if (event == XL_EVENT_RESET) {
+    xlxpf.over = 0;
+    xlxpf.cur = xlxpf_enter(0, xl->p);
+  }
+  else if (event == XL_EVENT_INT || event == XL_EVENT_CALL) {
+    /* too deep, count the call so that its return is not a pop */
+    if (xlxpf.over > 0 || node->depth >= XLX_PROF_DEPTH)
+      xlxpf.over += 1;
+    else
+      xlxpf.cur = xlxpf_enter(xlxpf.cur, xl->p);
+  }
+  else if (xlxpf.over > 0)
+    xlxpf.over -= 1;
+  else if (node->parent > 0)
+    xlxpf.cur = node->parent;
+}
+
+/************************************************************/
+long
+xlxpf_enter(long parent, XL_Word addr)
+{
+  XLXNode *node = NULL;
+  long i = 0;
+  for (i = xlxpf.nodes[parent].child; i > 0; i = node->sibling) {
+    node = &xlxpf.nodes[i];
+    if (node->addr == addr) {
+      node->calls += 1;
+      return i;
+    }
+  }
+  if (xlxpf.nodenum + 1 > xlxpf.nodecap) {
+    xlxpf.nodecap *= 2;
+    xlxpf.nodes = realloc(xlxpf.nodes
+                         , xlxpf.nodecap * sizeof(xlxpf.nodes[0]));
+    if (xlxpf.nodes == NULL)
+      errf("xlx: realloc failed\n");
+  }
+  i = xlxpf.nodenum++;
+  node = &xlxpf.nodes[i];
+  memset(node, 0, sizeof(*node));
+  node->parent = parent;
+  node->sibling = xlxpf.nodes[parent].child;
+  node->addr = addr;
+  node->calls = 1;
+  node->depth = xlxpf.nodes[parent].depth + 1;
+  xlxpf.nodes[parent].child = i;
+  return i;
+}
+
+/************************************************************/
+void
+xlxpf_open(const char *filename, const char *mapname)
+{
+  FILE *map = NULL;
+  char name[256];
+  unsigned int addr = 0;
+  char kind = 0;
+  xlxpf.filename = filename;
+  xlxpf.nodecap = 256;
+  xlxpf.nodenum = 1;
+  xlxpf.nodes = calloc(xlxpf.nodecap, sizeof(xlxpf.nodes[0]));
+  if (xlxpf.nodes == NULL)
+    errf("xlx: malloc failed\n");
+  atexit(xlxpf_write);
+  if (mapname == NULL)
+    return;
+  map = fopen(mapname, "r");
+  if (map == NULL)
+    errf("%s: %s\n", mapname, strerror(errno));
+  while (fscanf(map, "%x %c %255s", &addr, &kind, name) == 3) {
+    if (kind == 'L')
+      xlxpf_addsym(addr, name);
+  }
+  if (!feof(map))
+    errf("%s: Invalid map file\n", mapname);
+  fclose(map);
+  xlxpf.ismap = 1;
+}
+
+/************************************************************/
+void
+xlxpf_addsym(XL_Word addr, const char *name)
+{
+  XLXSym sym;
+  int i = 0;
+  if (xlxpf.symnum + 1 > xlxpf.symcap) {
+    xlxpf.symcap = xlxpf.symcap ? xlxpf.symcap * 2 : 64;
+    xlxpf.syms = realloc(xlxpf.syms
+                        , xlxpf.symcap * sizeof(xlxpf.syms[0]));
+    if (xlxpf.syms == NULL)
+      errf("xlx: realloc failed\n");
+  }
+  sym.addr = addr;
+  sym.name = malloc(strlen(name) + 1);
+  if (sym.name == NULL)
+    errf("xlx: malloc failed\n");
+  strcpy(sym.name, name);
+  /* keep sorted by the address, the symbols come mostly sorted */
+  for (i = xlxpf.symnum; i > 0 && xlxpf.syms[i - 1].addr > addr; --i)
+    xlxpf.syms[i] = xlxpf.syms[i - 1];
+  xlxpf.syms[i] = sym;
+  xlxpf.symnum += 1;
+}
+
+/************************************************************/
+void
+xlxpf_clearsyms(void)
+{
+  int i = 0;
+  for (i = 0; i < xlxpf.symnum; ++i)
+    free(xlxpf.syms[i].name);
+  xlxpf.symnum = 0;
+}
+
+/************************************************************/
+const char *
+xlxpf_name(XL_Word addr)
+{
+  static char buf[300];
+  int lo = 0, hi = xlxpf.symnum, mid = 0;
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (xlxpf.syms[mid].addr <= addr) lo = mid;
+    else                              hi = mid;
+  }
+  if (xlxpf.symnum == 0 || xlxpf.syms[lo].addr > addr)
+    sprintf(buf, "0x%04X", addr);
+  else if (xlxpf.syms[lo].addr == addr)
+    return xlxpf.syms[lo].name;
+  else
+    sprintf(buf, "%.255s+%i", xlxpf.syms[lo].name
+           , addr - xlxpf.syms[lo].addr);
+  return buf;
+}
+
+/************************************************************/
+void
+xlxpf_write(void)
+{
+  static long stack[XLX_PROF_DEPTH + 1];
+  unsigned long *total = NULL, *incl = NULL, *excl = NULL;
+  unsigned long *calls = NULL;
+  XLXNode *node = NULL;
+  FILE *out = NULL;
+  long i = 0, k = 0, n = 0;
+  if (xlxpf.nodes == NULL)
+    return;
+  if (xlxpf.now > xlxpf.last)
+    xlxpf.nodes[xlxpf.cur].self += xlxpf.now - xlxpf.last;
+  xlxpf.last = xlxpf.now;
+  out = fopen(xlxpf.filename, "w");
+  if (out == NULL) {
+    fprintf(stderr, "%s: %s\n", xlxpf.filename, strerror(errno));
+    return;
+  }
+  total = calloc(xlxpf.nodenum, sizeof(total[0]));
+  incl = calloc(0x10000, sizeof(incl[0]));
+  excl = calloc(0x10000, sizeof(excl[0]));
+  calls = calloc(0x10000, sizeof(calls[0]));
+  if (!total || !incl || !excl || !calls) {
+    fprintf(stderr, "xlx: malloc failed\n");
+    fclose(out);
+    free(total);
+    free(incl);
+    free(excl);
+    free(calls);
+    return;
+  }
+  /* collapsed stacks, children always follow their parents */
+  for (i = 1; i < xlxpf.nodenum; ++i) {
+    node = &xlxpf.nodes[i];
+    excl[node->addr] += node->self;
+    calls[node->addr] += node->calls;
+    if (node->self == 0)
+      continue;
+    for (n = 0, k = i; k > 0; k = xlxpf.nodes[k].parent)
+      stack[n++] = k;
+    while (n > 0) {
+      fputs(xlxpf_name(xlxpf.nodes[stack[--n]].addr), out);
+      fputc(n > 0 ? ';' : ' ', out);
+    }
+    fprintf(out, "%lu\n", node->self);
+  }
+  if (ferror(out))
+    fprintf(stderr, "%s: Cannot write the file\n", xlxpf.filename);
+  fclose(out);
+  /* inclusive cycles, recursive calls are counted once */
+  for (i = xlxpf.nodenum - 1; i > 0; --i) {
+    node = &xlxpf.nodes[i];
+    total[i] += node->self;
+    total[node->parent] += total[i];
+    for (k = node->parent; k > 0; k = xlxpf.nodes[k].parent)
+      if (xlxpf.nodes[k].addr == node->addr)
+        break;
+    if (k == 0)
+      incl[node->addr] += total[i];
+  }
+  fprintf(stderr, "_addr______inclusive______exclusive______calls"
+                  "__name__________\n");
+  for (i = 0; i < 0x10000; ++i) {
+    if (calls[i] == 0)
+      continue;
+    fprintf(stderr, " %04lX %14lu %14lu %10lu  %s\n", i, incl[i]
+           , excl[i], calls[i], xlxpf_name(i));
+  }
+  free(total);
+  free(incl);
+  free(excl);
+  free(calls);
+}
+
+/************************************************************/
+void
+xlxhm_open(const char *filename)
+{
+  int i = 0;
+  xlxhm.filename = filename;
+  for (i = 0; i < XL_HEAT_COUNT; ++i) {
+    xlxhm.counts[i] = calloc(0x10000, sizeof(xlxhm.counts[i][0]));
+    if (xlxhm.counts[i] == NULL)
+      errf("xlx: malloc failed\n");
+  }
+  atexit(xlxhm_write);
+}
+
+/************************************************************/
+void
+xlxhm_write(void)
+{
+  static unsigned char buf[0x10000 * 4];
+  unsigned long val = 0;
+  FILE *out = NULL;
+  long i = 0;
+  int k = 0;
+  out = fopen(xlxhm.filename, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "%s: %s\n", xlxhm.filename, strerror(errno));
+    return;
+  }
+  fwrite(XL_HEAT_MAGIC, 1, 8, out);
+  for (k = 0; k < XL_HEAT_COUNT; ++k) {
+    for (i = 0; i < 0x10000; ++i) {
+      val = xlxhm.counts[k][i];
+      if (val > 0xFFFFFFFFUL)
+        val = 0xFFFFFFFFUL;
+      buf[i * 4 + 0] = val & 0xFF;
+      buf[i * 4 + 1] = (val >> 8) & 0xFF;
+      buf[i * 4 + 2] = (val >> 16) & 0xFF;
+      buf[i * 4 + 3] = (val >> 24) & 0xFF;
+    }
+    fwrite(buf, 1, sizeof(buf), out);
   }
-  if (prevxl->a != xl->a)
-    fprintf(stderr, " a = %i;", xl->a);
-  if (prevxl->s != xl->s)
-    fprintf(stderr, " s = %i;", xl->s);
-  if (prevxl->x != xl->x)
-    fprintf(stderr, " x = %i;", xl->x);
-  if (prevxl->y != xl->y)
-    fprintf(stderr, " y = %i;", xl->y);
+  if (ferror(out))
+    fprintf(stderr, "%s: Cannot write the file\n", xlxhm.filename);
+  fclose(out);
 }
 
 /************************************************************/
@@ -181,10 +688,15 @@ void
 xlx_init(XLX *xlx, const char *filename)
 {
   FILE *file = NULL;
-  size_t readn = 0;
+  size_t readn = 0, len = 0;
   assert(xlx != NULL && filename != NULL);
   memset(xlx, 0, sizeof(*xlx));
   xlx->filename = filename;
+  len = strlen(filename);
+  if (len > 5 && strcmp(filename + len - 5, ".xlas") == 0) {
+    xlx_assemble(xlx, filename);
+    return;
+  }
   file = fopen(filename, "rb");
   if (file == NULL)
     errf("%s: %s\n", filename, strerror(errno));
@@ -196,6 +708,39 @@ xlx_init(XLX *xlx, const char *filename)
   fclose(file);
 }
 
+/************************************************************/
+void
+xlx_assemble(XLX *xlx, const char *filename)
+{
+  const XLAS_Symbol *syms = NULL;
+  XLAS *as = XLAS_new(NULL);
+  int i = 0, num = 0;
+  if (XLAS_assemble(as, filename, NULL, 0) != 0)
+    exit(EXIT_FAILURE);
+  if (XLAS_image(as, xlx->mem + 0x8000) < 0x8000)
+    errf("%s: Too few bytes in the program\n", filename);
+  /* the labels name the addresses in the profile and the errors */
+  if (!xlxpf.ismap) {
+    xlxpf_clearsyms();
+    syms = XLAS_symbols(as, &num);
+    for (i = 0; i < num; ++i)
+      if (syms[i].islabel)
+        xlxpf_addsym(syms[i].val, syms[i].name);
+  }
+  XLAS_free(as);
+}
+
+/************************************************************/
+const char *
+xlx_where(XL_Word addr)
+{
+  static char buf[320];
+  sprintf(buf, "0x%04X", addr);
+  if (xlxpf.symnum > 0 && xlxpf.syms[0].addr <= addr)
+    sprintf(buf + 6, " (%s)", xlxpf_name(addr));
+  return buf;
+}
+
 /************************************************************/
 void
 xlx_error(XL *xl, XL_Uint ecode)
@@ -203,8 +748,8 @@ xlx_error(XL *xl, XL_Uint ecode)
   XLX *xlx = xl->userdata;
   assert(xlx != NULL && ecode == XL_ERR_INVALID);
   xl->p -= 1;
-  errf("%s: Invalid instruction executed at 0x%04X\n"
-      , xlx->filename, (int)xl->p);
+  errf("%s: Invalid instruction executed at %s\n"
+      , xlx->filename, xlx_where(xl->p));
 }
 
 /************************************************************/
@@ -214,15 +759,13 @@ xlx_load(XL *xl, XL_Word addr)
   XLX *xlx = xl->userdata;
   int ch = 0;
   assert(xlx != NULL);
+  if (xlxhm.counts[XL_HEAT_LOADS] != NULL)
+    xlxhm.counts[XL_HEAT_LOADS][addr] += 1;
   if (addr == 0x00FF) {
-    if (!XLXDEBUG) {
-      return getchar();
-    }
-    else {
-      ch = getchar();
-      fprintf(stderr, "input VVV %i\n", ch);
-      return ch;
-    }
+    ch = getchar();
+    if (XLXDEBUG)
+      xlxdb_push(XL_TRACE_INPUT)->data = ch;
+    return ch;
   }
   return xlx->mem[addr];
 }
@@ -233,14 +776,12 @@ xlx_store(XL *xl, XL_Word addr, XL_Byte data)
 {
   XLX *xlx = xl->userdata;
   assert(xlx != NULL);
+  if (xlxhm.counts[XL_HEAT_STORES] != NULL)
+    xlxhm.counts[XL_HEAT_STORES][addr] += 1;
   if (addr == 0x00FF) {
-    if (!XLXDEBUG) {
-      putchar(data);
-    }
-    else {
-      putchar(data);
-      fprintf(stderr, "output VVV %i\n", data);
-    }
+    putchar(data);
+    if (XLXDEBUG)
+      xlxdb_push(XL_TRACE_OUTPUT)->data = data;
   }
   if (addr <= 0x7FFE)
     xlx->mem[addr] = data;
@@ -267,6 +808,8 @@ errf(const char *fmt, ...)
 #include "extended_lemon.h"
 #define XL_EXTRA_C
 #include "extended_lemon_extra.h"
+#define XLAS_C
+#include "xlas.h"
 
 /*
 MIT License
@@ -291,4 +834,3 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
-